@@ -0,0 +1,1612 @@
+// headless benchmarks, links against the engine (src/brutopolis.c, src/net.c, src/save.c, src/nav.c, src/ai.c, src/lod.c) and libbruter only
+// usage: bench [--filter name] [--out file.json] [--creatures N] [--bullets M] [--ticks T] [--threads N] [--scaling]
+//              [--net-creatures N] [--clients N] [--save-creatures N] [--save-path file] [--map file.obj] [--path-queries N]
+//              [--ai-creatures N]
+// results go to stdout as a table and to --out as json
+
+#include "brutopolis.h"
+#include "net.h"
+#include "save.h"
+#include "nav.h"
+#include "ai.h"
+#include "lod.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <time.h>
+
+// how much more the biggest ai world may cost per tick than the first one at the think budget, what the cache misses
+// of a bigger world add to the same number of thinks, with room for noise
+#define AI_FLAT_RATIO 3.0
+
+// passed by the Makefile, so results from different builds can be told apart
+#ifndef BENCH_CONFIG
+#define BENCH_CONFIG "default"
+#endif
+
+typedef struct
+{
+    const char* name;
+    Int iterations;
+    double ns_per_op;
+    double mallocs_per_op; // malloc, calloc and realloc calls
+} BenchResult;
+typedef List(BenchResult) BenchResultList;
+
+typedef struct
+{
+    const char* name;
+    Int threads;
+    Int creatures;
+    Int bullets;
+    Int ticks;
+    double ms_per_tick;
+    double p50_ms;
+    double p99_ms;
+    double max_ms;
+    Int respawned;
+    Int frame_bytes_peak;
+    unsigned long checksum; // hash of the final world, equal for every thread count
+} ScenarioResult;
+typedef List(ScenarioResult) ScenarioResultList;
+
+typedef struct
+{
+    const char* name;
+    Int creatures;
+    Int clients;
+    Int ticks;
+    double ms_per_tick; // building the world state and every client packet
+    double bytes_per_client; // per tick
+    Int max_packet;
+    double entities_per_client; // in the client state after each packet
+} ReplicationResult;
+typedef List(ReplicationResult) ReplicationResultList;
+
+typedef struct
+{
+    Int creatures;
+    Int bullets;
+    double file_mb;
+    double save_ms; // world_save on the calling thread
+    double fork_ms; // what world_save_async costs the caller
+    double async_ms; // until the child is done
+    double load_ms;
+    bool match; // the loaded world hashes the same as the saved one
+    Int journal_creatures; // marked dirty for the journal entry
+    double journal_kb; // one autosave entry
+    double journal_ms; // journal_append, to compare with save_ms
+    double recover_ms; // snapshot plus journal
+    bool recovered; // the recovered world hashes the same as the journaled one
+} SaveResult;
+
+typedef struct
+{
+    const char* map;
+    Int polys;
+    Int links;
+    double build_ms; // grid plus navmesh
+    Int threads;
+    Int queries;
+    double search_qps; // nav_find_corridor and nav_funnel on one thread, no cache: what every miss costs
+    double cold_qps; // empty cache at the start of the batch
+    double cold_hit_rate;
+    Int cold_misses;
+    double warm_qps; // the same batch again
+    double warm_hit_rate;
+    Int warm_misses; // only above zero when the batch needs more corridors than the cache holds
+    double found; // fraction of queries with a path
+    double off_mesh; // fraction with the start or the goal on no polygon
+    double unreachable; // fraction whose goal polygon the links don't lead to from the start one, found + off_mesh + unreachable is 1
+    double valid; // fraction of paths that only cross walkable cells
+} NavmeshResult;
+
+typedef struct
+{
+    Int creatures;
+    Int ticks;
+    Int levels[AI_LOD_LEVELS]; // creatures per level, last tick
+    Int periods[AI_LOD_LEVELS]; // last tick
+    double thinks_per_tick;
+    double ms_per_tick; // update_ai
+    double full_ms; // every creature thinking, what a tick cost without the scheduler
+} AiResult;
+typedef List(AiResult) AiResultList;
+
+typedef struct
+{
+    bool entered; // the map0 enter trigger ran its command, with event.creature the id of the creature walking in
+    bool stayed; // a stay trigger fired on every tick for the creature standing in it
+    bool exited; // an exit trigger killed the creature walking out by event.creature, after a removal moved it in the list
+    Int fires; // timed stay fires
+    double fire_ns; // one fire, its command parsed once at map load
+    double eval_ns; // the same command parsed every time
+} TriggerResult;
+
+typedef struct
+{
+    const char* name;
+    Int iterations;
+    void (*setup)(void);
+    void (*run)(Int iterations);
+    void (*teardown)(void);
+} Bench;
+
+// results are written here so the compiler can't drop the benchmarked work
+volatile Int bench_sink = 0;
+
+static double now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+// deterministic, so every build benchmarks the same world
+static unsigned int bench_seed = 1;
+static float bench_random(float min, float max)
+{
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return min + (max - min) * ((bench_seed >> 8) & 0xFFFF) / 65535.0f;
+}
+
+// a floor and some crates, roughly what map0 looks like
+static InternalSystem* bench_world(Int creatures, Int hitboxes)
+{
+    bench_seed = 1;
+    InternalSystem* sys = new_system("bench", 0, 0);
+    new_map(sys, "bench", -1);
+    BoundingBoxList *boxes = sys->maps->data[0].hitboxes;
+    list_push(*boxes, ((BoundingBox){(Vector3){-50, -1, -50}, (Vector3){50, 0, 50}}));
+    for (Int i = 1; i < hitboxes; i++)
+    {
+        Vector3 min = {bench_random(-45, 45), 0, bench_random(-45, 45)};
+        list_push(*boxes, ((BoundingBox){min, (Vector3){min.x + 1, min.y + bench_random(1, 3), min.z + 1}}));
+    }
+
+    reserve_world(sys, creatures, 0);
+    for (Int i = 0; i < creatures; i++)
+    {
+        new_creature(sys, "enemy", bench_random(-40, 40), 1, bench_random(-40, 40));
+    }
+    return sys;
+}
+
+// the bench is linked with --wrap for these (see the Makefile), so the calls from the engine, the containers
+// and libbruter are all counted; per thread, the microbenchmarks run on the main one
+static _Thread_local Int bench_mallocs = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    bench_mallocs++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    bench_mallocs++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+    bench_mallocs++;
+    return __real_realloc(pointer, size);
+}
+
+// microbenchmarks
+
+static InternalSystem* sys = NULL;
+static VirtualMachine* bench_vm = NULL;
+static IntList* parsed = NULL;
+
+static void setup_collision(void)
+{
+    sys = bench_world(0, 64);
+}
+
+static void run_collision(Int iterations)
+{
+    Int hits = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        // above every crate, so the whole hitbox list is scanned
+        Vector3 position = {(i % 80) - 40.0f, 10.0f, ((i / 80) % 80) - 40.0f};
+        hits += check_move_collision(sys, position, (Vector3){0.1f, 0, 0}, 0.1f);
+    }
+    bench_sink = hits;
+}
+
+static void teardown_system(void)
+{
+    free_system(sys);
+    sys = NULL;
+}
+
+static void setup_bullets(void)
+{
+    sys = bench_world(256, 1);
+    // still bullets between the creatures and the camera, every bullet is tested against every creature and none hits
+    for (Int i = 0; i < 1024; i++)
+    {
+        new_bullet(sys, (Vector3){bench_random(-20, 20), 30, bench_random(-20, 20)}, (Vector3){0, 0, 0}, 0);
+    }
+}
+
+static void run_bullets(Int iterations)
+{
+    for (Int i = 0; i < iterations; i++)
+    {
+        update_bullets(sys);
+        reset_frame(sys);
+    }
+    bench_sink = sys->world.bullets->size;
+}
+
+static SnapshotBuffer* snapshots = NULL;
+
+static void setup_snapshot(void)
+{
+    setup_bullets();
+    snapshots = snapshot_buffer_init();
+}
+
+// one publish on the simulation side and one acquire on the render side
+static void run_snapshot(Int iterations)
+{
+    Int ticks = 0;
+    PlayerInput input;
+    init_player_input(&input);
+    for (Int i = 0; i < iterations; i++)
+    {
+        publish_snapshot(sys, snapshots, &input);
+        ticks += acquire_snapshot(snapshots)->tick;
+    }
+    bench_sink = ticks;
+}
+
+static void teardown_snapshot(void)
+{
+    snapshot_buffer_free(snapshots);
+    snapshots = NULL;
+    teardown_system();
+}
+
+static void setup_gravity(void)
+{
+    sys = bench_world(256, 64);
+}
+
+static void run_gravity(Int iterations)
+{
+    for (Int i = 0; i < iterations; i++)
+    {
+        update_gravity(sys);
+    }
+    bench_sink = (Int)creature(0).position.y;
+}
+
+// every creature but the first one chases the first one, the player, the flow field is built by the first update
+static void setup_navigation(void)
+{
+    sys = bench_world(4096, 64);
+    set_player(sys, 0);
+    for (Int i = 1; i < sys->world.creatures->size; i++)
+        creature(i).target_id = creature(0).id;
+
+    update_navigation(sys);
+}
+
+// the target does not move, so this is the per tick cost of steering the horde
+static void run_navigation(Int iterations)
+{
+    for (Int i = 0; i < iterations; i++)
+    {
+        update_navigation(sys);
+        update_ai(sys);
+    }
+
+    bench_sink = (Int)creature(1).steer.x;
+}
+
+// 20k agents crowding the 80x80 middle of the floor, a few neighbours each
+static void setup_separation(void)
+{
+    sys = bench_world(20000, 64);
+    for (Int i = 1; i < sys->world.creatures->size; i++)
+        creature(i).target_id = creature(0).id;
+}
+
+// nobody moves, so every iteration separates the same crowd
+static void run_separation(Int iterations)
+{
+    for (Int i = 0; i < iterations; i++)
+        update_separation(sys);
+
+    bench_sink = sys->ai->stats.pushed;
+}
+
+static LodObj* lod_obj = NULL;
+
+static void setup_lod(void)
+{
+    lod_obj = lod_obj_load("data/model/base.obj");
+}
+
+// the whole lod chain of the creature model, what the cook step does per model
+static void run_lod(Int iterations)
+{
+    Int triangles = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        lod_build_chain(lod_obj, MODEL_LOD_LEVELS);
+        triangles += lod_triangles(lod_obj, MODEL_LOD_LEVELS - 1);
+    }
+    bench_sink = triangles;
+}
+
+static void teardown_lod(void)
+{
+    lod_obj_free(lod_obj);
+    lod_obj = NULL;
+}
+
+// what the renderer does per far creature with 50k of them on screen: size on screen, level, impostor quad;
+// the model is the size of base.obj and the atlas is only pretended, nothing is drawn
+#define BENCH_IMPOSTORS 50000
+
+static void run_impostors(Int iterations)
+{
+    ModelLod lod = {0};
+    lod.count = MODEL_LOD_LEVELS;
+    lod.center = (Vector3){0, 1.1f, 0};
+    lod.radius = 1.15f;
+    lod.impostor.id = 1;
+    Camera camera = {.position = {0, 1.7f, 0}, .target = {1, 1.7f, 0}, .up = {0, 1, 0}, .fovy = 60, .projection = CAMERA_PERSPECTIVE};
+    float* vertices = (float*)malloc(BENCH_IMPOSTORS * 6 * 3 * sizeof(float));
+    float* texcoords = (float*)malloc(BENCH_IMPOSTORS * 6 * 2 * sizeof(float));
+    unsigned char* levels = (unsigned char*)malloc(BENCH_IMPOSTORS);
+    memset(levels, 0, BENCH_IMPOSTORS);
+
+    float scale = lod_screen_scale(camera, 720);
+    Int quads = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        quads = 0;
+        for (Int c = 0; c < BENCH_IMPOSTORS; c++)
+        {
+            // a 250x200 field of creatures 60 to 310 units ahead
+            Vector3 position = {60.0f + (c % 250), 0, (c / 250) - 100.0f + (i & 1) * 0.1f};
+            int level = lod_select(&lod, lod_screen_size(camera.position, scale, Vector3Add(position, lod.center), lod.radius), levels[c]);
+            levels[c] = level;
+            if (level == lod.count)
+            {
+                lod_impostor_quad(&lod, camera.position, position, c * 7.0f, vertices + quads * 18, texcoords + quads * 12);
+                quads++;
+            }
+        }
+    }
+
+    bench_sink = quads + (Int)vertices[0];
+    free(vertices);
+    free(texcoords);
+    free(levels);
+}
+
+// a whole dijkstra map over the 100x100 grid, the goal moves every iteration
+static void run_flow_field(Int iterations)
+{
+    Navigation *nav = sys->nav;
+    FlowField *field = nav_find_field(nav, creature(0).id);
+    Int settled = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        nav_start_field(nav, field, nav_cell(nav, (Vector3){(i % 40) - 20.0f, 0, ((i / 40) % 40) - 20.0f}));
+        settled += nav_update_field(nav, field, (Int)nav->width * nav->depth * 8);
+    }
+    bench_sink = settled;
+}
+
+static void setup_vm(void)
+{
+    bench_vm = make_vm();
+    init_std(bench_vm);
+    char name[32];
+    for (Int i = 0; i < 1000; i++)
+    {
+        snprintf(name, sizeof(name), "var.%ld", (long)i);
+        register_number(bench_vm, name, i);
+    }
+    register_number(bench_vm, "a", 1);
+    register_number(bench_vm, "b", 2);
+    parsed = parse(bench_vm, "+ a b", NULL);
+}
+
+static void teardown_vm(void)
+{
+    list_free(*parsed);
+    free_vm(bench_vm);
+    bench_vm = NULL;
+}
+
+static void run_hash_find(Int iterations)
+{
+    char name[32];
+    Int found = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        snprintf(name, sizeof(name), "var.%ld", (long)(i % 1000));
+        found += hash_find(bench_vm, name);
+    }
+    bench_sink = found;
+}
+
+static void run_parse(Int iterations)
+{
+    char cmd[] = "+ a b";
+    for (Int i = 0; i < iterations; i++)
+    {
+        IntList *args = parse(bench_vm, cmd, NULL);
+        bench_sink = args->size;
+        list_free(*args);
+    }
+}
+
+static void run_interpret(Int iterations)
+{
+    for (Int i = 0; i < iterations; i++)
+    {
+        bench_sink = interpret_args(bench_vm, parsed, NULL);
+    }
+}
+
+static void run_eval(Int iterations)
+{
+    char cmd[] = "+ a b";
+    for (Int i = 0; i < iterations; i++)
+    {
+        bench_sink = eval(bench_vm, cmd, NULL);
+    }
+}
+
+// c_list.h, c_arena.h and c_slab.h
+
+static void run_list_push_pop(Int iterations)
+{
+    IntList *list = list_init(IntList);
+    Int sum = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        list_push(*list, i);
+        if (list->size == 1024)
+        {
+            while (list->size > 0)
+                sum += list_pop(*list);
+        }
+    }
+    list_free(*list);
+    bench_sink = sum;
+}
+
+static void run_list_shift(Int iterations)
+{
+    IntList *list = list_init(IntList);
+    for (Int i = 0; i < 1024; i++)
+        list_push(*list, i);
+
+    Int sum = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        sum += list_shift(*list);
+        list_push(*list, i);
+    }
+    list_free(*list);
+    bench_sink = sum;
+}
+
+static void run_deque_shift(Int iterations)
+{
+    typedef Deque(Int) IntDeque;
+    IntDeque *deque = deque_init(IntDeque);
+    for (Int i = 0; i < 1024; i++)
+        deque_push(*deque, i);
+
+    Int sum = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        sum += deque_shift(*deque);
+        deque_push(*deque, i);
+    }
+    deque_free(*deque);
+    bench_sink = sum;
+}
+
+static void run_list_find(Int iterations)
+{
+    IntList *list = list_init(IntList);
+    for (Int i = 0; i < 4096; i++)
+        list_push(*list, i * 2);
+
+    Int found = 0;
+    for (Int n = 0; n < iterations; n++)
+    {
+        // the key is computed outside the macro, list_find declares its own i
+        Int key = (n * 7) % 8192;
+        found += list_find(*list, key);
+    }
+
+    list_free(*list);
+    bench_sink = found;
+}
+
+static void run_list_sorted_find(Int iterations)
+{
+    IntList *list = list_init(IntList);
+    for (Int i = 0; i < 4096; i++)
+        list_push(*list, i * 2);
+
+    Int found = 0;
+    for (Int n = 0; n < iterations; n++)
+    {
+        Int key = (n * 7) % 8192;
+        found += list_sorted_find(*list, key);
+    }
+
+    list_free(*list);
+    bench_sink = found;
+}
+
+static void run_small_list_push(Int iterations)
+{
+    Inventory inventory;
+    small_list_init(inventory);
+    Int sum = 0;
+    for (Int i = 0; i < iterations; i++)
+    {
+        small_list_push(inventory, make_item("bench", ITEM_HAND, 0, 0, i));
+        // stays inline, like a regular inventory
+        if (inventory.size == INVENTORY_INLINE)
+        {
+            while (inventory.size > 0)
+                sum += small_list_pop(inventory).content;
+        }
+    }
+    small_list_free(inventory);
+    bench_sink = sum;
+}
+
+static void run_arena_alloc(Int iterations)
+{
+    Arena *arena = arena_init(64 * 1024);
+    for (Int i = 0; i < iterations; i++)
+    {
+        BoundingBox *box = arena_new(arena, BoundingBox);
+        box->min.x = i;
+        if (arena->used >= 60 * 1024)
+            arena_reset(arena);
+    }
+    bench_sink = arena->allocations;
+    arena_free(arena);
+}
+
+static void run_malloc_free(Int iterations)
+{
+    BoundingBox *boxes[64];
+    for (Int i = 0; i < iterations; i++)
+    {
+        boxes[i % 64] = (BoundingBox*)malloc(sizeof(BoundingBox));
+        boxes[i % 64]->min.x = i;
+        if (i % 64 == 63)
+        {
+            for (Int j = 0; j < 64; j++)
+                free(boxes[j]);
+        }
+    }
+    for (Int j = 0; j < iterations % 64; j++)
+        free(boxes[j]);
+    bench_sink = iterations;
+}
+
+static void run_slab_alloc(Int iterations)
+{
+    BulletSlab *slab = slab_init(BulletSlab, BULLET_PAGE_SIZE);
+    Bullet *bullets[64];
+    for (Int i = 0; i < iterations; i++)
+    {
+        bullets[i % 64] = slab_alloc(*slab);
+        bullets[i % 64]->speed = i;
+        if (i % 64 == 63)
+        {
+            for (Int j = 0; j < 64; j++)
+                slab_release(*slab, bullets[j]);
+        }
+    }
+    bench_sink = slab->peak;
+    slab_free(*slab);
+}
+
+static Bench benches[] =
+{
+    {"check_move_collision", 1000000, setup_collision, run_collision, teardown_system},
+    {"update_bullets", 1000, setup_bullets, run_bullets, teardown_system},
+    {"update_gravity", 1000, setup_gravity, run_gravity, teardown_system},
+    {"publish_snapshot", 100000, setup_snapshot, run_snapshot, teardown_snapshot},
+    {"update_navigation", 1000, setup_navigation, run_navigation, teardown_system},
+    {"flow_field_build", 1000, setup_navigation, run_flow_field, teardown_system},
+    {"separation", 100, setup_separation, run_separation, teardown_system},
+    {"lod_chain", 1000, setup_lod, run_lod, teardown_lod},
+    {"impostor_quads", 100, NULL, run_impostors, NULL},
+    {"hash_find", 1000000, setup_vm, run_hash_find, teardown_vm},
+    {"parse", 1000000, setup_vm, run_parse, teardown_vm},
+    {"interpret_args", 1000000, setup_vm, run_interpret, teardown_vm},
+    {"eval", 100000, setup_vm, run_eval, teardown_vm},
+    {"list_push_pop", 10000000, NULL, run_list_push_pop, NULL},
+    {"list_shift", 1000000, NULL, run_list_shift, NULL},
+    {"deque_shift", 10000000, NULL, run_deque_shift, NULL},
+    {"list_find", 100000, NULL, run_list_find, NULL},
+    {"list_sorted_find", 10000000, NULL, run_list_sorted_find, NULL},
+    {"small_list_push", 10000000, NULL, run_small_list_push, NULL},
+    {"arena_alloc", 10000000, NULL, run_arena_alloc, NULL},
+    {"malloc_free", 10000000, NULL, run_malloc_free, NULL},
+    {"slab_alloc", 10000000, NULL, run_slab_alloc, NULL},
+};
+
+static BenchResult run_bench(Bench *bench)
+{
+    if (bench->setup != NULL)
+        bench->setup();
+
+    // warm up caches and let the lists reach their steady size
+    bench->run(bench->iterations / 10 + 1);
+
+    Int mallocs = bench_mallocs;
+    double start = now_ns();
+    bench->run(bench->iterations);
+    double elapsed = now_ns() - start;
+    mallocs = bench_mallocs - mallocs;
+
+    if (bench->teardown != NULL)
+        bench->teardown();
+
+    return (BenchResult){bench->name, bench->iterations, elapsed / bench->iterations, (double)mallocs / bench->iterations};
+}
+
+// scenario: n creatures and m bullets for t ticks, the world is refilled every tick so the load stays constant
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// fnv-1a over the creature and bullet positions, in list order
+static unsigned long world_checksum(InternalSystem* sys)
+{
+    unsigned long hash = 14695981039346656037UL;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        unsigned char *bytes = (unsigned char*)&creature(i).position;
+        for (size_t b = 0; b < sizeof(Vector3); b++)
+            hash = (hash ^ bytes[b]) * 1099511628211UL;
+    }
+    for (Int i = 0; i < sys->world.bullets->size; i++)
+    {
+        unsigned char *bytes = (unsigned char*)&bullet(i).position;
+        for (size_t b = 0; b < sizeof(Vector3); b++)
+            hash = (hash ^ bytes[b]) * 1099511628211UL;
+    }
+    return hash;
+}
+
+static ScenarioResult run_scenario(const char* name, Int creatures, Int bullets, Int ticks, Int threads)
+{
+    sys = bench_world(creatures, 64);
+    reserve_world(sys, creatures, bullets);
+    sys->jobs = threads > 1 ? jobs_init(threads) : NULL;
+    double *times = (double*)malloc(sizeof(double) * ticks);
+    Int respawned = 0;
+
+    for (Int t = 0; t < ticks; t++)
+    {
+        double start = now_ns();
+
+        while (sys->world.creatures->size < creatures)
+        {
+            new_creature(sys, "enemy", bench_random(-40, 40), 1, bench_random(-40, 40));
+            respawned++;
+        }
+        while (sys->world.bullets->size < bullets)
+        {
+            Vector3 direction = Vector3Normalize((Vector3){bench_random(-1, 1), 0, bench_random(-1, 1)});
+            new_bullet(sys, (Vector3){bench_random(-10, 10), 1.5f, bench_random(-10, 10)}, direction, BULLET_SPEED);
+        }
+
+        for (Int i = 0; i < sys->world.creatures->size; i++)
+        {
+            creature(i).move = (Vector3){bench_random(-1, 1), 0, bench_random(-1, 1)};
+        }
+        world_tick(sys);
+        reset_frame(sys);
+        sys->time += 1.0 / TICK_RATE;
+
+        times[t] = (now_ns() - start) / 1e6;
+    }
+
+    ScenarioResult result = {0};
+    result.name = name;
+    result.threads = threads;
+    result.creatures = creatures;
+    result.bullets = bullets;
+    result.ticks = ticks;
+    double total = 0;
+    for (Int t = 0; t < ticks; t++)
+        total += times[t];
+
+    qsort(times, ticks, sizeof(double), compare_double);
+    result.ms_per_tick = total / ticks;
+    result.p50_ms = times[ticks / 2];
+    result.p99_ms = times[(ticks * 99) / 100];
+    result.max_ms = times[ticks - 1];
+    result.respawned = respawned;
+    result.frame_bytes_peak = sys->frame_bytes_peak;
+    result.checksum = world_checksum(sys);
+
+    if (sys->jobs != NULL)
+        jobs_free(sys->jobs);
+
+    free(times);
+    teardown_system();
+    return result;
+}
+
+// replication: n creatures walking around a big map and c clients spread among them, every tick each client
+// gets a delta against what it had on the tick before (every packet acked right away), with or without interest management
+static ReplicationResult run_replication(const char* name, Int creatures, Int clients, Int ticks, bool interest)
+{
+    sys = bench_world(0, 1);
+    reserve_world(sys, creatures, 0);
+    // most of the quantized range, so the interest radius only covers a part of the map
+    for (Int i = 0; i < creatures; i++)
+    {
+        new_creature(sys, "enemy", bench_random(-480, 480), 0, bench_random(-480, 480));
+    }
+
+    if (clients > creatures)
+        clients = creatures;
+
+    NetSnapshot world_state, view;
+    net_snapshot_init(&world_state);
+    net_snapshot_init(&view);
+    // the state each client had on the last tick and the one it has after this tick
+    NetSnapshot *history = (NetSnapshot*)malloc(sizeof(NetSnapshot) * clients * 2);
+    for (Int i = 0; i < clients * 2; i++)
+        net_snapshot_init(&history[i]);
+
+    SpatialHash *grid = spatial_hash_init(NET_INTEREST_CELL);
+    IntList *order = list_init(IntList);
+    double total = 0;
+    double bytes = 0;
+    double entities = 0;
+    Int max_packet = 0;
+    for (Int t = 0; t < ticks; t++)
+    {
+        for (Int i = 0; i < sys->world.creatures->size; i++)
+        {
+            creature(i).position.x += bench_random(-0.1f, 0.1f);
+            creature(i).position.z += bench_random(-0.1f, 0.1f);
+        }
+
+        double start = now_ns();
+        build_world_state(sys, &world_state, t);
+        if (interest)
+            build_interest_grid(&world_state, grid);
+
+        for (Int c = 0; c < clients; c++)
+        {
+            NetSnapshot *baseline = t > 0 ? &history[c * 2 + (t + 1) % 2] : NULL;
+            NetSnapshot *sent = &history[c * 2 + t % 2];
+            Int own_id = creature(c * (creatures / clients)).id;
+            PacketWriter writer = {0};
+            if (interest)
+            {
+                build_client_view(&world_state, grid, own_id, baseline, &view, order);
+                write_snapshot(&writer, baseline, &view, own_id, order, sent);
+            }
+            else
+            {
+                write_snapshot(&writer, baseline, &world_state, own_id, NULL, sent);
+            }
+            bytes += writer.size;
+            entities += sent->entities->size;
+            if (writer.size > max_packet)
+                max_packet = writer.size;
+        }
+        total += (now_ns() - start) / 1e6;
+    }
+
+    ReplicationResult result = {name, creatures, clients, ticks, total / ticks, bytes / ticks / clients, max_packet, entities / ticks / clients};
+
+    for (Int i = 0; i < clients * 2; i++)
+        net_snapshot_free(&history[i]);
+
+    free(history);
+    net_snapshot_free(&world_state);
+    net_snapshot_free(&view);
+    spatial_hash_free(grid);
+    list_free(*order);
+    teardown_system();
+    return result;
+}
+
+static unsigned long fnv(unsigned long hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for (size_t b = 0; b < size; b++)
+        hash = (hash ^ bytes[b]) * 1099511628211UL;
+    return hash;
+}
+
+// everything a save keeps, in list order
+static unsigned long saved_checksum(InternalSystem* sys)
+{
+    unsigned long hash = 14695981039346656037UL;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        Creature *c = sys->world.creatures->data[i];
+        hash = fnv(hash, &c->id, sizeof(c->id));
+        hash = fnv(hash, c->name, strlen(c->name));
+        hash = fnv(hash, &c->position, sizeof(Vector3));
+        hash = fnv(hash, &c->rotation, sizeof(Vector3));
+        hash = fnv(hash, &c->current_item, sizeof(c->current_item));
+        for (Int j = 0; j < c->inventory.size; j++)
+        {
+            Item *item = &small_list_get(c->inventory, j);
+            hash = fnv(hash, &item->type, sizeof(item->type));
+            hash = fnv(hash, &item->content, sizeof(item->content));
+        }
+    }
+    for (Int i = 0; i < sys->world.bullets->size; i++)
+    {
+        hash = fnv(hash, &bullet(i).id, sizeof(bullet(i).id));
+        hash = fnv(hash, &bullet(i).position, sizeof(Vector3));
+    }
+    return hash ^ sys->world.next_id;
+}
+
+// same as saved_checksum but the creatures are hashed one by one and summed,
+// a recovered world has the same creatures in another order
+static unsigned long unordered_checksum(InternalSystem* sys)
+{
+    unsigned long sum = 0;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        Creature *c = sys->world.creatures->data[i];
+        unsigned long hash = fnv(14695981039346656037UL, &c->id, sizeof(c->id));
+        hash = fnv(hash, c->name, strlen(c->name));
+        hash = fnv(hash, &c->position, sizeof(Vector3));
+        hash = fnv(hash, &c->rotation, sizeof(Vector3));
+        hash = fnv(hash, &c->current_item, sizeof(c->current_item));
+        for (Int j = 0; j < c->inventory.size; j++)
+        {
+            Item *item = &small_list_get(c->inventory, j);
+            hash = fnv(hash, &item->type, sizeof(item->type));
+            hash = fnv(hash, &item->content, sizeof(item->content));
+        }
+        sum += hash;
+    }
+    for (Int i = 0; i < sys->world.bullets->size; i++)
+    {
+        unsigned long hash = fnv(14695981039346656037UL, &bullet(i).id, sizeof(bullet(i).id));
+        sum += fnv(hash, &bullet(i).position, sizeof(Vector3));
+    }
+    return sum ^ sys->world.next_id;
+}
+
+// save: n creatures with a couple of items each and some bullets, saved on the calling thread,
+// saved again in the background, then loaded back over the world
+static SaveResult run_save(Int creatures, const char *path)
+{
+    sys = bench_world(creatures, 64);
+    for (Int i = 0; i < creatures; i++)
+    {
+        inventory_add(&creature(i), make_item("hand", ITEM_HAND, 0, 0, 0));
+        inventory_add(&creature(i), make_item("revolver", ITEM_REVOLVER, item_capacities[ITEM_REVOLVER], ITEM_BULLET_REVOLVER, i % 7));
+        creature(i).rotation.x = bench_random(-PI, PI);
+    }
+    for (Int i = 0; i < 1024; i++)
+    {
+        new_bullet(sys, (Vector3){bench_random(-20, 20), 1.5f, bench_random(-20, 20)}, (Vector3){1, 0, 0}, BULLET_SPEED);
+    }
+
+    SaveResult result = {0};
+    result.creatures = creatures;
+    result.bullets = sys->world.bullets->size;
+    unsigned long before = saved_checksum(sys);
+
+    double start = now_ns();
+    bool saved = world_save(sys, path);
+    result.save_ms = (now_ns() - start) / 1e6;
+
+    start = now_ns();
+    saved = world_save_async(sys, path) && saved;
+    result.fork_ms = (now_ns() - start) / 1e6;
+    int status;
+    while ((status = world_save_status()) == SAVE_RUNNING)
+        usleep(1000);
+    result.async_ms = (now_ns() - start) / 1e6;
+    saved = saved && status == SAVE_DONE;
+
+    struct stat info;
+    result.file_mb = stat(path, &info) == 0 ? info.st_size / (1024.0 * 1024.0) : 0;
+
+    // scribble over the world first, so a load that does nothing can't pass
+    creature(0).position.x += 1;
+    start = now_ns();
+    bool loaded = world_load(sys, path);
+    result.load_ms = (now_ns() - start) / 1e6;
+    result.match = saved && loaded && saved_checksum(sys) == before;
+
+    // journal: autosave on top of the loaded world, then 1% of the creatures move or use an item, a few die and a few are born
+    bool journaled = autosave_start(sys, path);
+    Int changed = creatures / 100;
+    for (Int i = 0; i < changed; i++)
+    {
+        Creature *c = sys->world.creatures->data[(i * 7919) % sys->world.creatures->size];
+        c->position.x += 0.5f;
+        if (i % 4 == 0)
+            small_list_get(c->inventory, 1).content = 0;
+        mark_dirty(sys, c);
+    }
+    for (Int i = 0; i < 16 && sys->world.creatures->size > 1; i++)
+        kill_creature(sys, (i * 104729) % sys->world.creatures->size);
+    for (Int i = 0; i < 16; i++)
+        new_creature(sys, "newborn", i, 0, -i);
+
+    result.journal_creatures = 0;
+    for (Int w = 0; w < JOBS_MAX_WORKERS; w++)
+        result.journal_creatures += sys->world.dirty[w]->size;
+
+    char journal_path[1024];
+    snprintf(journal_path, sizeof(journal_path), "%s.journal", path);
+    before = unordered_checksum(sys);
+    start = now_ns();
+    journaled = journal_append(sys) && journaled;
+    result.journal_ms = (now_ns() - start) / 1e6;
+    result.journal_kb = stat(journal_path, &info) == 0 ? info.st_size / 1024.0 : 0;
+
+    creature(0).position.x += 1;
+    start = now_ns();
+    bool recovered = world_recover(sys, path);
+    result.recover_ms = (now_ns() - start) / 1e6;
+    result.recovered = journaled && recovered && unordered_checksum(sys) == before;
+    autosave_stop(sys, true);
+
+    unlink(path);
+    teardown_system();
+    return result;
+}
+
+// path queries from random walkable points to a few dozen goals, like creatures heading for the places they care about
+static double navmesh_batch(NavPathQuery *queries, Int count, double *hit_rate, Int *missed)
+{
+    Int hits = sys->nav->cache_hits, misses = sys->nav->cache_misses;
+    double start = now_ns();
+    nav_find_paths(sys, queries, count);
+    double elapsed = now_ns() - start;
+    hits = sys->nav->cache_hits - hits;
+    misses = sys->nav->cache_misses - misses;
+    *hit_rate = hits + misses > 0 ? (double)hits / (hits + misses) : 0;
+    *missed = misses;
+    return count / (elapsed / 1e9);
+}
+
+// the same queries without the cache, every one searched and funneled
+static double navmesh_search(NavPathQuery *queries, Int count)
+{
+    Navigation *nav = sys->nav;
+    IntList *corridor = list_init(IntList);
+    Vector3List *path = list_init(Vector3List);
+    double start = now_ns();
+    for (Int i = 0; i < count; i++)
+    {
+        Int from = nav_locate(nav, queries[i].start), to = nav_locate(nav, queries[i].goal);
+        path->size = 0;
+        if (from >= 0 && to >= 0 && nav_find_corridor(nav, &nav->searches[0], from, to, corridor))
+            nav_funnel(nav, corridor, queries[i].start, queries[i].goal, path);
+    }
+    double elapsed = now_ns() - start;
+    list_free(*corridor);
+    list_free(*path);
+    return count / (elapsed / 1e9);
+}
+
+// polygons the links lead to from start, breadth first, into reach[start * polys ...]
+static void navmesh_reach(Navigation *nav, Int start, unsigned char *reach, IntList *open)
+{
+    unsigned char *row = reach + start * nav->polys->size;
+    open->size = 0;
+    row[start] = 1;
+    list_push(*open, start);
+    for (Int i = 0; i < open->size; i++)
+    {
+        NavPoly *poly = &nav->polys->data[open->data[i]];
+        for (Int l = poly->first_link; l < poly->first_link + poly->link_count; l++)
+        {
+            Int next = nav->links->data[l].poly;
+            if (!row[next])
+            {
+                row[next] = 1;
+                list_push(*open, next);
+            }
+        }
+    }
+}
+
+static bool navmesh_path_valid(Vector3List *path)
+{
+    for (Int i = 1; i < path->size; i++)
+    {
+        Vector3 a = path->data[i - 1], b = path->data[i];
+        Int steps = (Int)(Vector3Distance(a, b) / 0.1f) + 1;
+        for (Int s = 0; s <= steps; s++)
+        {
+            Int cell = nav_cell(sys->nav, Vector3Lerp(a, b, (float)s / steps));
+            if (cell < 0 || isnan(sys->nav->height[cell]))
+                return false;
+        }
+    }
+    return true;
+}
+
+// map_path NULL builds a 256x256 floor with 1200 2x2 pillars instead, thousands of polygons,
+// so the 64 goals times the starts are many more corridors than NAV_PATH_CACHE_SIZE and the lru evicts
+static NavmeshResult run_navmesh(const char *map_path, Int count, Int threads)
+{
+    NavmeshResult result = {0};
+    result.map = map_path != NULL ? map_path : "pillars";
+    result.threads = threads;
+    result.queries = count;
+    bench_seed = 1;
+    sys = new_system("bench", 0, 0);
+    new_map(sys, "bench", -1);
+    BoundingBoxList *hitboxes = sys->maps->data[0].hitboxes;
+    BoundingBox bounds;
+    if (map_path == NULL)
+    {
+        list_push(*hitboxes, ((BoundingBox){(Vector3){-128, -1, -128}, (Vector3){128, 0, 128}}));
+        for (Int i = 0; i < 1200; i++)
+        {
+            float x = (Int)bench_random(-126, 124), z = (Int)bench_random(-126, 124);
+            list_push(*hitboxes, ((BoundingBox){(Vector3){x, 0, z}, (Vector3){x + 2, 3, z + 2}}));
+        }
+    }
+    else if (!load_obj_hitboxes((char*)map_path, hitboxes, &bounds))
+    {
+        teardown_system();
+        return result;
+    }
+    sys->jobs = threads > 1 ? jobs_init(threads) : NULL;
+
+    double start = now_ns();
+    nav_sync(sys);
+    result.build_ms = (now_ns() - start) / 1e6;
+    Navigation *nav = sys->nav;
+    result.polys = nav->polys->size;
+    result.links = nav->links->size;
+    if (nav->polys->size == 0)
+    {
+        teardown_system();
+        return result;
+    }
+
+    // any walkable cell center, picked uniformly over the cells
+    Vector3List *points = list_init(Vector3List);
+    for (Int c = 0; c < (Int)nav->width * nav->depth; c++)
+    {
+        if (!isnan(nav->height[c]))
+            list_push(*points, ((Vector3){nav->origin.x + (c % nav->width + 0.5f) * NAV_CELL_SIZE, nav->height[c], nav->origin.z + (c / nav->width + 0.5f) * NAV_CELL_SIZE}));
+    }
+
+    NavPathQuery *queries = (NavPathQuery*)malloc(sizeof(NavPathQuery) * count);
+    for (Int i = 0; i < count; i++)
+    {
+        Int goal = (Int)bench_random(0, 63.99f) * (points->size / 64);
+        queries[i].start = points->data[(Int)bench_random(0, points->size - 1)];
+        queries[i].goal = points->data[goal];
+        queries[i].path = list_init(Vector3List);
+    }
+
+    result.search_qps = navmesh_search(queries, count);
+    nav_cache_clear(nav);
+    result.cold_qps = navmesh_batch(queries, count, &result.cold_hit_rate, &result.cold_misses);
+    result.warm_qps = navmesh_batch(queries, count, &result.warm_hit_rate, &result.warm_misses);
+
+    // a query without a path has its start or goal off the navmesh, or on a polygon the links can't reach,
+    // like the top of a box, which is walkable but higher than NAV_STEP_HEIGHT from everything around it
+    Int polys = nav->polys->size;
+    unsigned char *reach = (unsigned char*)calloc(polys * polys, 1);
+    bool *reached = (bool*)calloc(polys, sizeof(bool));
+    IntList *open = list_init(IntList);
+    Int found = 0, valid = 0, off_mesh = 0, unreachable = 0;
+    for (Int i = 0; i < count; i++)
+    {
+        Int from = nav_locate(nav, queries[i].start), to = nav_locate(nav, queries[i].goal);
+        if (from < 0 || to < 0)
+            off_mesh++;
+        else
+        {
+            if (!reached[from])
+            {
+                navmesh_reach(nav, from, reach, open);
+                reached[from] = true;
+            }
+            unreachable += !reach[from * polys + to];
+        }
+
+        if (queries[i].path->size > 0)
+        {
+            found++;
+            valid += navmesh_path_valid(queries[i].path);
+        }
+        list_free(*queries[i].path);
+    }
+    result.found = (double)found / count;
+    result.off_mesh = (double)off_mesh / count;
+    result.unreachable = (double)unreachable / count;
+    result.valid = found > 0 ? (double)valid / found : 0;
+    list_free(*open);
+    free(reached);
+    free(reach);
+
+    free(queries);
+    list_free(*points);
+    if (sys->jobs != NULL)
+        jobs_free(sys->jobs);
+    sys->jobs = NULL;
+    teardown_system();
+    return result;
+}
+
+// n creatures spread over a 400x400 floor chase the player in the middle, which stands still;
+// once the thinks reach the budget, update_ai should cost about the same per tick from there to the biggest world
+static AiResult run_ai_lod(Int creatures, Int ticks)
+{
+    bench_seed = 1;
+    sys = new_system("bench", 0, 0);
+    new_map(sys, "bench", -1);
+    list_push(*sys->maps->data[0].hitboxes, ((BoundingBox){(Vector3){-200, -1, -200}, (Vector3){200, 0, 200}}));
+    reserve_world(sys, creatures + 1, 0);
+    set_player(sys, new_creature(sys, "player", 0, 0, 0));
+    Int target = creature(sys->player_index).id;
+    for (Int i = 0; i < creatures; i++)
+    {
+        Int index = new_creature(sys, "enemy", bench_random(-199, 199), 0, bench_random(-199, 199));
+        creature(index).target_id = target;
+    }
+
+    // the field over the whole floor and the first periods, before anything is timed
+    update_navigation(sys);
+    FlowField *field = nav_find_field(sys->nav, target);
+    while (field != NULL && field->goal < 0)
+        nav_update_field(sys->nav, field, NAV_MAX_CELLS);
+
+    // every creature thinks on its first turn; then the periods settle and the turns picked before they did run out,
+    // the longest one is the last to
+    update_ai(sys);
+    for (Int t = 0; t < sys->ai->periods[AI_LOD_LEVELS - 1]; t++)
+        update_ai(sys);
+
+    AiResult result = {0};
+    result.creatures = creatures;
+    result.ticks = ticks;
+    Int thinks = 0;
+    for (Int t = 0; t < ticks; t++)
+    {
+        update_ai(sys);
+        AiStats *stats = &sys->ai->stats;
+        result.ms_per_tick += stats->ms;
+        for (Int l = 0; l < AI_LOD_LEVELS; l++)
+            thinks += stats->thinks[l];
+    }
+    for (Int l = 0; l < AI_LOD_LEVELS; l++)
+    {
+        result.levels[l] = sys->ai->stats.creatures[l];
+        result.periods[l] = sys->ai->stats.periods[l];
+    }
+
+    result.thinks_per_tick = (double)thinks / ticks;
+    result.ms_per_tick /= ticks;
+
+    double start = now_ns();
+    field = NULL;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+        nav_steer(sys, sys->world.creatures->data[i], &field);
+
+    result.full_ms = (now_ns() - start) / 1e6;
+    teardown_system();
+    return result;
+}
+
+// map0's event.txt and three triggers of the bench's own on one vm, the way the server sets them up
+static void triggers_clear_messages(void)
+{
+    while (sys->messages->size > 0)
+        free(deque_shift(*sys->messages).text);
+}
+
+static bool triggers_fired_message(const char *text)
+{
+    return sys->messages->size > 0 && strcmp(deque_last(*sys->messages).text, text) == 0;
+}
+
+static TriggerResult run_triggers(void)
+{
+    TriggerResult result = {0};
+    VirtualMachine *vm = make_vm();
+    init_std(vm);
+    init_world(vm);
+    sys = new_system("bench", 0, 0);
+    sys->vm = vm;
+    sys->event_creature = register_number(vm, "event.creature", -1);
+    sys->event_trigger = register_number(vm, "event.trigger", -1);
+    data(register_var(vm, "game.system")).pointer = sys;
+
+    Int map_id = new_map(sys, "map0", -1);
+    Map *map = &sys->maps->data[map_id];
+    load_map_events(sys, map, "data/model/map0/event.txt");
+    new_trigger(sys, map, (BoundingBox){(Vector3){98, -1, 98}, (Vector3){102, 3, 102}}, EVENT_EXIT, "kill.creature game.system event.creature");
+    new_trigger(sys, map, (BoundingBox){(Vector3){-102, -1, 98}, (Vector3){-98, 3, 102}}, EVENT_STAY, "push.message game.system \"stay\"");
+
+    // the last one spawned, the leaver, takes the first one's place when that one is killed
+    new_creature(sys, "first", 0, 0, -100);
+    Int stayer = creature(new_creature(sys, "stayer", -100, 0, 100)).id;
+    Int walker = creature(new_creature(sys, "walker", 100, 0, -100)).id;
+    Int leaver = creature(new_creature(sys, "leaver", 100, 0, 100)).id;
+    update_triggers(sys);
+    kill_creature(sys, 0);
+
+    // one tick: the leaver walks out of the exit trigger and kills itself, the walker walks into the map0 entrance
+    creature(find_creature(sys, leaver, -1)).position = (Vector3){0, 0, -100};
+    creature(find_creature(sys, walker, -1)).position = (Vector3){6, 0, 46};
+    triggers_clear_messages();
+    update_triggers(sys);
+    result.exited = find_creature(sys, leaver, -1) < 0 && find_creature(sys, walker, -1) >= 0 && find_creature(sys, stayer, -1) >= 0;
+    result.entered = triggers_fired_message("welcome to brutopolis") && (Int)data(sys->event_creature).number == walker;
+
+    // the stayer has been in since the first tick, the others are out now
+    result.stayed = true;
+    for (Int t = 0; t < 3; t++)
+    {
+        triggers_clear_messages();
+        update_triggers(sys);
+        result.stayed = result.stayed && sys->trigger_fires->size == 1 && triggers_fired_message("stay") &&
+            (Int)data(sys->event_creature).number == stayer;
+    }
+
+    // 1024 creatures standing in the stay trigger, every one fires it every tick
+    for (Int i = 0; i < 1024; i++)
+        new_creature(sys, "crowd", -100, 0, 100);
+
+    update_triggers(sys);
+    double start = now_ns();
+    for (Int t = 0; t < 64; t++)
+    {
+        update_triggers(sys);
+        result.fires += sys->trigger_fires->size;
+    }
+    result.fire_ns = (now_ns() - start) / result.fires;
+
+    char command[] = "push.message game.system \"stay\"";
+    start = now_ns();
+    for (Int i = 0; i < result.fires; i++)
+        eval(vm, command, NULL);
+
+    result.eval_ns = (now_ns() - start) / result.fires;
+
+    teardown_system();
+    free_vm(vm);
+    return result;
+}
+
+static void write_json(FILE *file, BenchResultList *results, ScenarioResultList *scenarios, ReplicationResultList *replications, SaveResult *save, NavmeshResult *navmeshes, Int navmesh_count, AiResultList *ais, TriggerResult *triggers)
+{
+    fprintf(file, "{\n  \"config\": \"%s\",\n  \"compiler\": \"%s\",\n  \"benchmarks\": [\n", BENCH_CONFIG, __VERSION__);
+    for (Int i = 0; i < results->size; i++)
+    {
+        BenchResult *result = &results->data[i];
+        fprintf(file, "    {\"name\": \"%s\", \"iterations\": %ld, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f, \"mallocs_per_op\": %.3f}%s\n",
+            result->name, (long)result->iterations, result->ns_per_op, 1e9 / result->ns_per_op, result->mallocs_per_op, i + 1 < results->size ? "," : "");
+    }
+    fprintf(file, "  ],\n  \"scenarios\": [\n");
+    for (Int i = 0; i < scenarios->size; i++)
+    {
+        ScenarioResult *scenario = &scenarios->data[i];
+        fprintf(file, "    {\"name\": \"%s\", \"threads\": %ld, \"creatures\": %ld, \"bullets\": %ld, \"ticks\": %ld, \"ms_per_tick\": %.4f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"respawned\": %ld, \"frame_bytes_peak\": %ld, \"checksum\": \"%016lx\"}%s\n",
+            scenario->name, (long)scenario->threads, (long)scenario->creatures, (long)scenario->bullets, (long)scenario->ticks, scenario->ms_per_tick,
+            scenario->p50_ms, scenario->p99_ms, scenario->max_ms, (long)scenario->respawned, (long)scenario->frame_bytes_peak,
+            scenario->checksum, i + 1 < scenarios->size ? "," : "");
+    }
+    fprintf(file, "  ],\n  \"replication\": [\n");
+    for (Int i = 0; i < replications->size; i++)
+    {
+        ReplicationResult *replication = &replications->data[i];
+        fprintf(file, "    {\"name\": \"%s\", \"creatures\": %ld, \"clients\": %ld, \"ticks\": %ld, \"ms_per_tick\": %.4f, \"bytes_per_client\": %.1f, \"max_packet\": %ld, \"entities_per_client\": %.1f}%s\n",
+            replication->name, (long)replication->creatures, (long)replication->clients, (long)replication->ticks, replication->ms_per_tick,
+            replication->bytes_per_client, (long)replication->max_packet, replication->entities_per_client, i + 1 < replications->size ? "," : "");
+    }
+    fprintf(file, "  ]");
+    if (save != NULL)
+    {
+        fprintf(file, ",\n  \"save\": {\"creatures\": %ld, \"bullets\": %ld, \"file_mb\": %.2f, \"save_ms\": %.2f, \"fork_ms\": %.3f, \"async_ms\": %.2f, \"load_ms\": %.2f, \"match\": %s, "
+            "\"journal_creatures\": %ld, \"journal_kb\": %.1f, \"journal_ms\": %.2f, \"recover_ms\": %.2f, \"recovered\": %s}",
+            (long)save->creatures, (long)save->bullets, save->file_mb, save->save_ms, save->fork_ms, save->async_ms, save->load_ms, save->match ? "true" : "false",
+            (long)save->journal_creatures, save->journal_kb, save->journal_ms, save->recover_ms, save->recovered ? "true" : "false");
+    }
+    if (navmesh_count > 0)
+    {
+        fprintf(file, ",\n  \"navmesh\": [\n");
+        for (Int i = 0; i < navmesh_count; i++)
+        {
+            NavmeshResult *navmesh = &navmeshes[i];
+            fprintf(file, "    {\"map\": \"%s\", \"polys\": %ld, \"links\": %ld, \"build_ms\": %.2f, \"threads\": %ld, \"queries\": %ld, \"search_qps\": %.0f, "
+                "\"cold_qps\": %.0f, \"cold_hit_rate\": %.3f, \"cold_misses\": %ld, \"warm_qps\": %.0f, \"warm_hit_rate\": %.3f, \"warm_misses\": %ld, "
+                "\"found\": %.3f, \"off_mesh\": %.3f, \"unreachable\": %.3f, \"valid\": %.3f}%s\n",
+                navmesh->map, (long)navmesh->polys, (long)navmesh->links, navmesh->build_ms, (long)navmesh->threads, (long)navmesh->queries, navmesh->search_qps,
+                navmesh->cold_qps, navmesh->cold_hit_rate, (long)navmesh->cold_misses, navmesh->warm_qps, navmesh->warm_hit_rate, (long)navmesh->warm_misses,
+                navmesh->found, navmesh->off_mesh, navmesh->unreachable, navmesh->valid, i + 1 < navmesh_count ? "," : "");
+        }
+        fprintf(file, "  ]");
+    }
+    if (ais->size > 0)
+    {
+        fprintf(file, ",\n  \"ai_lod\": [\n");
+        for (Int i = 0; i < ais->size; i++)
+        {
+            AiResult *ai = &ais->data[i];
+            fprintf(file, "    {\"creatures\": %ld, \"ticks\": %ld, \"levels\": [%ld, %ld, %ld, %ld], \"periods\": [%ld, %ld, %ld, %ld], \"thinks_per_tick\": %.1f, \"ms_per_tick\": %.4f, \"full_ms\": %.4f}%s\n",
+                (long)ai->creatures, (long)ai->ticks, (long)ai->levels[0], (long)ai->levels[1], (long)ai->levels[2], (long)ai->levels[3],
+                (long)ai->periods[0], (long)ai->periods[1], (long)ai->periods[2], (long)ai->periods[3],
+                ai->thinks_per_tick, ai->ms_per_tick, ai->full_ms, i + 1 < ais->size ? "," : "");
+        }
+        fprintf(file, "  ]");
+    }
+    if (triggers != NULL)
+    {
+        fprintf(file, ",\n  \"triggers\": {\"entered\": %s, \"stayed\": %s, \"exited\": %s, \"fires\": %ld, \"fire_ns\": %.1f, \"eval_ns\": %.1f}",
+            triggers->entered ? "true" : "false", triggers->stayed ? "true" : "false", triggers->exited ? "true" : "false",
+            (long)triggers->fires, triggers->fire_ns, triggers->eval_ns);
+    }
+    fprintf(file, "\n}\n");
+}
+
+static void print_scenario(ScenarioResult *scenario, double baseline)
+{
+    printf("%-20s %8ld %12.4f %12.4f %12.4f %12.4f %9.2fx  %016lx\n", scenario->name, (long)scenario->threads, scenario->ms_per_tick,
+        scenario->p50_ms, scenario->p99_ms, scenario->max_ms, baseline / scenario->ms_per_tick, scenario->checksum);
+}
+
+int main(int argc, char **argv)
+{
+    char *filter = NULL;
+    char *out = NULL;
+    Int creatures = 256;
+    Int bullets = 1024;
+    Int ticks = 600;
+    Int threads = 1;
+    bool scaling = false;
+    Int net_creatures = 4096;
+    Int clients = 32;
+    Int save_creatures = 1000000;
+    char *save_path = "bench_world.sav";
+    char *map_path = "data/model/map0/map.obj";
+    Int path_queries = 100000;
+    Int ai_creatures = 1048576;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            out = argv[++i];
+        else if (strcmp(argv[i], "--creatures") == 0 && i + 1 < argc)
+            creatures = atol(argv[++i]);
+        else if (strcmp(argv[i], "--bullets") == 0 && i + 1 < argc)
+            bullets = atol(argv[++i]);
+        else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc)
+            ticks = atol(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atol(argv[++i]);
+        else if (strcmp(argv[i], "--scaling") == 0)
+            scaling = true;
+        else if (strcmp(argv[i], "--net-creatures") == 0 && i + 1 < argc)
+            net_creatures = atol(argv[++i]);
+        else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+            clients = atol(argv[++i]);
+        else if (strcmp(argv[i], "--save-creatures") == 0 && i + 1 < argc)
+            save_creatures = atol(argv[++i]);
+        else if (strcmp(argv[i], "--save-path") == 0 && i + 1 < argc)
+            save_path = argv[++i];
+        else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+            map_path = argv[++i];
+        else if (strcmp(argv[i], "--path-queries") == 0 && i + 1 < argc)
+            path_queries = atol(argv[++i]);
+        else if (strcmp(argv[i], "--ai-creatures") == 0 && i + 1 < argc)
+            ai_creatures = atol(argv[++i]);
+        else
+        {
+            printf("usage: %s [--filter name] [--out file.json] [--creatures N] [--bullets M] [--ticks T] [--threads N] [--scaling] [--net-creatures N] [--clients N] [--save-creatures N] [--save-path file] [--map file.obj] [--path-queries N] [--ai-creatures N]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (ticks < 1)
+        ticks = 1;
+
+    if (path_queries < 1)
+        path_queries = 1;
+
+    BenchResultList *results = list_init(BenchResultList);
+    printf("%-24s %12s %14s %14s\n", "benchmark", "iterations", "ns/op", "mallocs/op");
+    for (Int i = 0; i < (Int)(sizeof(benches) / sizeof(Bench)); i++)
+    {
+        if (filter != NULL && strstr(benches[i].name, filter) == NULL)
+            continue;
+
+        BenchResult result = run_bench(&benches[i]);
+        list_push(*results, result);
+        printf("%-24s %12ld %14.3f %14.3f\n", result.name, (long)result.iterations, result.ns_per_op, result.mallocs_per_op);
+    }
+
+    // world_tick runs with --threads workers,
+    // world_tick_scaling runs from 1 to --threads (or one per core) workers, doubling, and checks the results match
+    ScenarioResultList *scenarios = list_init(ScenarioResultList);
+    if (filter == NULL || strstr("world_tick", filter) != NULL)
+    {
+        printf("\nscenarios: %ld creatures, %ld bullets, %ld ticks\n", (long)creatures, (long)bullets, (long)ticks);
+        printf("%-20s %8s %12s %12s %12s %12s %10s  %s\n", "scenario", "threads", "ms/tick", "p50", "p99", "max", "speedup", "checksum");
+        ScenarioResult scenario = run_scenario("world_tick", creatures, bullets, ticks, threads);
+        list_push(*scenarios, scenario);
+        print_scenario(&scenario, scenario.ms_per_tick);
+    }
+
+    if (scaling)
+    {
+        Int max_threads = threads > 1 ? threads : sysconf(_SC_NPROCESSORS_ONLN);
+        double baseline = 0;
+        unsigned long checksum = 0;
+        bool deterministic = true;
+        for (Int n = 1; ; n *= 2)
+        {
+            if (n > max_threads)
+                n = max_threads;
+
+            ScenarioResult scenario = run_scenario("world_tick_scaling", creatures, bullets, ticks, n);
+            if (n == 1)
+            {
+                baseline = scenario.ms_per_tick;
+                checksum = scenario.checksum;
+            }
+            deterministic = deterministic && scenario.checksum == checksum;
+            list_push(*scenarios, scenario);
+            print_scenario(&scenario, baseline);
+            if (n == max_threads)
+                break;
+        }
+        printf("results %s across thread counts\n", deterministic ? "match" : "DIFFER");
+    }
+
+    // replicate_all sends the whole world to every client, replicate_interest only what is around each client
+    ReplicationResultList *replications = list_init(ReplicationResultList);
+    if (filter == NULL || strstr("replicate", filter) != NULL)
+    {
+        printf("\nreplication: %ld creatures, %ld clients, %ld ticks\n", (long)net_creatures, (long)clients, (long)ticks);
+        printf("%-20s %12s %16s %12s %18s\n", "replication", "ms/tick", "bytes/client", "max packet", "entities/client");
+        ReplicationResult all = run_replication("replicate_all", net_creatures, clients, ticks, false);
+        ReplicationResult interest = run_replication("replicate_interest", net_creatures, clients, ticks, true);
+        list_push(*replications, all);
+        list_push(*replications, interest);
+        for (Int i = 0; i < replications->size; i++)
+        {
+            ReplicationResult *result = &replications->data[i];
+            printf("%-20s %12.4f %16.1f %12ld %18.1f\n", result->name, result->ms_per_tick, result->bytes_per_client,
+                (long)result->max_packet, result->entities_per_client);
+        }
+    }
+
+    SaveResult save;
+    bool saved = false;
+    if (filter == NULL || strstr("save", filter) != NULL)
+    {
+        save = run_save(save_creatures, save_path);
+        saved = true;
+        printf("\nsave: %ld creatures, %ld bullets, %.1f MB\n", (long)save.creatures, (long)save.bullets, save.file_mb);
+        printf("%12s %12s %12s %12s  %s\n", "save ms", "fork ms", "async ms", "load ms", "loaded");
+        printf("%12.2f %12.3f %12.2f %12.2f  %s\n", save.save_ms, save.fork_ms, save.async_ms, save.load_ms, save.match ? "matches" : "DIFFERS");
+        printf("journal: %ld dirty creatures\n", (long)save.journal_creatures);
+        printf("%12s %12s %12s  %s\n", "entry KB", "append ms", "recover ms", "recovered");
+        printf("%12.1f %12.2f %12.2f  %s\n", save.journal_kb, save.journal_ms, save.recover_ms, save.recovered ? "matches" : "DIFFERS");
+    }
+
+    // path queries on --map and on the generated pillars map with --threads workers: first searched one by one without the cache,
+    // then batched with the cache empty at the start, then the same batch again warm
+    NavmeshResult navmeshes[2];
+    Int navigated = 0;
+    if (filter == NULL || strstr("navmesh", filter) != NULL)
+    {
+        const char *maps[2] = {map_path, NULL};
+        printf("\n%-28s %8s %8s %8s %8s %10s %12s %12s %10s %9s %12s %10s %9s %8s %8s %8s %8s\n", "navmesh", "polys", "links", "build ms", "threads", "queries",
+            "search q/s", "cold q/s", "cold hits", "cold miss", "warm q/s", "warm hits", "warm miss", "found", "off mesh", "no way", "valid");
+        for (Int i = 0; i < 2; i++)
+        {
+            NavmeshResult navmesh = run_navmesh(maps[i], path_queries, threads);
+            navmeshes[navigated++] = navmesh;
+            printf("%-28s %8ld %8ld %8.2f %8ld %10ld %12.0f %12.0f %10.3f %9ld %12.0f %10.3f %9ld %8.3f %8.3f %8.3f %8.3f\n", navmesh.map, (long)navmesh.polys,
+                (long)navmesh.links, navmesh.build_ms, (long)navmesh.threads, (long)navmesh.queries, navmesh.search_qps, navmesh.cold_qps, navmesh.cold_hit_rate,
+                (long)navmesh.cold_misses, navmesh.warm_qps, navmesh.warm_hit_rate, (long)navmesh.warm_misses, navmesh.found, navmesh.off_mesh,
+                navmesh.unreachable, navmesh.valid);
+        }
+    }
+
+    // ai scheduling from 16k creatures up to --ai-creatures, four times more each step;
+    // fails the run when a world costs more than AI_FLAT_RATIO times the ms/tick of the first one that reached the budget
+    AiResultList *ais = list_init(AiResultList);
+    bool flat = true;
+    if (filter == NULL || strstr("ai_lod", filter) != NULL)
+    {
+        double budget_ms = 0;
+        printf("\nai lod: %d levels, think budget %d\n", AI_LOD_LEVELS, AI_THINK_BUDGET);
+        printf("%10s %28s %20s %12s %12s %12s\n", "creatures", "per level", "periods", "thinks/tick", "ms/tick", "full ms");
+        for (Int n = 16384; ; n *= 4)
+        {
+            if (n > ai_creatures)
+                n = ai_creatures;
+
+            AiResult ai = run_ai_lod(n, 64);
+            list_push(*ais, ai);
+            printf("%10ld %6ld %6ld %7ld %7ld %4ld %4ld %4ld %5ld %12.1f %12.4f %12.4f\n", (long)ai.creatures, (long)ai.levels[0], (long)ai.levels[1],
+                (long)ai.levels[2], (long)ai.levels[3], (long)ai.periods[0], (long)ai.periods[1], (long)ai.periods[2], (long)ai.periods[3],
+                ai.thinks_per_tick, ai.ms_per_tick, ai.full_ms);
+            if (budget_ms == 0 && ai.thinks_per_tick >= AI_THINK_BUDGET * 3 / 4)
+                budget_ms = ai.ms_per_tick;
+            else if (budget_ms > 0 && ai.ms_per_tick > budget_ms * AI_FLAT_RATIO)
+                flat = false;
+
+            if (n == ai_creatures)
+                break;
+        }
+        printf("ms/tick %s past the budget\n", flat ? "stays flat" : "GROWS");
+    }
+
+    // enter, stay and exit triggers fire their scripts for the right creature, and what a fire costs
+    TriggerResult triggers;
+    bool triggered = false;
+    if (filter == NULL || strstr("triggers", filter) != NULL)
+    {
+        triggers = run_triggers();
+        triggered = true;
+        printf("\ntriggers: enter %s, stay %s, exit %s\n", triggers.entered ? "fires" : "FAILS", triggers.stayed ? "fires" : "FAILS", triggers.exited ? "fires" : "FAILS");
+        printf("%10s %12s %12s\n", "fires", "fire ns", "eval ns");
+        printf("%10ld %12.1f %12.1f\n", (long)triggers.fires, triggers.fire_ns, triggers.eval_ns);
+    }
+
+    if (out != NULL)
+    {
+        FILE *file = fopen(out, "w");
+        if (file == NULL)
+        {
+            printf("could not open %s\n", out);
+            return 1;
+        }
+        write_json(file, results, scenarios, replications, saved ? &save : NULL, navmeshes, navigated, ais, triggered ? &triggers : NULL);
+        fclose(file);
+    }
+
+    list_free(*results);
+    list_free(*scenarios);
+    list_free(*replications);
+    list_free(*ais);
+    return flat && (!triggered || (triggers.entered && triggers.stayed && triggers.exited)) ? 0 : 1;
+}
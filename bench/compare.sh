@@ -0,0 +1,21 @@
+#!/bin/sh
+# prints the world_tick scenario of each bench json side by side, the first file is the baseline
+# usage: bench/compare.sh build/release/bench.json build/pgo/bench.json ...
+
+awk '
+function field(line, name,    rest)
+{
+    rest = substr(line, index(line, "\"" name "\": ") + length(name) + 4)
+    gsub(/^"/, "", rest)
+    match(rest, /^[^,"}]*/)
+    return substr(rest, 1, RLENGTH)
+}
+BEGIN { printf "%-12s %12s %12s %12s %12s %10s\n", "config", "ms/tick", "p50", "p99", "max", "speedup" }
+/"config":/ { config = field($0, "config") }
+/"name": "world_tick"/ {
+    ms = field($0, "ms_per_tick")
+    if (base == "")
+        base = ms
+    printf "%-12s %12s %12s %12s %12s %9.2fx\n", config, ms, field($0, "p50_ms"), field($0, "p99_ms"), field($0, "max_ms"), base / ms
+}
+' "$@"
@@ -17,4 +17,9 @@ if [ -n "$SETUP" ]; then
 	rm -rf bruter
 fi
 
-emcc -o build/index.html src/main.c -Llib/web -Iinclude -lbruter -lraylib -s USE_GLFW=3 -s ASYNCIFY --shell-file src/minshell.html --preload-file data
\ No newline at end of file
+# the lod chains are cooked by a native build of the cooker into a copy of data, which is what gets preloaded
+cc -O2 -Iinclude -no-pie -o build/cook src/cook.c src/lod.c -Llib -lbruter -lm -lpthread
+cp -r data build/data
+./build/cook $(find build/data -name '*.obj')
+
+emcc -o build/index.html src/main.c src/brutopolis.c src/save.c src/nav.c src/ai.c src/lod.c -Llib/web -Iinclude -lbruter -lraylib -s USE_GLFW=3 -s ASYNCIFY --shell-file src/minshell.html --preload-file build/data@data
\ No newline at end of file
@@ -1,3 +1,2 @@
-rm -rf build/data
-cp -r data build/data
-gcc -o build/brutopolis2 src/main.c -Llib -Iinclude -lbruter -lraylib -lGL -lm -lpthread -ldl -lrt -lX11
\ No newline at end of file
+# CONFIG=debug|release|lto|pgo ./build.sh, see the Makefile
+make CONFIG=${CONFIG:-release} game
@@ -0,0 +1,78 @@
+// brutopolis creature ai scheduling, level of detail by distance to the observers
+#ifndef AI_H
+#define AI_H 1
+
+#include "brutopolis.h"
+
+// the creatures with something to do (a target) think in turns by creature id (round robin), once every period ticks of their level,
+// and between two thinks keep doing what they decided last (Creature.steer);
+// a creature only gets a new level, by its distance to the closest observer, when it thinks,
+// so a level change shows up within one period of the old level and the distances cost no more than the thinks;
+// level 0 thinks every tick as long as it fits in its share of the budget;
+// every creature waits for its turn in a wheel of per tick buckets (the bucket of tick t is t % AI_WHEEL_SIZE),
+// so a tick only visits the creatures whose turn it is, never the whole world;
+// one without a target is looked at again once every period of the last level, and starts thinking on that turn once it has one
+#define AI_LOD_LEVELS 4
+// farther than this from every observer is level 1, 2, 3
+#define AI_LOD_NEAR 24.0f
+#define AI_LOD_MID 64.0f
+#define AI_LOD_FAR 160.0f
+// thinks per tick for every level; past it the periods are stretched, worked out from the level sizes of the tick before;
+// level 0 gets up to half of it before its own period is stretched, levels 1 and up share what level 0 leaves;
+// so the thinks (and the distances) stay under it at any creature count
+#define AI_THINK_BUDGET 4096
+// ticks the wheel covers; a longer period is fine, a creature just stays in its bucket for whole turns of the wheel
+#define AI_WHEEL_SIZE 1024
+#define AI_MAX_OBSERVERS 64
+
+// separation: agents closer than the radius push each other apart, every tick and at every level;
+// neighbours come from a spatial hash with radius sized cells, copied into plain arrays per cell (see separation_job)
+#define AI_SEPARATION_RADIUS 1.0f
+// neighbours one agent looks at, only reached by crowds packed far tighter than a creature's size
+#define AI_SEPARATION_MAX_NEIGHBOURS 256
+// how hard a close neighbour pushes, compared to the unit move an agent steers with
+#define AI_SEPARATION_STRENGTH 2.0f
+
+typedef struct
+{
+    Int creatures[AI_LOD_LEVELS]; // in each level this tick
+    Int thinks[AI_LOD_LEVELS]; // that thought this tick
+    Int periods[AI_LOD_LEVELS]; // ticks between two thinks this tick
+    Int observers;
+    double ms; // the whole update_ai
+    Int agents; // separated this tick
+    Int pushed; // agents with somebody closer than AI_SEPARATION_RADIUS
+    double separation_ms;
+} AiStats;
+
+struct AiScheduler
+{
+    Vector3 observers[AI_MAX_OBSERVERS]; // added since the last update_ai, none means the player
+    Int observer_count;
+    Int tick;
+    Int periods[AI_LOD_LEVELS];
+    Int levels[AI_LOD_LEVELS]; // creatures with a target in each level, as of their last turn
+    CreatureList *wheel[AI_WHEEL_SIZE]; // every creature, in the bucket of its ai_turn at ai_slot
+    CreatureList *due; // taken out of this tick's bucket
+    IntList *due_levels; // their ai_level before the turn
+    Int thinks[JOBS_MAX_WORKERS][AI_LOD_LEVELS]; // per worker while the pass runs, summed into stats
+    SpatialHash *crowd; // agents this tick
+    // crowd->entries as plain arrays, same order
+    float *crowd_x, *crowd_z;
+    int *crowd_cell_x, *crowd_cell_z;
+    float *crowd_push_x, *crowd_push_z; // what the neighbours add to the move
+    Int crowd_capacity;
+    Int *crowd_slot; // per creature index, its entry, only valid for agents
+    Int slot_capacity;
+    AiStats stats; // last tick
+};
+
+AiScheduler* ai_init(void);
+void ai_free(AiScheduler* ai);
+void ai_enroll(AiScheduler* ai, Creature* c);
+void ai_forget(AiScheduler* ai, Creature* c);
+bool ai_observe(InternalSystem* sys, Vector3 position);
+void update_ai(InternalSystem* sys);
+void update_separation(InternalSystem* sys);
+
+#endif
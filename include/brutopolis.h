@@ -1,4 +1,445 @@
 // brutopolis engine header
+#ifndef BRUTOPOLIS_H
+#define BRUTOPOLIS_H 1
+
 #include "raylib.h"
+// raymath functions are static inline, so the simulation does not need libraylib at link time
+#ifndef RAYMATH_STATIC_INLINE
+#define RAYMATH_STATIC_INLINE
+#endif
 #include "raymath.h"
+#include <math.h>
+#include <stdatomic.h>
 #include "bruter.h"
+#include "c_arena.h"
+#include "c_slab.h"
+#include "c_profiler.h"
+#include "c_jobs.h"
+
+#define MAX_ENEMIES 10
+#define BULLET_SPEED 1.0f
+#define BULLET_RANGE 50.0f
+
+// simulation ticks per second, headless loops advance sys->time by 1/TICK_RATE per tick
+#define TICK_RATE 60
+
+enum
+{
+    ITEM_HAND,
+    ITEM_REVOLVER,
+    ITEM_BULLET_REVOLVER,
+    ITEM_COUNT
+};
+
+extern const char* item_names[];
+extern const char* equip_image_paths[];
+extern const char* item_image_paths[];
+extern const int item_capacities[];
+
+// CREATURE DEFINES
+#define CREATURE_IDLE 0
+#define CREATURE_RELOAD 1
+#define CREATURE_SHOOT 2
+
+// EVENT DEFINES
+#define EVENT_ENTER 0
+#define EVENT_EXIT 1
+#define EVENT_STAY 2
+
+// how many trigger volumes a creature can be inside at the same time
+#define MAX_CREATURE_TRIGGERS 8
+// trigger volumes are bucketed in a xz grid, a creature only tests the volumes of its own cell
+#define TRIGGER_CELL_SIZE 8.0f
+#define TRIGGER_GRID_BUCKETS 256
+
+// points bucketed by xz cell into SPATIAL_HASH_BUCKETS, the cell size is up to the user
+#define SPATIAL_HASH_BUCKETS 4096
+
+// MESSAGE DEFINES
+#define MAX_MESSAGES 8
+#define MESSAGE_DURATION 3.0
+
+// INPUT DEFINES
+#define INPUT_LOOK 0
+#define INPUT_MOVE 1
+#define INPUT_FIRE 2
+#define INPUT_RELOAD 3
+#define INPUT_WHEEL 4
+#define INPUT_MESSAGE 5
+#define INPUT_SAVE 6
+#define INPUT_LOAD 7
+
+// events an input queue holds, the window thread samples about once per INPUT_POLL_INTERVAL
+#define INPUT_QUEUE_SIZE 4096
+#define INPUT_POLL_INTERVAL 0.001
+// a shot is moved forward by at most this many ticks to catch up with its timestamp
+#define MAX_SHOT_LEAD_TICKS 2
+
+// longest message kept in a render snapshot
+#define MAX_MESSAGE_LENGTH 128
+
+// initial size of the per frame arena, it grows to the biggest frame seen
+#define FRAME_ARENA_SIZE (256 * 1024)
+
+// elements per slab page
+#define CREATURE_PAGE_SIZE 256
+#define BULLET_PAGE_SIZE 1024
+#define ITEM_PAGE_SIZE 256
+
+// elements per job in the parallel passes
+#define CREATURE_JOB_GRAIN 64
+#define BULLET_JOB_GRAIN 256
+
+typedef struct
+{
+    Vector3 position;
+    char type;
+    Int capacity; // if storage
+    Int content_type;
+    Int content;
+} Item;
+typedef List(Item*) ItemList;
+typedef Slab(Item) ItemSlab;
+
+// up to INVENTORY_INLINE items are stored inside the creature itself
+#define INVENTORY_INLINE 8
+typedef SmallList(Item, INVENTORY_INLINE) Inventory;
+
+typedef struct
+{
+    Int id; // unique for the world lifetime, list indexes change on every removal
+    // next to the id, the ai pass reads these for the creatures whose turn it is (ai.h)
+    Int target_id; // creature it walks after with the flow fields (nav.h), -1 for none
+    Vector3 steer; // move the ai decided on when it last thought, repeated every tick until it thinks again
+    int ai_level; // level it got when it last thought, -1 before its first think and while it has no target
+    Int ai_turn; // ai tick of its next think, picked with that level's period (ai.h)
+    Int ai_period; // that period
+    Int ai_slot; // where it waits in the bucket of ai_turn
+    Vector3 move; // requested move, applied and cleared by update_movement
+    char* name;
+    Vector3 position;
+    Vector3 size;
+    Vector3 rotation;
+    Vector3 direction;
+    Color color;
+    Float speed;
+    Inventory inventory;
+    Int item_slots[ITEM_COUNT]; // first inventory slot of each item type, -1 if none
+    Int current_item;
+    Int status;
+    Vector3 last_position; // position on the last trigger update
+    Int triggers[MAX_CREATURE_TRIGGERS]; // trigger volumes the creature is inside
+    Int trigger_count;
+    bool dirty; // changed since the last journal entry, see mark_dirty
+} Creature;
+typedef List(Creature*) CreatureList;
+typedef Slab(Creature) CreatureSlab;
+
+typedef struct
+{
+    Int id; // shares the creature id sequence
+    Vector3 position;
+    Vector3 direction;
+    Float speed;
+    Vector3 origin; // where it was fired, it is dropped BULLET_RANGE away from there
+} Bullet;
+typedef List(Bullet*) BulletList;
+typedef Slab(Bullet) BulletSlab;
+
+// the lists hold pointers into the slabs, so a creature/bullet/item address is stable for its whole life
+typedef struct
+{
+    CreatureList *creatures;
+    BulletList *bullets;
+    ItemList *items;
+    CreatureSlab *creature_slab;
+    BulletSlab *bullet_slab;
+    ItemSlab *item_slab;
+    Int next_id; // next creature/bullet id
+    bool track_changes; // mark_dirty and kill_creature only record anything while this is set (autosave is on)
+    CreatureList *dirty[JOBS_MAX_WORKERS]; // creatures marked since the last journal entry, one list per job worker
+    IntList *removed; // ids of the creatures killed since the last journal entry
+} World;
+
+typedef struct
+{
+    Vector2 delta; // where applies
+    Vector2 position; // where applies
+    float sensibility;
+} Mouse;
+
+typedef List(BoundingBox) BoundingBoxList;
+
+
+
+typedef struct
+{
+    char* text;
+    double time; // sys->time when pushed
+} Message;
+typedef Deque(Message) MessageDeque;
+
+typedef List(Texture2D) TextureList;
+typedef List(Model) ModelList;
+
+// simplified copies of a model, cooked next to it as name.lod1.obj, name.lod2.obj... (lod.h)
+#define MODEL_LOD_LEVELS 4
+
+typedef struct
+{
+    Int count; // levels found, level 0 is the model itself
+    Model levels[MODEL_LOD_LEVELS];
+    Int triangles[MODEL_LOD_LEVELS];
+    Vector3 center; // bounding sphere of level 0, in model space
+    float radius;
+    RenderTexture2D impostor; // views around the model (lod.h), id 0 when there is none
+} ModelLod;
+typedef List(ModelLod) ModelLodList;
+
+typedef List(IntList*) CommandList;
+
+typedef struct
+{
+    BoundingBox box;
+    char kind; // EVENT_ENTER, EVENT_EXIT or EVENT_STAY
+    CommandList *commands; // body parsed once at map load
+} Trigger;
+typedef List(Trigger) TriggerList;
+
+// a trigger a creature set off, by creature id since the scripts run after the scan (see update_triggers)
+typedef struct
+{
+    Int creature_id;
+    Int creature_index; // at the time of the scan, where find_creature looks first
+    Int trigger_id;
+} TriggerFire;
+typedef List(TriggerFire) TriggerFireList;
+
+typedef struct
+{
+    Int model_id;
+    BoundingBoxList *hitboxes;
+    char* name;
+    TriggerList *triggers;
+    IntListList *trigger_grid; // TRIGGER_GRID_BUCKETS lists of trigger ids
+} Map;
+
+typedef List(Map) MapList;
+
+typedef struct
+{
+    int cell_x, cell_z;
+    Vector3 position;
+    Int index; // whatever the user inserted, usually an index into its own list
+} SpatialEntry;
+typedef List(SpatialEntry) SpatialEntryList;
+
+// rebuilt from scratch whenever the points move: clear, insert every point, build, then query;
+// build sorts the entries by bucket so a query reads each bucket as one contiguous run
+typedef struct
+{
+    float cell_size;
+    SpatialEntryList *pending; // inserted since the last clear
+    SpatialEntryList *entries; // pending sorted by bucket
+    Int starts[SPATIAL_HASH_BUCKETS + 1]; // bucket b is entries[starts[b]] to entries[starts[b + 1]]
+} SpatialHash;
+
+// flow fields and the walkable grid, nav.h
+typedef struct Navigation Navigation;
+// level of detail scheduling of the creature ai, ai.h
+typedef struct AiScheduler AiScheduler;
+
+typedef struct
+{
+    char* name;
+    Int player_id; // creature the player controls, -1 for none
+    Int player_index; // where it is in the world list, -1 while it is gone; see set_player and resolve_player
+    Vector2 resolution;
+    World world;
+    Camera camera;
+    Mouse mouse;
+    TextureList *equip_textures;
+    TextureList *item_textures;
+    ModelList *models;
+    ModelLodList *model_lods; // same index as models
+    MapList *maps;
+    Int current_map;
+    VirtualMachine *vm; // used to run map event scripts
+    Int event_creature; // stack index of event.creature
+    Int event_trigger; // stack index of event.trigger
+    TriggerFireList *trigger_fires; // found by the last update_triggers scan
+    MessageDeque *messages; // player messages, oldest first
+    Arena *frame_arena; // transient per tick data, reset by end_frame
+    Int frame_bytes; // frame arena usage of the last frame
+    Int frame_bytes_peak; // highest frame_bytes so far
+    double time; // seconds, GetTime() with a window, advanced per tick when headless
+    JobSystem *jobs; // runs the parallel passes of world_tick, NULL runs them on the calling thread
+    Navigation *nav;
+    AiScheduler *ai;
+} InternalSystem;
+
+// raw input, sampled by the window thread with a timestamp and queued for the simulation
+typedef struct
+{
+    char type; // INPUT_*
+    Int sequence; // set by input_push, increasing
+    double time; // GetTime() when it was sampled
+    Vector3 value; // look: x y mouse delta, move: held direction, reload: x 1 held 0 released, wheel: x steps
+    const char* text; // INPUT_MESSAGE only, must outlive the queue (a literal)
+} InputEvent;
+
+// single producer (window thread) single consumer (simulation) ring, pushing and popping never wait
+typedef struct
+{
+    InputEvent events[INPUT_QUEUE_SIZE];
+    atomic_long head; // next event to pop, written by the consumer
+    atomic_long tail; // next free slot, written by the producer
+    Int dropped; // events lost to a full queue, producer only
+} InputQueue;
+
+// what the simulation keeps between ticks: held keys and how much input it has applied so far
+typedef struct
+{
+    Vector3 move; // keys held, x forward and z right, -1 to 1
+    bool reload; // held
+    Int sequence; // last applied event, -1 before the first
+    double time; // time of the last applied event
+    double look_x, look_y; // sum of every applied look delta, the renderer compares it with its own sum
+} PlayerInput;
+
+typedef struct
+{
+    Vector3 position;
+    Vector3 rotation;
+    Int id;
+} CreatureView;
+typedef List(CreatureView) CreatureViewList;
+typedef List(Vector3) Vector3List;
+
+// everything the renderer needs from one tick, copied out of the world by publish_snapshot
+typedef struct
+{
+    Int tick;
+    Camera camera;
+    Int map_model; // model of the current map, -1 while there is no map
+    Int player_index;
+    Vector3 player_position;
+    Int player_slot; // current inventory slot
+    Item player_item; // copy of the item in that slot
+    CreatureViewList *creatures;
+    Vector3List *bullets;
+    char messages[MAX_MESSAGES][MAX_MESSAGE_LENGTH]; // oldest first
+    Int message_count;
+    Vector3 player_rotation;
+    Int input_sequence; // PlayerInput.sequence after this tick
+    double input_time; // PlayerInput.time after this tick
+    double look_x, look_y; // PlayerInput.look_x/y after this tick
+    Int frame_bytes;
+    Int frame_bytes_peak;
+    Int creatures_live, creatures_peak;
+    Int bullets_live, bullets_peak;
+    Int items_live, items_peak;
+} Snapshot;
+
+// triple buffer: the simulation always has a slot to write and the renderer always has one to read,
+// publishing and acquiring are a single atomic exchange, neither side ever waits for the other
+#define SNAPSHOT_FRESH 4
+typedef struct
+{
+    Snapshot slots[3];
+    atomic_int ready; // slot of the newest published snapshot, | SNAPSHOT_FRESH until the renderer takes it
+    int write; // slot owned by the simulation
+    int read; // slot owned by the renderer
+} SnapshotBuffer;
+
+// macro to acess *sys->world.creatures->data[name];
+#define creature(name) (*sys->world.creatures->data[name])
+#define bullet(name) (*sys->world.bullets->data[name])
+
+// same test as raylib CheckCollisionBoxSphere, inlined so the simulation does not need raylib at link time
+static inline bool box_sphere_collision(BoundingBox box, Vector3 center, float radius)
+{
+    float dmin = 0;
+    if (center.x < box.min.x) dmin += (center.x - box.min.x) * (center.x - box.min.x);
+    else if (center.x > box.max.x) dmin += (center.x - box.max.x) * (center.x - box.max.x);
+    if (center.y < box.min.y) dmin += (center.y - box.min.y) * (center.y - box.min.y);
+    else if (center.y > box.max.y) dmin += (center.y - box.max.y) * (center.y - box.max.y);
+    if (center.z < box.min.z) dmin += (center.z - box.min.z) * (center.z - box.min.z);
+    else if (center.z > box.max.z) dmin += (center.z - box.max.z) * (center.z - box.max.z);
+    return dmin <= radius * radius;
+}
+
+// system
+InternalSystem* new_system(char* name, int size_x, int size_y);
+void free_system(InternalSystem* _sys);
+void reset_frame(InternalSystem* _sys);
+
+// messages
+void push_message(InternalSystem* _sys, const char* text);
+void expire_messages(InternalSystem* _sys);
+
+// world
+Int new_creature(InternalSystem* _sys, const char* name, int x, int y, int z);
+void kill_creature(InternalSystem* _sys, Int id);
+Int find_creature(InternalSystem* _sys, Int id, Int hint);
+void set_player(InternalSystem* _sys, Int index);
+void resolve_player(InternalSystem* _sys);
+void mark_dirty(InternalSystem* _sys, Creature* creature);
+void clear_dirty(InternalSystem* _sys);
+void reserve_world(InternalSystem* _sys, Int creatures, Int bullets);
+Bullet* new_bullet(InternalSystem* _sys, Vector3 position, Vector3 direction, Float speed);
+void remove_bullet(InternalSystem* _sys, Int id);
+BoundingBox creature_hitbox(Vector3 position);
+
+// items
+Item make_item(char* name, char type, int capacity, int content_type, int content);
+Item* new_item(InternalSystem* _sys, char* name, char type, int capacity, int content_type, int content);
+void remove_item(InternalSystem* _sys, Int id);
+void inventory_add(Creature* creature, Item item);
+void inventory_remove(Creature* creature, Int slot);
+void reload_item(InternalSystem* sys, Creature* creature);
+void use_item(InternalSystem* sys, Creature* creature);
+
+// maps and events
+Int new_map(InternalSystem* sys, char* name, int model_id);
+void new_trigger(InternalSystem* sys, Map* map, BoundingBox box, char kind, char* body);
+void load_map_events(InternalSystem* sys, Map* map, char* path);
+bool load_obj_hitboxes(char* path, BoundingBoxList* hitboxes, BoundingBox* bounds);
+
+// spatial hash
+SpatialHash* spatial_hash_init(float cell_size);
+void spatial_hash_free(SpatialHash* hash);
+void spatial_hash_clear(SpatialHash* hash);
+void spatial_hash_insert(SpatialHash* hash, Int index, Vector3 position);
+void spatial_hash_build(SpatialHash* hash);
+Int spatial_hash_bucket(int cell_x, int cell_z);
+Int spatial_hash_query(SpatialHash* hash, Vector3 center, float radius, IntList* out);
+void fire_trigger(InternalSystem* sys, Int creature_id, Int trigger_id);
+void update_triggers(InternalSystem* sys);
+
+// simulation
+bool check_move_collision(InternalSystem* sys, Vector3 position, Vector3 move, float size);
+void move_creature(InternalSystem* sys, Int id, Vector3 move);
+void update_movement(InternalSystem* sys);
+void update_bullets(InternalSystem* sys);
+void update_gravity(InternalSystem* sys);
+void world_tick(InternalSystem* sys);
+
+// input and snapshots
+InputQueue* input_queue_init(void);
+void input_queue_free(InputQueue* queue);
+bool input_push(InputQueue* queue, InputEvent event);
+bool input_pop(InputQueue* queue, InputEvent* event);
+Vector3 apply_look(Vector3 rotation, Vector2 delta, float sensibility);
+Vector3 look_direction(Vector3 rotation);
+void init_player_input(PlayerInput* input);
+void apply_player_input(InternalSystem* sys, InputQueue* queue, PlayerInput* input);
+SnapshotBuffer* snapshot_buffer_init(void);
+void snapshot_buffer_free(SnapshotBuffer* buffer);
+void publish_snapshot(InternalSystem* sys, SnapshotBuffer* buffer, PlayerInput* input);
+Snapshot* acquire_snapshot(SnapshotBuffer* buffer);
+
+// scripting
+void init_world(VirtualMachine *vm);
+
+#endif
@@ -0,0 +1,181 @@
+// header only,
+// easy to use,
+// c bump arena implementation
+// by @jardimdanificado
+// c_arena.h
+
+// example usage:
+/*
+    Arena *arena = arena_init(4096);
+    char *str = arena_strdup(arena, "hello");
+    Vector3 *v = arena_new(arena, Vector3);
+    Int *ints = arena_array(arena, Int, 64);
+    arena_reset(arena); // everything above is gone, O(1)
+    arena_free(arena);
+*/
+
+// you might want to define Int before including this file, same as c_list.h;
+#ifndef Int
+#define Int int
+#endif
+
+#ifndef C_ARENA_H
+#define C_ARENA_H 1
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+// with ARENA_DEBUG defined, reset fills the released memory with ARENA_POISON,
+// so anything still pointing into the arena reads garbage instead of stale but plausible data
+#ifndef ARENA_POISON
+#define ARENA_POISON 0xCD
+#endif
+
+// every allocation is aligned to this
+#define ARENA_ALIGN (sizeof(void*) * 2)
+
+#define arena_align_up(n) (((n) + ARENA_ALIGN - 1) & ~(Int)(ARENA_ALIGN - 1))
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    Int capacity;
+    Int used;
+    char *data;
+} ArenaBlock;
+
+typedef struct
+{
+    ArenaBlock *head; // current block, older blocks are chained through next
+    Int block_size;
+    Int used; // bytes handed out since the last reset
+    Int peak; // highest used ever seen
+    Int allocations; // allocations since the last reset
+} Arena;
+
+static inline ArenaBlock* arena_block_new(Int capacity)
+{
+    ArenaBlock *block = (ArenaBlock*)malloc(sizeof(ArenaBlock) + capacity + ARENA_ALIGN);
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    // first byte after the header, aligned
+    block->data = (char*)(((uintptr_t)(block + 1) + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    return block;
+}
+
+// malloc and initialize a new arena, block_size is the size of the first block
+static inline Arena* arena_init(Int block_size)
+{
+    Arena *arena = (Arena*)malloc(sizeof(Arena));
+    arena->block_size = block_size > 0 ? block_size : 4096;
+    arena->head = arena_block_new(arena->block_size);
+    arena->used = 0;
+    arena->peak = 0;
+    arena->allocations = 0;
+    return arena;
+}
+
+static inline void* arena_alloc(Arena *arena, Int size)
+{
+    size = arena_align_up(size);
+    if (arena->head->used + size > arena->head->capacity)
+    {
+        // out of space, chain a new block, the old one stays valid until the next reset
+        Int capacity = arena->block_size > size ? arena->block_size : size;
+        ArenaBlock *block = arena_block_new(capacity);
+        block->next = arena->head;
+        arena->head = block;
+    }
+    void *ptr = arena->head->data + arena->head->used;
+    arena->head->used += size;
+    arena->used += size;
+    arena->allocations++;
+    if (arena->used > arena->peak)
+    {
+        arena->peak = arena->used;
+    }
+    return ptr;
+}
+
+#define arena_new(arena, type) ((type*)arena_alloc(arena, sizeof(type)))
+
+#define arena_array(arena, type, count) ((type*)arena_alloc(arena, sizeof(type) * (count)))
+
+static inline char* arena_strdup(Arena *arena, const char *str)
+{
+    Int len = strlen(str);
+    char *dup = (char*)arena_alloc(arena, len + 1);
+    memcpy(dup, str, len + 1);
+    return dup;
+}
+
+static inline char* arena_strndup(Arena *arena, const char *str, Int n)
+{
+    char *dup = (char*)arena_alloc(arena, n + 1);
+    memcpy(dup, str, n);
+    dup[n] = '\0';
+    return dup;
+}
+
+// drop everything allocated since the last reset;
+// O(1) unless the arena overflowed its block, in that case the chain is merged into a single bigger block,
+// so the next cycle with the same usage fits without overflowing again;
+static inline void arena_reset(Arena *arena)
+{
+#ifdef ARENA_DEBUG
+    for (ArenaBlock *block = arena->head; block != NULL; block = block->next)
+    {
+        memset(block->data, ARENA_POISON, block->used);
+    }
+#endif
+    if (arena->head->next != NULL)
+    {
+        Int total = 0;
+        ArenaBlock *block = arena->head;
+        while (block != NULL)
+        {
+            ArenaBlock *next = block->next;
+            total += block->capacity;
+            free(block);
+            block = next;
+        }
+        arena->block_size = total;
+        arena->head = arena_block_new(total);
+    }
+    arena->head->used = 0;
+    arena->used = 0;
+    arena->allocations = 0;
+}
+
+// printf into the arena, the string lives until the next reset
+static inline char* arena_format(Arena *arena, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    Int length = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    char *str = (char*)arena_alloc(arena, length + 1);
+    va_start(args, fmt);
+    vsnprintf(str, length + 1, fmt, args);
+    va_end(args);
+    return str;
+}
+
+static inline void arena_free(Arena *arena)
+{
+    ArenaBlock *block = arena->head;
+    while (block != NULL)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+#endif
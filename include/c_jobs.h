@@ -0,0 +1,383 @@
+// header only,
+// easy to use,
+// c work stealing job system
+// by @jardimdanificado
+// c_jobs.h
+
+// example usage:
+/*
+    // in exactly one file, before including:
+    #define C_JOBS_IMPLEMENTATION
+    #include "c_jobs.h"
+
+    void move(void *data, Int start, Int end)
+    {
+        Creature **creatures = data;
+        for (Int i = start; i < end; i++)
+            ...
+    }
+
+    JobSystem *jobs = jobs_init(0); // one worker per core, the calling thread is worker 0
+    jobs_parallel_for(jobs, creatures->size, 64, move, creatures->data); // returns when every chunk is done
+    jobs_free(jobs);
+*/
+
+// every worker owns a chase-lev deque: it pushes and pops its own jobs at the bottom,
+// idle workers steal from the top of the others;
+// a parallel_for splits the range into chunks of grain elements, pushes them to the caller deque
+// and the caller keeps running/stealing jobs until all of its chunks are done, so nesting is fine;
+// workers sleep while no parallel_for is running;
+// jobs must not touch the profiler, it is not thread safe;
+// define NO_THREADS (or build for the web without pthreads) and every parallel_for runs on the caller;
+
+// you might want to define Int before including this file, same as c_list.h;
+#ifndef Int
+#define Int int
+#endif
+
+#ifndef C_JOBS_H
+#define C_JOBS_H 1
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__) && !defined(NO_THREADS)
+#define NO_THREADS
+#endif
+
+#ifndef NO_THREADS
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#endif
+
+// jobs a deque can hold, a parallel_for never splits into more than half of this
+#define JOBS_DEQUE_SIZE 4096
+#define JOBS_MAX_WORKERS 64
+
+typedef void (*JobFunction)(void *data, Int start, Int end);
+
+#ifndef NO_THREADS
+
+typedef struct
+{
+    JobFunction run;
+    void *data;
+    Int start;
+    Int end;
+    atomic_long *pending; // chunks of the parallel_for still running
+} Job;
+
+typedef struct
+{
+    // top and bottom are written by different threads, keep them on different cache lines
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    _Alignas(64) Job *_Atomic slots[JOBS_DEQUE_SIZE];
+} JobDeque;
+
+typedef struct
+{
+    Int worker_count;
+    pthread_t *threads;
+    JobDeque *deques;
+    atomic_bool running;
+    atomic_long active; // parallel_for calls in flight
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    atomic_long steals;
+} JobSystem;
+
+#else
+
+typedef struct
+{
+    Int worker_count;
+} JobSystem;
+
+#endif
+
+JobSystem* jobs_init(Int worker_count);
+void jobs_free(JobSystem *jobs);
+void jobs_parallel_for(JobSystem *jobs, Int count, Int grain, JobFunction run, void *data);
+Int jobs_worker_index(void);
+
+#ifdef C_JOBS_IMPLEMENTATION
+
+#ifndef NO_THREADS
+
+// -1 on threads that are not part of any job system
+static _Thread_local Int jobs_worker = -1;
+
+Int jobs_worker_index(void)
+{
+    return jobs_worker;
+}
+
+static bool jobs_push(JobDeque *deque, Job *job)
+{
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= JOBS_DEQUE_SIZE)
+        return false;
+
+    atomic_store_explicit(&deque->slots[b % JOBS_DEQUE_SIZE], job, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return true;
+}
+
+// owner only
+static Job* jobs_pop(JobDeque *deque)
+{
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    Job *job = NULL;
+    if (t <= b)
+    {
+        job = atomic_load_explicit(&deque->slots[b % JOBS_DEQUE_SIZE], memory_order_relaxed);
+        if (t == b)
+        {
+            // last job, race the thieves for it
+            if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+                job = NULL;
+
+            atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        }
+    }
+    else
+    {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+static Job* jobs_steal(JobDeque *deque)
+{
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (t >= b)
+        return NULL;
+
+    Job *job = atomic_load_explicit(&deque->slots[t % JOBS_DEQUE_SIZE], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+
+    return job;
+}
+
+static void jobs_run(Job *job)
+{
+    job->run(job->data, job->start, job->end);
+    atomic_fetch_sub_explicit(job->pending, 1, memory_order_release);
+}
+
+// own deque first, then the others starting from the next worker
+static Job* jobs_find(JobSystem *jobs, Int self)
+{
+    Job *job = jobs_pop(&jobs->deques[self]);
+    if (job != NULL)
+        return job;
+
+    for (Int i = 1; i < jobs->worker_count; i++)
+    {
+        job = jobs_steal(&jobs->deques[(self + i) % jobs->worker_count]);
+        if (job != NULL)
+        {
+            atomic_fetch_add_explicit(&jobs->steals, 1, memory_order_relaxed);
+            return job;
+        }
+    }
+    return NULL;
+}
+
+typedef struct
+{
+    JobSystem *jobs;
+    Int index;
+} JobWorkerStart;
+
+static void* jobs_worker_main(void *arg)
+{
+    JobWorkerStart start = *(JobWorkerStart*)arg;
+    free(arg);
+    JobSystem *jobs = start.jobs;
+    jobs_worker = start.index;
+
+    while (atomic_load(&jobs->running))
+    {
+        Job *job = jobs_find(jobs, jobs_worker);
+        if (job != NULL)
+        {
+            jobs_run(job);
+            continue;
+        }
+
+        if (atomic_load(&jobs->active) > 0)
+        {
+            sched_yield();
+            continue;
+        }
+
+        pthread_mutex_lock(&jobs->mutex);
+        while (atomic_load(&jobs->active) == 0 && atomic_load(&jobs->running))
+            pthread_cond_wait(&jobs->wake, &jobs->mutex);
+        pthread_mutex_unlock(&jobs->mutex);
+    }
+    return NULL;
+}
+
+// worker_count 0 means one worker per core, the calling thread becomes worker 0
+JobSystem* jobs_init(Int worker_count)
+{
+    if (worker_count <= 0)
+        worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (worker_count < 1)
+        worker_count = 1;
+    else if (worker_count > JOBS_MAX_WORKERS)
+        worker_count = JOBS_MAX_WORKERS;
+
+    JobSystem *jobs = (JobSystem*)malloc(sizeof(JobSystem));
+    jobs->worker_count = worker_count;
+    jobs->deques = (JobDeque*)aligned_alloc(64, sizeof(JobDeque) * worker_count);
+    for (Int i = 0; i < worker_count; i++)
+    {
+        atomic_init(&jobs->deques[i].top, 0);
+        atomic_init(&jobs->deques[i].bottom, 0);
+    }
+    atomic_init(&jobs->running, true);
+    atomic_init(&jobs->active, 0);
+    atomic_init(&jobs->steals, 0);
+    pthread_mutex_init(&jobs->mutex, NULL);
+    pthread_cond_init(&jobs->wake, NULL);
+
+    jobs_worker = 0;
+    jobs->threads = (pthread_t*)malloc(sizeof(pthread_t) * worker_count);
+    for (Int i = 1; i < worker_count; i++)
+    {
+        JobWorkerStart *start = (JobWorkerStart*)malloc(sizeof(JobWorkerStart));
+        start->jobs = jobs;
+        start->index = i;
+        pthread_create(&jobs->threads[i], NULL, jobs_worker_main, start);
+    }
+    return jobs;
+}
+
+void jobs_free(JobSystem *jobs)
+{
+    pthread_mutex_lock(&jobs->mutex);
+    atomic_store(&jobs->running, false);
+    pthread_cond_broadcast(&jobs->wake);
+    pthread_mutex_unlock(&jobs->mutex);
+
+    for (Int i = 1; i < jobs->worker_count; i++)
+        pthread_join(jobs->threads[i], NULL);
+
+    if (jobs_worker == 0)
+        jobs_worker = -1;
+
+    pthread_mutex_destroy(&jobs->mutex);
+    pthread_cond_destroy(&jobs->wake);
+    free(jobs->threads);
+    free(jobs->deques);
+    free(jobs);
+}
+
+// calls run over [0, count) in chunks of grain and returns when every chunk is done;
+// with no job system, a single worker or a range that fits one chunk it just calls run(data, 0, count)
+void jobs_parallel_for(JobSystem *jobs, Int count, Int grain, JobFunction run, void *data)
+{
+    if (count <= 0)
+        return;
+
+    if (grain < 1)
+        grain = 1;
+
+    Int self = jobs_worker;
+    if (jobs == NULL || jobs->worker_count == 1 || count <= grain || self < 0)
+    {
+        run(data, 0, count);
+        return;
+    }
+
+    Int chunk_count = (count + grain - 1) / grain;
+    if (chunk_count > JOBS_DEQUE_SIZE / 2)
+    {
+        chunk_count = JOBS_DEQUE_SIZE / 2;
+        grain = (count + chunk_count - 1) / chunk_count;
+        chunk_count = (count + grain - 1) / grain;
+    }
+
+    Job *chunks = (Job*)malloc(sizeof(Job) * chunk_count);
+    atomic_long pending;
+    atomic_init(&pending, chunk_count);
+
+    pthread_mutex_lock(&jobs->mutex);
+    atomic_fetch_add(&jobs->active, 1);
+    pthread_cond_broadcast(&jobs->wake);
+    pthread_mutex_unlock(&jobs->mutex);
+
+    for (Int i = 0; i < chunk_count; i++)
+    {
+        chunks[i].run = run;
+        chunks[i].data = data;
+        chunks[i].start = i * grain;
+        chunks[i].end = (i + 1) * grain < count ? (i + 1) * grain : count;
+        chunks[i].pending = &pending;
+        // the deque is full (deep nesting), run it right away
+        if (!jobs_push(&jobs->deques[self], &chunks[i]))
+            jobs_run(&chunks[i]);
+    }
+
+    // help until our chunks are done, this might run chunks of other parallel_for calls too
+    while (atomic_load_explicit(&pending, memory_order_acquire) > 0)
+    {
+        Job *job = jobs_find(jobs, self);
+        if (job != NULL)
+            jobs_run(job);
+        else
+            sched_yield();
+    }
+
+    atomic_fetch_sub(&jobs->active, 1);
+    free(chunks);
+}
+
+#else
+
+Int jobs_worker_index(void)
+{
+    return 0;
+}
+
+JobSystem* jobs_init(Int worker_count)
+{
+    (void)worker_count;
+    JobSystem *jobs = (JobSystem*)malloc(sizeof(JobSystem));
+    jobs->worker_count = 1;
+    return jobs;
+}
+
+void jobs_free(JobSystem *jobs)
+{
+    free(jobs);
+}
+
+void jobs_parallel_for(JobSystem *jobs, Int count, Int grain, JobFunction run, void *data)
+{
+    (void)jobs;
+    (void)grain;
+    if (count > 0)
+        run(data, 0, count);
+}
+
+#endif
+
+#endif
+
+#endif
@@ -22,7 +22,26 @@
     Int value = list_get(*list, 0);
     list_half(*list);
     list_double(*list);
+    list_reserve(*list, 1024);
+    list_push_n(*list, other->data, other->size);
+    list_append(*list, *other);
+    list_shrink_to_fit(*list);
+    list_sorted_insert(*list, 5); // keeps the list sorted
+    Int position = list_sorted_find(*list, 5); // binary search, -1 if not found
     list_free(*list);
+
+    Deque(Int) *deque = deque_init(Deque(Int));
+    deque_push(*deque, 1);
+    deque_unshift(*deque, 2);
+    Int first = deque_shift(*deque);
+    Int last = deque_pop(*deque);
+    deque_free(*deque);
+
+    SmallList(Int, 8) small; // usually embedded in another struct
+    small_list_init(small);
+    small_list_push(small, 1); // no heap allocation until the 9th element
+    Int first = small_list_get(small, 0);
+    small_list_free(small);
 */
 
 // you might want to define Int before including this file if you want smaller or bigger lists;
@@ -31,6 +50,26 @@
 #endif
 
 #ifndef C_LIST_H
+#define C_LIST_H 1
+
+// growth policy, define these before including this file to change them;
+// capacity goes 0 -> LIST_MIN_CAPACITY and then is multiplied by LIST_GROWTH_FACTOR (anything above 1, e.g. 1.5),
+// growing by at least one so small capacities with small factors don't truncate back to where they were;
+#ifndef LIST_GROWTH_FACTOR
+#define LIST_GROWTH_FACTOR 2
+#endif
+
+#ifndef LIST_MIN_CAPACITY
+#define LIST_MIN_CAPACITY 4
+#endif
+
+// default allocator, the *_with macros take a realloc-like function instead,
+// so a list type can get its own allocator by wrapping them:
+// #define bullet_push(s, v) list_push_with(s, v, bullet_realloc)
+// like realloc, fn(data, 0) has to release data and return NULL or something fn can take back (list_shrink_to_fit_with does that)
+#ifndef LIST_REALLOC
+#define LIST_REALLOC realloc
+#endif
 
 #define List(T) struct \
 { \
@@ -54,25 +93,87 @@
     (s).data = realloc((s).data, (s).capacity * sizeof(*(s).data)); \
 } while (0)
 
-// decrease the capacity of the stack
+// decrease the capacity of the stack, never below its size
 #define list_half(s) do { \
     (s).capacity /= 2; \
+    if ((s).capacity < (s).size) { \
+        (s).capacity = (s).size; \
+    } \
     (s).data = realloc((s).data, (s).capacity * sizeof(*(s).data)); \
-    if ((s).size > (s).capacity) { \
-        (s).size = (s).capacity; \
+} while (0)
+
+// set the capacity to exactly n using the allocator fn, n must not be smaller than the size
+#define list_resize_with(s, n, fn) do { \
+    (s).capacity = (n); \
+    (s).data = fn((s).data, (s).capacity * sizeof(*(s).data)); \
+} while (0)
+
+// the capacity after c following the growth policy
+#define list_next_capacity(c) ({ \
+    Int grown = (Int)((c) * LIST_GROWTH_FACTOR); \
+    (c) < LIST_MIN_CAPACITY ? LIST_MIN_CAPACITY : grown > (c) ? grown : (c) + 1; \
+})
+
+// grow the capacity following the growth policy
+#define list_grow_with(s, fn) do { \
+    Int new_capacity = list_next_capacity((s).capacity); \
+    list_resize_with(s, new_capacity, fn); \
+} while (0)
+
+#define list_grow(s) list_grow_with(s, LIST_REALLOC)
+
+// make sure there is room for at least n elements, one reallocation at most
+#define list_reserve_with(s, n, fn) do { \
+    if ((s).capacity < (n)) { \
+        list_resize_with(s, (n), fn); \
     } \
 } while (0)
 
-#define list_push(s, v) do { \
+#define list_reserve(s, n) list_reserve_with(s, n, LIST_REALLOC)
+
+// drop the unused capacity
+#define list_shrink_to_fit_with(s, fn) do { \
+    if ((s).size == 0) { \
+        (s).data = fn((s).data, 0); \
+        (s).capacity = 0; \
+    } else if ((s).capacity > (s).size) { \
+        list_resize_with(s, (s).size, fn); \
+    } \
+} while (0)
+
+#define list_shrink_to_fit(s) list_shrink_to_fit_with(s, LIST_REALLOC)
+
+#define list_push_with(s, v, fn) do { \
     if ((s).size == (s).capacity) { \
-        list_double(s); \
+        list_grow_with(s, fn); \
     } \
     (s).data[(s).size++] = (v); \
 } while (0)
 
+#define list_push(s, v) list_push_with(s, v, LIST_REALLOC)
+
+// push n elements from the array src, growing geometrically so repeated calls stay amortized O(1)
+#define list_push_n_with(s, src, n, fn) do { \
+    Int needed = (s).size + (n); \
+    if (needed > (s).capacity) { \
+        Int new_capacity = (s).capacity < LIST_MIN_CAPACITY ? LIST_MIN_CAPACITY : (s).capacity; \
+        while (new_capacity < needed) { \
+            new_capacity = list_next_capacity(new_capacity); \
+        } \
+        list_resize_with(s, new_capacity, fn); \
+    } \
+    memcpy((s).data + (s).size, (src), (n) * sizeof(*(s).data)); \
+    (s).size = needed; \
+} while (0)
+
+#define list_push_n(s, src, n) list_push_n_with(s, src, n, LIST_REALLOC)
+
+// push every element of the list other
+#define list_append(s, other) list_push_n(s, (other).data, (other).size)
+
 #define list_unshift(s, v) do { \
     if ((s).size == (s).capacity) { \
-        list_double(s); \
+        list_grow(s); \
     } \
     for (Int i = (s).size; i > 0; i--) { \
         (s).data[i] = (s).data[i - 1]; \
@@ -104,7 +205,7 @@
 //insert element v at index i
 #define list_insert(s, i, v) do { \
     if ((s).size == (s).capacity) { \
-        list_double(s); \
+        list_grow(s); \
     } \
     for (Int j = (s).size; j > i; j--) { \
         (s).data[j] = (s).data[j - 1]; \
@@ -126,8 +227,8 @@
 //same as remove but does a swap and pop, faster but the order of the elements will change
 #define list_fast_remove(s, i) ({ \
     typeof((s).data[i]) ret = (s).data[i]; \
-    list_swap(s, i, (s).size - 1); \
-    list_pop(s); \
+    (s).data[i] = (s).data[(s).size - 1]; \
+    (s).size--; \
     ret; \
 })
 
@@ -149,4 +250,204 @@
 
 #define list_get(s, i) ((s).data[i])
 
+// sorted lists, all of these expect the list to be sorted in ascending order;
+// the *_by versions compare the struct member field instead of the element itself;
+
+// index of the first element not less than v, size if there is none
+#define list_lower_bound_by(s, field, v) ({ \
+    Int low = 0; \
+    Int high = (s).size; \
+    while (low < high) { \
+        Int mid = low + (high - low) / 2; \
+        if ((s).data[mid] field < (v)) { \
+            low = mid + 1; \
+        } else { \
+            high = mid; \
+        } \
+    } \
+    low; \
+})
+
+#define list_lower_bound(s, v) list_lower_bound_by(s, , v)
+
+// binary search, -1 if not found
+#define list_sorted_find_by(s, field, v) ({ \
+    Int i = list_lower_bound_by(s, field, v); \
+    (i < (s).size && !((v) < (s).data[i] field)) ? i : -1; \
+})
+
+#define list_sorted_find(s, v) list_sorted_find_by(s, , v)
+
+// insert v keeping the order, after any equal elements, returns the index
+#define list_sorted_insert_by(s, field, v) ({ \
+    typeof((s).data[0]) value = (v); \
+    Int i = list_lower_bound_by(s, field, value field); \
+    while (i < (s).size && !(value field < (s).data[i] field)) { \
+        i++; \
+    } \
+    list_insert(s, i, value); \
+    i; \
+})
+
+#define list_sorted_insert(s, v) list_sorted_insert_by(s, , v)
+
+// key index, for elements keyed by a small non negative integer member (types, enums);
+// fills index[0 .. key_count - 1] with the position of the first element of data[0 .. size - 1] with that key, -1 if none;
+// lookups are then index[key], rebuild it whenever the elements move;
+#define array_index_by(data, size, field, index, key_count) do { \
+    for (Int k = 0; k < (key_count); k++) { \
+        (index)[k] = -1; \
+    } \
+    for (Int k = (size) - 1; k >= 0; k--) { \
+        Int key = (data)[k] field; \
+        if (key >= 0 && key < (key_count)) { \
+            (index)[key] = k; \
+        } \
+    } \
+} while (0)
+
+#define list_index_by(s, field, index, key_count) array_index_by((s).data, (s).size, field, index, key_count)
+
+// ring buffer deque, O(1) push/pop at both ends;
+// capacity is always zero or a power of two, so wrapping is a mask;
+#define Deque(T) struct \
+{ \
+    T *data; \
+    Int head; \
+    Int size; \
+    Int capacity; \
+}
+
+// malloc and initialize a new deque
+#define deque_init(type) ({ \
+    type *deque = (type*)malloc(sizeof(type)); \
+    deque->data = NULL; \
+    deque->head = 0; \
+    deque->size = 0; \
+    deque->capacity = 0; \
+    deque; \
+})
+
+// physical index of the logical index i
+#define deque_index(d, i) (((d).head + (i)) & ((d).capacity - 1))
+
+// double the capacity, the part that wrapped around is moved right after the old end
+#define deque_double(d) do { \
+    Int old_capacity = (d).capacity; \
+    (d).capacity = old_capacity == 0 ? 1 : old_capacity * 2; \
+    (d).data = realloc((d).data, (d).capacity * sizeof(*(d).data)); \
+    if ((d).head + (d).size > old_capacity) { \
+        Int wrapped = (d).head + (d).size - old_capacity; \
+        memcpy((d).data + old_capacity, (d).data, wrapped * sizeof(*(d).data)); \
+    } \
+} while (0)
+
+#define deque_push(d, v) do { \
+    if ((d).size == (d).capacity) { \
+        deque_double(d); \
+    } \
+    (d).data[deque_index(d, (d).size)] = (v); \
+    (d).size++; \
+} while (0)
+
+#define deque_unshift(d, v) do { \
+    if ((d).size == (d).capacity) { \
+        deque_double(d); \
+    } \
+    (d).head = ((d).head - 1) & ((d).capacity - 1); \
+    (d).data[(d).head] = (v); \
+    (d).size++; \
+} while (0)
+
+#define deque_pop(d) ((d).data[deque_index(d, --(d).size)])
+
+#define deque_shift(d) ({ \
+    typeof((d).data[0]) ret = (d).data[(d).head]; \
+    (d).head = ((d).head + 1) & ((d).capacity - 1); \
+    (d).size--; \
+    ret; \
+})
+
+#define deque_get(d, i) ((d).data[deque_index(d, i)])
+
+#define deque_set(d, i, v) ((d).data[deque_index(d, i)] = (v))
+
+#define deque_first(d) ((d).data[(d).head])
+
+#define deque_last(d) ((d).data[deque_index(d, (d).size - 1)])
+
+#define deque_clear(d) do { \
+    (d).head = 0; \
+    (d).size = 0; \
+} while (0)
+
+#define deque_free(d) ({free((d).data);free(&d);})
+
+// small buffer list, the first N elements live inside the struct itself;
+// heap is NULL while the elements fit in local, the struct can be copied by value;
+// always access elements through small_list_data/small_list_get, never local or heap directly;
+#define SmallList(T, N) struct \
+{ \
+    T *heap; \
+    Int size; \
+    Int capacity; \
+    T local[N]; \
+}
+
+#define small_list_init(s) do { \
+    (s).heap = NULL; \
+    (s).size = 0; \
+    (s).capacity = sizeof((s).local) / sizeof((s).local[0]); \
+} while (0)
+
+#define small_list_data(s) ((s).heap != NULL ? (s).heap : (s).local)
+
+// double the capacity, the first time the inline elements are moved to the heap
+#define small_list_double(s) do { \
+    (s).capacity *= 2; \
+    if ((s).heap == NULL) { \
+        (s).heap = malloc((s).capacity * sizeof(*(s).local)); \
+        memcpy((s).heap, (s).local, (s).size * sizeof(*(s).local)); \
+    } else { \
+        (s).heap = realloc((s).heap, (s).capacity * sizeof(*(s).local)); \
+    } \
+} while (0)
+
+#define small_list_push(s, v) do { \
+    if ((s).size == (s).capacity) { \
+        small_list_double(s); \
+    } \
+    small_list_data(s)[(s).size++] = (v); \
+} while (0)
+
+#define small_list_pop(s) (small_list_data(s)[--(s).size])
+
+#define small_list_get(s, i) (small_list_data(s)[i])
+
+#define small_list_set(s, i, v) (small_list_data(s)[i] = (v))
+
+//same as list_fast_remove, swap with the last element and pop
+#define small_list_fast_remove(s, i) ({ \
+    typeof((s).local[0]) ret = small_list_get(s, i); \
+    small_list_get(s, i) = small_list_get(s, (s).size - 1); \
+    (s).size--; \
+    ret; \
+})
+
+//remove element at index i keeping the order and return it
+#define small_list_remove(s, i) ({ \
+    typeof((s).local[0]) ret = small_list_get(s, i); \
+    for (Int j = i; j < (s).size - 1; j++) { \
+        small_list_get(s, j) = small_list_get(s, j + 1); \
+    } \
+    (s).size--; \
+    ret; \
+})
+
+// frees the heap part if any, the list is empty and usable again afterwards
+#define small_list_free(s) do { \
+    free((s).heap); \
+    small_list_init(s); \
+} while (0)
+
 #endif
\ No newline at end of file
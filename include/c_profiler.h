@@ -0,0 +1,390 @@
+// header only,
+// easy to use,
+// c frame profiler with chrome trace export
+// by @jardimdanificado
+// c_profiler.h
+
+// example usage:
+/*
+    // in exactly one file, before including:
+    #define C_PROFILER_IMPLEMENTATION
+    #include "c_profiler.h"
+
+    void update()
+    {
+        profile_zone("update"); // closed when the function returns
+        ...
+    }
+
+    profiler_enable(true);
+    while (running)
+    {
+        profile_begin("physics");
+        ...
+        profile_end();
+        profile_count("bullets", bullets->size);
+        profiler_frame(); // once per frame, rolls the per frame stats
+    }
+
+    profiler_start_recording();
+    ...
+    profiler_stop_recording("trace.json"); // open in chrome://tracing or ui.perfetto.dev
+*/
+
+// define NO_PROFILER to compile every profile_* macro away;
+// otherwise, while profiler.enabled is false, each macro costs a single branch;
+// enabled and recording are read by every thread, only change them through profiler_enable and the recording calls;
+// zones and counters can be used from any thread, each thread has its own zone stack and shows up as its own track in the trace;
+// the per frame time and calls of a stat are summed by every thread with atomic adds and taken by profiler_frame,
+// which rolls the stats and must only be called from one thread (the one that drives the frame), same for the recording calls;
+
+// you might want to define Int before including this file, same as c_list.h;
+#ifndef Int
+#define Int int
+#endif
+
+#ifndef C_PROFILER_H
+#define C_PROFILER_H 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define PROFILER_MAX_STATS 64
+#define PROFILER_MAX_DEPTH 32
+#define PROFILER_MAX_EVENTS (256 * 1024)
+// frames in the window used for max_ms
+#define PROFILER_WINDOW 60
+
+typedef struct
+{
+    const char *name;
+    bool is_counter;
+    long long frame_ns; // time spent in this zone during the current frame, atomic
+    double last_ms; // frame_ns of the last finished frame, in milliseconds
+    double avg_ms; // exponential average of last_ms
+    double window_max_ms; // biggest last_ms in the current window
+    double max_ms; // biggest last_ms in the last full window
+    Int calls; // calls during the current frame, atomic
+    Int last_calls;
+    double value; // counters only, atomic, read it with profiler_counter_value
+} ProfileStat;
+
+typedef struct
+{
+    int stat;
+    int tid;
+    bool is_counter;
+    double ts; // microseconds since the profiler started
+    double value; // duration in microseconds for zones
+    int generation; // recording it belongs to, stored last so a slot that is claimed but not written yet is skipped
+} ProfileEvent;
+
+typedef struct
+{
+    int tid; // 0 until the thread records its first event
+    struct
+    {
+        int stat;
+        double start;
+    } stack[PROFILER_MAX_DEPTH];
+    int depth;
+    int overflow; // begins past PROFILER_MAX_DEPTH, not pushed, so their ends pop nothing
+} ProfilerThread;
+
+typedef struct
+{
+    bool enabled;
+    bool recording;
+    ProfileStat stats[PROFILER_MAX_STATS];
+    int stat_count;
+    ProfileEvent *events;
+    Int event_count;
+    Int frame;
+    long long origin; // nanoseconds, set by the first profiler_now of any thread
+    int thread_count;
+    int generation; // of the current recording
+    bool lock; // guards stat registration
+} Profiler;
+
+extern Profiler profiler;
+extern _Thread_local ProfilerThread profiler_thread;
+
+double profiler_now(void);
+int profiler_register(const char *name, bool is_counter);
+void profiler_begin_id(int stat);
+void profiler_end(void);
+void profiler_count_id(int stat, double value);
+void profiler_enable(bool enabled);
+double profiler_counter_value(int stat);
+void profiler_reset_thread(void);
+void profiler_frame(void);
+void profiler_start_recording(void);
+bool profiler_stop_recording(const char *path);
+
+static inline void profiler_zone_cleanup(int *unused)
+{
+    (void)unused;
+    if (__atomic_load_n(&profiler.enabled, __ATOMIC_RELAXED))
+        profiler_end();
+}
+
+#define PROFILER_CONCAT2(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT2(a, b)
+
+#ifndef NO_PROFILER
+
+// the stat id is resolved once per call site, name must be a string literal
+#define profile_begin(name) do { \
+    static int _profile_stat = -1; \
+    if (__atomic_load_n(&profiler.enabled, __ATOMIC_RELAXED)) { \
+        int _profile_id = __atomic_load_n(&_profile_stat, __ATOMIC_RELAXED); \
+        if (_profile_id < 0) { \
+            _profile_id = profiler_register(name, false); \
+            __atomic_store_n(&_profile_stat, _profile_id, __ATOMIC_RELAXED); \
+        } \
+        profiler_begin_id(_profile_id); \
+    } \
+} while (0)
+
+#define profile_end() do { \
+    if (__atomic_load_n(&profiler.enabled, __ATOMIC_RELAXED)) { \
+        profiler_end(); \
+    } \
+} while (0)
+
+// zone that ends with the enclosing scope
+#define profile_zone(name) \
+    profile_begin(name); \
+    int PROFILER_CONCAT(_profile_zone_, __LINE__) __attribute__((cleanup(profiler_zone_cleanup), unused)) = 0
+
+#define profile_count(name, v) do { \
+    static int _profile_stat = -1; \
+    if (__atomic_load_n(&profiler.enabled, __ATOMIC_RELAXED)) { \
+        int _profile_id = __atomic_load_n(&_profile_stat, __ATOMIC_RELAXED); \
+        if (_profile_id < 0) { \
+            _profile_id = profiler_register(name, true); \
+            __atomic_store_n(&_profile_stat, _profile_id, __ATOMIC_RELAXED); \
+        } \
+        profiler_count_id(_profile_id, (v)); \
+    } \
+} while (0)
+
+#else
+
+#define profile_begin(name) do {} while (0)
+#define profile_end() do {} while (0)
+#define profile_zone(name) do {} while (0)
+#define profile_count(name, v) do {} while (0)
+
+#endif
+
+#ifdef C_PROFILER_IMPLEMENTATION
+
+Profiler profiler = {0};
+_Thread_local ProfilerThread profiler_thread = {0};
+
+// microseconds since the first call
+double profiler_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    long long now = time.tv_sec * 1000000000LL + time.tv_nsec;
+    long long origin = __atomic_load_n(&profiler.origin, __ATOMIC_RELAXED);
+    // the first thread to get here sets it, a thread that loses the race gets the winner's in origin
+    if (origin == 0 && __atomic_compare_exchange_n(&profiler.origin, &origin, now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        origin = now;
+
+    return (now - origin) / 1e3;
+}
+
+int profiler_register(const char *name, bool is_counter)
+{
+    while (__atomic_test_and_set(&profiler.lock, __ATOMIC_ACQUIRE));
+
+    int id = -1;
+    for (int i = 0; i < profiler.stat_count && id == -1; i++)
+    {
+        if (strcmp(profiler.stats[i].name, name) == 0)
+            id = i;
+    }
+
+    if (id == -1 && profiler.stat_count == PROFILER_MAX_STATS)
+        id = PROFILER_MAX_STATS - 1; // out of slots, share the last one
+
+    if (id == -1)
+    {
+        ProfileStat *stat = &profiler.stats[profiler.stat_count];
+        memset(stat, 0, sizeof(ProfileStat));
+        stat->name = name;
+        stat->is_counter = is_counter;
+        // published last, so other threads never see a half initialized stat
+        __atomic_store_n(&profiler.stat_count, profiler.stat_count + 1, __ATOMIC_RELEASE);
+        id = profiler.stat_count - 1;
+    }
+
+    __atomic_clear(&profiler.lock, __ATOMIC_RELEASE);
+    return id;
+}
+
+static void profiler_record(int stat, bool is_counter, double ts, double value)
+{
+    // acquire, so the events buffer and generation of the recording are seen
+    if (!__atomic_load_n(&profiler.recording, __ATOMIC_ACQUIRE))
+        return;
+
+    Int index = __atomic_fetch_add(&profiler.event_count, 1, __ATOMIC_RELAXED);
+    if (index >= PROFILER_MAX_EVENTS)
+    {
+        // buffer is full, keep what we have until the recording is stopped
+        __atomic_store_n(&profiler.event_count, PROFILER_MAX_EVENTS, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if (profiler_thread.tid == 0)
+        profiler_thread.tid = __atomic_add_fetch(&profiler.thread_count, 1, __ATOMIC_RELAXED);
+
+    ProfileEvent *event = &profiler.events[index];
+    event->stat = stat;
+    event->tid = profiler_thread.tid;
+    event->is_counter = is_counter;
+    event->ts = ts;
+    event->value = value;
+    __atomic_store_n(&event->generation, __atomic_load_n(&profiler.generation, __ATOMIC_RELAXED), __ATOMIC_RELEASE);
+}
+
+void profiler_begin_id(int stat)
+{
+    if (profiler_thread.depth == PROFILER_MAX_DEPTH)
+    {
+        profiler_thread.overflow++;
+        return;
+    }
+
+    profiler_thread.stack[profiler_thread.depth].stat = stat;
+    profiler_thread.stack[profiler_thread.depth].start = profiler_now();
+    profiler_thread.depth++;
+}
+
+void profiler_end(void)
+{
+    if (profiler_thread.overflow > 0)
+    {
+        profiler_thread.overflow--;
+        return;
+    }
+
+    // unbalanced end, e.g. the profiler was enabled in between a begin and its end
+    if (profiler_thread.depth == 0)
+        return;
+
+    profiler_thread.depth--;
+    int id = profiler_thread.stack[profiler_thread.depth].stat;
+    double start = profiler_thread.stack[profiler_thread.depth].start;
+    double duration = profiler_now() - start;
+    ProfileStat *stat = &profiler.stats[id];
+    __atomic_fetch_add(&stat->frame_ns, (long long)(duration * 1000.0), __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stat->calls, 1, __ATOMIC_RELAXED);
+    profiler_record(id, false, start, duration);
+}
+
+void profiler_count_id(int stat, double value)
+{
+    __atomic_store(&profiler.stats[stat].value, &value, __ATOMIC_RELAXED);
+    profiler_record(stat, true, profiler_now(), value);
+}
+
+void profiler_enable(bool enabled)
+{
+    __atomic_store_n(&profiler.enabled, enabled, __ATOMIC_RELAXED);
+}
+
+double profiler_counter_value(int stat)
+{
+    double value;
+    __atomic_load(&profiler.stats[stat].value, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+// drops the zones left open on the calling thread, e.g. by a toggle of profiler.enabled
+void profiler_reset_thread(void)
+{
+    profiler_thread.depth = 0;
+    profiler_thread.overflow = 0;
+}
+
+void profiler_frame(void)
+{
+    profiler_reset_thread();
+    profiler.frame++;
+    int stat_count = __atomic_load_n(&profiler.stat_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < stat_count; i++)
+    {
+        ProfileStat *stat = &profiler.stats[i];
+        if (stat->is_counter)
+            continue;
+
+        stat->last_ms = __atomic_exchange_n(&stat->frame_ns, 0, __ATOMIC_RELAXED) / 1e6;
+        stat->last_calls = __atomic_exchange_n(&stat->calls, 0, __ATOMIC_RELAXED);
+        stat->avg_ms = stat->avg_ms * 0.95 + stat->last_ms * 0.05;
+        if (stat->last_ms > stat->window_max_ms)
+            stat->window_max_ms = stat->last_ms;
+
+        if (profiler.frame % PROFILER_WINDOW == 0)
+        {
+            stat->max_ms = stat->window_max_ms;
+            stat->window_max_ms = 0;
+        }
+    }
+}
+
+void profiler_start_recording(void)
+{
+    if (profiler.events == NULL)
+        profiler.events = (ProfileEvent*)calloc(PROFILER_MAX_EVENTS, sizeof(ProfileEvent));
+
+    __atomic_store_n(&profiler.event_count, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&profiler.generation, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&profiler.recording, true, __ATOMIC_RELEASE);
+    profiler_enable(true);
+}
+
+// writes the recorded events as chrome trace json
+bool profiler_stop_recording(const char *path)
+{
+    __atomic_store_n(&profiler.recording, false, __ATOMIC_RELAXED);
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+
+    Int count = __atomic_load_n(&profiler.event_count, __ATOMIC_RELAXED);
+    if (count > PROFILER_MAX_EVENTS)
+        count = PROFILER_MAX_EVENTS;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (Int i = 0; i < count; i++)
+    {
+        // another thread claimed the slot just before the stop and is still writing it
+        ProfileEvent *event = &profiler.events[i];
+        if (__atomic_load_n(&event->generation, __ATOMIC_ACQUIRE) != profiler.generation)
+            continue;
+
+        const char *name = profiler.stats[event->stat].name;
+        fprintf(file, first ? "" : ",\n");
+        first = false;
+        if (event->is_counter)
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%g}}", name, event->ts, event->tid, event->value);
+        else
+            fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}", name, event->ts, event->value, event->tid);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+#endif
+
+#endif
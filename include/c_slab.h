@@ -0,0 +1,102 @@
+// type agnostic,
+// header only,
+// easy to use,
+// c slab allocator implementation
+// by @jardimdanificado
+// c_slab.h
+
+// example usage:
+/*
+    typedef Slab(Bullet) BulletSlab;
+    BulletSlab *slab = slab_init(BulletSlab, 1024); // 1024 bullets per page
+    Bullet *bullet = slab_alloc(*slab); // stable until released, pages never move
+    slab_release(*slab, bullet); // goes back to the free list, memory is reused
+    slab_free(*slab); // frees every page at once
+*/
+
+// you might want to define Int before including this file, same as c_list.h;
+#ifndef Int
+#define Int int
+#endif
+
+#ifndef C_SLAB_H
+#define C_SLAB_H 1
+
+#include <stdlib.h>
+
+// elements are allocated in pages of page_size elements, a page is never freed or moved until slab_free;
+// released elements are kept in a free list threaded through the elements themselves,
+// so T must be at least pointer sized;
+#define Slab(T) struct \
+{ \
+    T **pages; \
+    Int page_count; \
+    Int page_capacity; \
+    Int page_size; \
+    void *free_list; \
+    Int live; \
+    Int peak; \
+}
+
+// malloc and initialize a new slab
+#define slab_init(type, size) ({ \
+    type *slab = (type*)malloc(sizeof(type)); \
+    slab->pages = NULL; \
+    slab->page_count = 0; \
+    slab->page_capacity = 0; \
+    slab->page_size = (size) > 0 ? (size) : 256; \
+    slab->free_list = NULL; \
+    slab->live = 0; \
+    slab->peak = 0; \
+    slab; \
+})
+
+// allocate a new page and thread all of its elements into the free list, lowest address first
+#define slab_add_page(s) do { \
+    _Static_assert(sizeof(**(s).pages) >= sizeof(void*), "slab elements must be at least pointer sized"); \
+    if ((s).page_count == (s).page_capacity) { \
+        (s).page_capacity = (s).page_capacity == 0 ? 4 : (s).page_capacity * 2; \
+        (s).pages = realloc((s).pages, (s).page_capacity * sizeof(*(s).pages)); \
+    } \
+    typeof(*(s).pages) page = malloc((s).page_size * sizeof(**(s).pages)); \
+    (s).pages[(s).page_count++] = page; \
+    for (Int i = (s).page_size - 1; i >= 0; i--) { \
+        *(void**)&page[i] = (s).free_list; \
+        (s).free_list = &page[i]; \
+    } \
+} while (0)
+
+// returns an uninitialized element
+#define slab_alloc(s) ({ \
+    if ((s).free_list == NULL) { \
+        slab_add_page(s); \
+    } \
+    typeof(*(s).pages) element = (typeof(*(s).pages))(s).free_list; \
+    (s).free_list = *(void**)element; \
+    (s).live++; \
+    if ((s).live > (s).peak) { \
+        (s).peak = (s).live; \
+    } \
+    element; \
+})
+
+// give an element back, it must have come from this slab
+#define slab_release(s, element) do { \
+    *(void**)(element) = (s).free_list; \
+    (s).free_list = (void*)(element); \
+    (s).live--; \
+} while (0)
+
+// bytes reserved by the slab pages
+#define slab_bytes(s) ((s).page_count * (s).page_size * (Int)sizeof(**(s).pages))
+
+// frees every page and the slab itself, every element is gone
+#define slab_free(s) ({ \
+    for (Int i = 0; i < (s).page_count; i++) { \
+        free((s).pages[i]); \
+    } \
+    free((s).pages); \
+    free(&s); \
+})
+
+#endif
@@ -0,0 +1,80 @@
+// brutopolis model level of detail: lod chains cooked from obj files and impostors, picked at draw time by size on screen
+#ifndef LOD_H
+#define LOD_H 1
+
+#include "brutopolis.h"
+
+// cooking (the cook tool, at build time): every run of faces in an obj (a group/material) is simplified on its own
+// by edge collapses ordered by quadric error, a collapse moves one vertex onto a neighbour so the simplified
+// faces only reference the positions, uvs and normals of the source, which is copied over as it is but for the faces;
+// level l keeps about LOD_RATIO^l of the triangles of each run
+#define LOD_RATIO 0.5f
+// runs with fewer triangles than this are left alone at every level (the map hitboxes are 10 triangles each)
+#define LOD_MIN_TRIANGLES 32
+// how much a collapse that moves an open edge costs compared to one that bends a surface, keeps silhouettes and holes
+#define LOD_BOUNDARY_WEIGHT 100.0
+// a collapse is rejected when it turns the normal of a remaining face by more than about 60 degrees
+#define LOD_MIN_NORMAL_DOT 0.5f
+
+// picking: level l is drawn while the bounding sphere covers fewer than lod_pixels[l] pixels of screen height,
+// a level is only left once the size is LOD_HYSTERESIS past the threshold, so a model at the edge doesn't pop back and forth
+#define LOD_HYSTERESIS 0.2f
+
+// impostors: past its last level a model with an impostor atlas is drawn as a quad turned to the camera around y,
+// textured with the closest of LOD_IMPOSTOR_VIEWS views rendered around the model at load time;
+// lod_select returns lod->count for it
+#define LOD_IMPOSTOR_PIXELS 24.0f
+#define LOD_IMPOSTOR_VIEWS 16
+#define LOD_IMPOSTOR_GRID 4 // views per atlas row and column
+#define LOD_IMPOSTOR_CELL 128 // pixels of one view, which covers the bounding sphere
+
+typedef struct
+{
+    int v, vt, vn; // 0 based, -1 when the face has none
+} LodCorner;
+
+typedef struct
+{
+    LodCorner corner[3];
+} LodFace;
+typedef List(LodFace) LodFaceList;
+
+typedef struct
+{
+    Int text_start, text_length; // lines before the run that are not faces, copied from the source as they are
+    LodFaceList *levels[MODEL_LOD_LEVELS]; // levels[0] is the run as loaded, the rest is filled by lod_build_chain
+} LodRun;
+typedef List(LodRun) LodRunList;
+
+typedef struct
+{
+    char *source;
+    Int source_length;
+    Vector3List *positions;
+    LodRunList *runs;
+    Int tail_start; // lines after the last run
+    Int levels; // built by lod_build_chain, 1 before
+} LodObj;
+
+// what lod_select picked for one instance last frame
+typedef struct
+{
+    Int id;
+    int level; // -1 when it wasn't drawn
+} LodPick;
+typedef List(LodPick) LodPickList;
+
+LodObj* lod_obj_load(const char* path);
+void lod_obj_free(LodObj* obj);
+void lod_build_chain(LodObj* obj, Int levels);
+Int lod_triangles(LodObj* obj, Int level);
+bool lod_write(LodObj* obj, Int level, const char* path);
+void lod_path(const char* path, Int level, char* buffer, Int size);
+
+float lod_screen_scale(Camera camera, float screen_height);
+float lod_screen_size(Vector3 eye, float scale, Vector3 center, float radius);
+int lod_select(const ModelLod* lod, float pixels, int current);
+void lod_impostor_view(Int view, Vector3* direction, Vector2* cell);
+void lod_impostor_quad(const ModelLod* lod, Vector3 eye, Vector3 position, float yaw, float* vertices, float* texcoords);
+
+#endif
@@ -0,0 +1,137 @@
+// brutopolis navigation, flow fields over a walkable grid
+#ifndef NAV_H
+#define NAV_H 1
+
+#include "brutopolis.h"
+
+// the current map rasterized into NAV_CELL_SIZE xz cells, each one with the height of the highest surface over its center;
+// walking into a neighbour cell climbs at most NAV_STEP_HEIGHT (what check_move_collision lets through), dropping down is always fine
+#define NAV_CELL_SIZE 1.0f
+#define NAV_STEP_HEIGHT 0.1f
+#define NAV_MAX_CELLS (1024 * 1024)
+
+// a flow field is a dijkstra map from the cell of one target creature, every creature chasing that target shares it
+// and steers by looking up the direction stored in its own cell
+#define NAV_MAX_FIELDS 16
+// cells a field settles per tick while it is rebuilt, the old field keeps steering until the new one is done
+#define NAV_EXPANSIONS_PER_TICK 16384
+// ticks a field is kept once nobody chases its target
+#define NAV_FIELD_TIMEOUT 120
+// creatures in the goal cell head straight for the target and stop this close to it
+#define NAV_ARRIVE_DISTANCE 1.0f
+#define NAV_NO_DIRECTION 255
+
+typedef struct
+{
+    float distance;
+    int cell;
+} NavOpen;
+typedef List(NavOpen) NavOpenList;
+
+typedef struct
+{
+    Int target_id; // creature the field leads to, -1 for a free slot
+    Int target_index; // where the target was last found in the world list, checked before it is used
+    Vector3 target_position; // this tick
+    Int goal; // goal cell of the finished field, -1 before the first one is done
+    unsigned char *direction; // per cell, the neighbour to step into, NAV_NO_DIRECTION at the goal or where it can't be reached
+    Int building; // goal cell of the rebuild in progress, -1 when idle
+    float *distance; // rebuild in progress, per cell
+    unsigned char *next_direction; // rebuild in progress, swapped with direction when it is done
+    NavOpenList *open; // rebuild in progress, binary heap on distance
+    Int last_used; // tick a creature last asked for it
+} FlowField;
+
+// the navmesh: walkable cells of one height merged into rectangles, built with the grid;
+// a path is an a* over the rectangles (the corridor), pulled tight through the portals between them (funnel);
+// portals are shrunk by NAV_AGENT_RADIUS at both ends so paths keep off corners
+#define NAV_AGENT_RADIUS 0.3f
+// corridors kept by start and goal polygon, the least recently used one is dropped first;
+// nav_find_paths works in chunks of this many queries so a chunk never drops a corridor it is using
+#define NAV_PATH_CACHE_SIZE 4096
+#define NAV_PATH_CACHE_BUCKETS 8192
+
+typedef struct
+{
+    Vector3 min, max; // xz rectangle, y is the floor height
+    Int first_link; // links[first_link] to links[first_link + link_count - 1]
+    Int link_count;
+} NavPoly;
+typedef List(NavPoly) NavPolyList;
+
+// a way out of a polygon, only there if the step up to the neighbour is small enough
+typedef struct
+{
+    Int poly; // neighbour
+    Vector3 left, right; // portal, as seen looking from the polygon into the neighbour
+} NavLink;
+typedef List(NavLink) NavLinkList;
+
+typedef struct
+{
+    Int start, goal; // polygons, -1 for a free entry
+    IntList *corridor; // polygons from start to goal, empty when there is no way
+    bool pending; // the corridor is computed later in the same batch
+    Int newer, older; // lru order, -1 at the ends
+    Int next; // same bucket, -1 at the end
+} NavCacheEntry;
+
+// a* scratch, one per job worker
+typedef struct
+{
+    Int capacity; // polygons the arrays hold
+    float *cost;
+    Int *parent;
+    unsigned int *seen; // == stamp when cost and parent are from this search
+    unsigned int stamp;
+    NavOpenList *open;
+} NavSearch;
+
+typedef struct
+{
+    Vector3 start, goal;
+    Vector3List *path; // filled by nav_find_paths, start first and goal last, empty when there is no way
+    Int entry; // cache entry used, -1 when start or goal is not on the navmesh
+} NavPathQuery;
+
+struct Navigation
+{
+    Int map; // map the grid was built from, -1 for none
+    Int hitbox_count; // of that map when the grid was built, a change rebuilds it
+    Vector3 origin; // min corner of cell 0
+    int width, depth; // cells along x and z
+    float *height; // per cell, NAN where there is nothing to stand on
+    FlowField fields[NAV_MAX_FIELDS];
+    Int tick;
+    NavPolyList *polys;
+    NavLinkList *links;
+    Int *cell_poly; // per cell, -1 where it is not walkable
+    NavCacheEntry cache[NAV_PATH_CACHE_SIZE];
+    Int buckets[NAV_PATH_CACHE_BUCKETS];
+    Int newest, oldest;
+    Int cache_hits, cache_misses;
+    IntList *pending; // cache entries whose corridor the running batch computes
+    NavSearch searches[JOBS_MAX_WORKERS];
+};
+
+Navigation* nav_init(void);
+void nav_free(Navigation* nav);
+void nav_build_grid(Navigation* nav, Map* map, Int map_id);
+Int nav_cell(Navigation* nav, Vector3 position);
+FlowField* nav_find_field(Navigation* nav, Int target_id);
+void nav_start_field(Navigation* nav, FlowField* field, Int goal);
+bool nav_update_field(Navigation* nav, FlowField* field, Int budget);
+void update_navigation(InternalSystem* sys);
+void nav_steer(InternalSystem* sys, Creature* c, FlowField** field);
+bool nav_sync(InternalSystem* sys);
+
+// navmesh
+void nav_build_mesh(Navigation* nav);
+Int nav_locate(Navigation* nav, Vector3 position);
+void nav_cache_clear(Navigation* nav);
+bool nav_find_corridor(Navigation* nav, NavSearch* search, Int start, Int goal, IntList* corridor);
+void nav_funnel(Navigation* nav, IntList* corridor, Vector3 start, Vector3 goal, Vector3List* path);
+void nav_find_paths(InternalSystem* sys, NavPathQuery* queries, Int count);
+bool nav_find_path(InternalSystem* sys, Vector3 start, Vector3 goal, Vector3List* path);
+
+#endif
@@ -0,0 +1,151 @@
+// brutopolis network protocol, udp
+#ifndef NET_H
+#define NET_H 1
+
+#include "brutopolis.h"
+#include <netinet/in.h>
+
+#define NET_PROTOCOL 1
+#define NET_PORT 27015
+// biggest datagram we send, below the usual 1500 mtu
+#define NET_MAX_PACKET 1400
+// snapshots kept per client as delta baselines, power of two
+#define NET_HISTORY 32
+#define NET_MAX_CLIENTS 64
+// seconds without a packet before a client is dropped
+#define NET_TIMEOUT 5.0
+// no baseline, the snapshot carries every entity in full
+#define NET_NO_BASELINE 0xFFFFFFFF
+
+// positions are sent as 1/NET_POSITION_SCALE units in 16 bits, about +-512 units
+#define NET_POSITION_SCALE 64.0f
+// rotations are sent as 1/NET_ROTATION_SCALE in 16 bits
+#define NET_ROTATION_SCALE 100.0f
+
+// interest management: a client only gets the entities within NET_INTEREST_RADIUS of its own creature,
+// the nearest NET_MAX_RELEVANT of them at most;
+// closer than NET_NEAR_DISTANCE they update every tick, closer than NET_MID_DISTANCE every NET_MID_INTERVAL ticks
+// and every NET_FAR_INTERVAL ticks past that
+#define NET_INTEREST_RADIUS 96.0f
+#define NET_INTEREST_CELL 16.0f
+#define NET_MAX_RELEVANT 256
+#define NET_NEAR_DISTANCE 24.0f
+#define NET_MID_DISTANCE 48.0f
+#define NET_MID_INTERVAL 3
+#define NET_FAR_INTERVAL 10
+
+// PACKET DEFINES
+// client to server
+#define PACKET_CONNECT 1
+#define PACKET_INPUT 2
+#define PACKET_DISCONNECT 3
+// server to client
+#define PACKET_WELCOME 16
+#define PACKET_SNAPSHOT 17
+
+// ENTITY DEFINES
+#define ENTITY_CREATURE 0
+#define ENTITY_BULLET 1
+
+// entity fields, also the bits of the per entity change mask
+#define FIELD_POSITION_X 0
+#define FIELD_POSITION_Y 1
+#define FIELD_POSITION_Z 2
+#define FIELD_ROTATION_X 3
+#define FIELD_ROTATION_Y 4
+#define FIELD_COUNT 5
+#define FIELD_NEW 0x80
+
+// input buttons
+#define BUTTON_FIRE 1
+#define BUTTON_RELOAD 2
+
+// an entity as the network sees it, quantized
+typedef struct
+{
+    Int id;
+    char type; // ENTITY_*
+    short fields[FIELD_COUNT];
+} EntityState;
+typedef List(EntityState) EntityStateList;
+
+// a world state, entities sorted by id
+typedef struct
+{
+    Int tick; // -1 for an empty slot
+    EntityStateList *entities;
+} NetSnapshot;
+
+typedef struct
+{
+    unsigned char data[NET_MAX_PACKET];
+    Int size;
+    bool overflow; // something did not fit, size is left where it was
+} PacketWriter;
+
+typedef struct
+{
+    const unsigned char *data;
+    Int size;
+    Int position;
+    bool error; // read past the end
+} PacketReader;
+
+// what a client sends every tick, the newest one received wins
+typedef struct
+{
+    unsigned int tick; // client tick, increasing
+    unsigned int ack; // newest snapshot tick the client has decoded, NET_NO_BASELINE for none
+    signed char move_x; // forward -1 to 1
+    signed char move_z; // right -1 to 1
+    short yaw; // rotation.x, quantized like entity rotations
+    short pitch; // rotation.y
+    unsigned char buttons; // BUTTON_*
+    signed char wheel;
+} InputCommand;
+
+// packet writing, every write checks the room left
+void write_u8(PacketWriter *writer, unsigned int value);
+void write_u16(PacketWriter *writer, unsigned int value);
+void write_u32(PacketWriter *writer, unsigned int value);
+void write_varint(PacketWriter *writer, unsigned long value);
+void write_zigzag(PacketWriter *writer, long value);
+
+unsigned int read_u8(PacketReader *reader);
+unsigned int read_u16(PacketReader *reader);
+unsigned int read_u32(PacketReader *reader);
+unsigned long read_varint(PacketReader *reader);
+long read_zigzag(PacketReader *reader);
+
+// quantization
+short quantize_position(float value);
+float dequantize_position(short value);
+short quantize_rotation(float value);
+float dequantize_rotation(short value);
+
+// snapshots
+void net_snapshot_init(NetSnapshot *snapshot);
+void net_snapshot_free(NetSnapshot *snapshot);
+void net_snapshot_copy(NetSnapshot *to, NetSnapshot *from);
+EntityState* find_entity(EntityStateList *entities, Int id);
+void build_world_state(InternalSystem* sys, NetSnapshot *snapshot, Int tick);
+void write_snapshot(PacketWriter *writer, NetSnapshot *baseline, NetSnapshot *current, Int own_id, IntList *order, NetSnapshot *sent);
+bool read_snapshot_header(PacketReader *reader, unsigned int *tick, unsigned int *baseline_tick, Int *own_id);
+bool read_snapshot(PacketReader *reader, NetSnapshot *baseline, unsigned int tick, NetSnapshot *out);
+
+// interest
+void build_interest_grid(NetSnapshot *world, SpatialHash *grid);
+void build_client_view(NetSnapshot *world, SpatialHash *grid, Int own_id, NetSnapshot *baseline, NetSnapshot *view, IntList *order);
+
+// input
+void write_input(PacketWriter *writer, InputCommand *input);
+bool read_input(PacketReader *reader, InputCommand *input);
+
+// sockets, non blocking
+int net_open(int port);
+void net_close(int socket);
+bool net_send(int socket, struct sockaddr_in *address, PacketWriter *writer);
+Int net_receive(int socket, struct sockaddr_in *address, unsigned char *buffer, Int size);
+struct sockaddr_in net_address(const char *host, int port);
+
+#endif
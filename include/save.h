@@ -0,0 +1,171 @@
+// brutopolis world snapshots, binary
+#ifndef SAVE_H
+#define SAVE_H 1
+
+#include "brutopolis.h"
+#include <stdint.h>
+
+// layout of a save file, native byte order (little endian everywhere we run):
+// SaveHeader, section_count SaveSections, then the sections, each one SAVE_ALIGN aligned;
+// a section is a plain array of count elements of element_size bytes, so a mapped file is usable as is;
+// creatures are stored as one section per field (SoA), names are offsets into the string table
+#define SAVE_MAGIC "BRTW"
+#define SAVE_VERSION 4
+#define SAVE_ENDIAN 0x01020304
+#define SAVE_ALIGN 64
+#define SAVE_PATH "world.sav"
+
+// autosave: a snapshot plus a journal (path.journal) of the changes made since;
+// every AUTOSAVE_INTERVAL seconds the creatures marked dirty, the removals, the bullets and the world items go into one entry,
+// once the journal is past AUTOSAVE_COMPACT_BYTES and half the snapshot it is folded into a new snapshot in the background;
+// journal layout: JournalHeader, then entries, each a JournalEntry followed by its payload:
+// JournalMeta, removed int64_t ids, creatures (JournalCreature, name bytes, item_count SaveItems),
+// JournalBullets, SaveItems; a crash mid append leaves a bad checksum, recovery stops there
+#define AUTOSAVE_PATH "autosave.sav"
+#define AUTOSAVE_INTERVAL 5.0
+#define AUTOSAVE_COMPACT_BYTES (1024 * 1024)
+#define JOURNAL_MAGIC "BRTJ"
+#define JOURNAL_VERSION 3
+
+// SECTION DEFINES
+enum
+{
+    SECTION_META, // one SaveMeta
+    SECTION_STRINGS, // chars, every string ends with a 0, offset 0 is the empty string
+    SECTION_CREATURE_ID, // int64_t
+    SECTION_CREATURE_NAME, // uint32_t string offset
+    SECTION_CREATURE_POSITION, // Vector3
+    SECTION_CREATURE_SIZE, // Vector3
+    SECTION_CREATURE_ROTATION, // Vector3
+    SECTION_CREATURE_DIRECTION, // Vector3
+    SECTION_CREATURE_COLOR, // Color
+    SECTION_CREATURE_SPEED, // double
+    SECTION_CREATURE_CURRENT_ITEM, // int32_t
+    SECTION_CREATURE_STATUS, // int32_t
+    SECTION_CREATURE_TARGET, // int64_t creature id, -1 for none
+    SECTION_CREATURE_ITEMS, // SaveRange into SECTION_INVENTORY
+    SECTION_INVENTORY, // SaveItem, every inventory one after the other
+    SECTION_WORLD_ITEMS, // SaveItem, World.items
+    SECTION_BULLET_ID, // int64_t
+    SECTION_BULLET_POSITION, // Vector3
+    SECTION_BULLET_DIRECTION, // Vector3
+    SECTION_BULLET_SPEED, // double
+    SECTION_BULLET_ORIGIN, // Vector3
+    SECTION_COUNT
+};
+
+// SAVE STATUS DEFINES
+#define SAVE_IDLE 0
+#define SAVE_RUNNING 1
+#define SAVE_DONE 2
+#define SAVE_FAILED 3
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t section_count;
+    uint32_t endian; // SAVE_ENDIAN as the saving machine wrote it
+    uint64_t file_size;
+} SaveHeader;
+
+typedef struct
+{
+    uint32_t type; // SECTION_*
+    uint32_t element_size;
+    uint64_t count;
+    uint64_t offset; // from the start of the file
+} SaveSection;
+
+typedef struct
+{
+    double time;
+    int64_t next_id;
+    int64_t player_index; // creature index, -1 for none
+    uint32_t map_name; // string offset, the map itself comes from the assets
+    uint32_t padding;
+    uint64_t journal_sequence; // last journal entry folded into this snapshot, recovery replays the ones after it
+} SaveMeta;
+
+typedef struct
+{
+    uint32_t start;
+    uint32_t count;
+} SaveRange;
+
+typedef struct
+{
+    Vector3 position;
+    int32_t type;
+    int32_t capacity;
+    int32_t content_type;
+    int32_t content;
+} SaveItem;
+
+typedef struct
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t endian;
+    uint32_t padding;
+} JournalHeader;
+
+typedef struct
+{
+    uint64_t sequence; // increasing, the first entry after a new autosave is 1
+    uint64_t size; // payload bytes
+    uint64_t checksum; // fnv-1a of the payload
+} JournalEntry;
+
+typedef struct
+{
+    double time;
+    int64_t next_id;
+    int64_t player_id; // -1 for none
+    uint32_t removed;
+    uint32_t creatures;
+    uint32_t bullets;
+    uint32_t items;
+} JournalMeta;
+
+// the whole creature, it replaces whatever the snapshot (or an earlier entry) had for that id
+typedef struct
+{
+    int64_t id;
+    int64_t target_id;
+    double speed;
+    Vector3 position;
+    Vector3 size;
+    Vector3 rotation;
+    Vector3 direction;
+    Color color;
+    int32_t current_item;
+    int32_t status;
+    uint32_t name_length;
+    uint32_t item_count;
+    uint32_t padding;
+} JournalCreature;
+
+typedef struct
+{
+    int64_t id;
+    Vector3 position;
+    Vector3 direction;
+    double speed;
+    Vector3 origin;
+    float padding;
+} JournalBullet;
+
+bool world_save(InternalSystem* sys, const char* path);
+bool world_save_async(InternalSystem* sys, const char* path);
+int world_save_status(void);
+bool world_load(InternalSystem* sys, const char* path);
+
+// autosave
+bool autosave_start(InternalSystem* sys, const char* path);
+void autosave_stop(InternalSystem* sys, bool remove);
+bool journal_append(InternalSystem* sys);
+void autosave(InternalSystem* sys);
+bool world_recover(InternalSystem* sys, const char* path);
+
+#endif
@@ -0,0 +1,404 @@
+#include "ai.h"
+#include "nav.h"
+#include <time.h>
+
+static const float ai_lod_distance[AI_LOD_LEVELS - 1] = {AI_LOD_NEAR, AI_LOD_MID, AI_LOD_FAR};
+static const Int ai_lod_period[AI_LOD_LEVELS] = {1, 4, 16, 64};
+
+static double ai_now_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+AiScheduler* ai_init(void)
+{
+    AiScheduler* ai = (AiScheduler*)malloc(sizeof(AiScheduler));
+    memset(ai, 0, sizeof(AiScheduler));
+    for (Int l = 0; l < AI_LOD_LEVELS; l++)
+        ai->periods[l] = ai_lod_period[l];
+
+    for (Int b = 0; b < AI_WHEEL_SIZE; b++)
+        ai->wheel[b] = list_init(CreatureList);
+
+    ai->due = list_init(CreatureList);
+    ai->due_levels = list_init(IntList);
+    ai->crowd = spatial_hash_init(AI_SEPARATION_RADIUS);
+    return ai;
+}
+
+void ai_free(AiScheduler* ai)
+{
+    for (Int b = 0; b < AI_WHEEL_SIZE; b++)
+        list_free(*ai->wheel[b]);
+
+    list_free(*ai->due);
+    list_free(*ai->due_levels);
+    spatial_hash_free(ai->crowd);
+    free(ai->crowd_x);
+    free(ai->crowd_z);
+    free(ai->crowd_push_x);
+    free(ai->crowd_push_z);
+    free(ai->crowd_cell_x);
+    free(ai->crowd_cell_z);
+    free(ai->crowd_slot);
+    free(ai);
+}
+
+static void ai_schedule(AiScheduler* ai, Creature* c, Int turn)
+{
+    CreatureList* bucket = ai->wheel[turn % AI_WHEEL_SIZE];
+    c->ai_turn = turn;
+    c->ai_slot = bucket->size;
+    list_push(*bucket, c);
+}
+
+// a new creature, its first turn is the next update_ai
+void ai_enroll(AiScheduler* ai, Creature* c)
+{
+    c->ai_level = -1;
+    c->ai_period = 1;
+    ai_schedule(ai, c, ai->tick);
+}
+
+// a creature about to be freed
+void ai_forget(AiScheduler* ai, Creature* c)
+{
+    CreatureList* bucket = ai->wheel[c->ai_turn % AI_WHEEL_SIZE];
+    Creature* last = bucket->data[bucket->size - 1];
+    bucket->data[c->ai_slot] = last;
+    last->ai_slot = c->ai_slot;
+    bucket->size--;
+    if (c->ai_level >= 0)
+        ai->levels[c->ai_level]--;
+}
+
+// somebody whose surroundings should stay sharp on the next update_ai, e.g. a connected player; false when full
+bool ai_observe(InternalSystem* sys, Vector3 position)
+{
+    AiScheduler* ai = sys->ai;
+    if (ai->observer_count >= AI_MAX_OBSERVERS)
+        return false;
+
+    ai->observers[ai->observer_count++] = position;
+    return true;
+}
+
+// the creatures whose turn it is: the new level and the think itself, the next turn is picked for each with its new level;
+// each one only writes itself and the turns only depend on the id, the tick and the creature's own level,
+// so the result does not depend on the thread count
+static void ai_job(void *data, Int start, Int end)
+{
+    InternalSystem* sys = data;
+    AiScheduler* ai = sys->ai;
+    float limits[AI_LOD_LEVELS - 1];
+    for (Int l = 0; l < AI_LOD_LEVELS - 1; l++)
+        limits[l] = ai_lod_distance[l] * ai_lod_distance[l];
+
+    Int thinks[AI_LOD_LEVELS] = {0};
+    FlowField* field = NULL;
+    for (Int i = start; i < end; i++)
+    {
+        Creature* c = ai->due->data[i];
+        if (c->target_id < 0)
+        {
+            c->ai_level = -1;
+            c->ai_period = ai->periods[AI_LOD_LEVELS - 1];
+            c->ai_turn = ai->tick + c->ai_period;
+            continue;
+        }
+
+        // the turn was picked with the period at the last think; if the budget stretched that period since,
+        // the creature waits for its turn of the new one, so a longer period doesn't start with a burst of thinks
+        // (a shorter one just takes effect on the next turn)
+        Int period = c->ai_level >= 0 ? ai->periods[c->ai_level] : 1;
+        if (period > c->ai_period && (c->id + ai->tick) % period != 0)
+        {
+            c->ai_period = period;
+            c->ai_turn = ai->tick + period - (c->id + ai->tick) % period;
+            continue;
+        }
+
+        // with nobody watching everything is far away
+        float closest = INFINITY;
+        for (Int o = 0; o < ai->observer_count; o++)
+        {
+            float distance = Vector3DistanceSqr(c->position, ai->observers[o]);
+            if (distance < closest)
+                closest = distance;
+        }
+
+        int level = 0;
+        while (level < AI_LOD_LEVELS - 1 && closest > limits[level])
+            level++;
+
+        // next tick with (id + tick) % period == 0, so a level's creatures take turns spread over its period
+        period = ai->periods[level];
+        c->ai_level = level;
+        c->ai_period = period;
+        c->ai_turn = ai->tick + period - (c->id + ai->tick) % period;
+        thinks[level]++;
+        nav_steer(sys, c, &field);
+    }
+
+    Int worker = jobs_worker_index();
+    worker = worker > 0 ? worker : 0;
+    for (Int l = 0; l < AI_LOD_LEVELS; l++)
+        ai->thinks[worker][l] += thinks[l];
+}
+
+// decides for this tick's share of the creatures, the rest repeat their last decision (update_separation copies it into move);
+// run before update_separation and update_movement
+void update_ai(InternalSystem* sys)
+{
+    profile_zone("update_ai");
+    AiScheduler* ai = sys->ai;
+    double start = ai_now_ms();
+
+    if (ai->observer_count == 0 && sys->player_index >= 0 && sys->player_index < sys->world.creatures->size)
+        ai->observers[ai->observer_count++] = creature(sys->player_index).position;
+
+    // this tick's bucket, but for whoever waits for a later turn of the wheel
+    CreatureList* bucket = ai->wheel[ai->tick % AI_WHEEL_SIZE];
+    ai->due->size = 0;
+    ai->due_levels->size = 0;
+    for (Int i = 0; i < bucket->size; )
+    {
+        Creature* c = bucket->data[i];
+        if (c->ai_turn > ai->tick)
+        {
+            i++;
+            continue;
+        }
+
+        list_push(*ai->due, c);
+        list_push(*ai->due_levels, c->ai_level);
+        Creature* last = bucket->data[bucket->size - 1];
+        bucket->data[i] = last;
+        last->ai_slot = i;
+        bucket->size--;
+    }
+
+    memset(ai->thinks, 0, sizeof(ai->thinks));
+    jobs_parallel_for(sys->jobs, ai->due->size, CREATURE_JOB_GRAIN, ai_job, sys);
+
+    // back into the wheel in the same order whatever the thread count, and the level sizes follow the changes
+    for (Int i = 0; i < ai->due->size; i++)
+    {
+        Creature* c = ai->due->data[i];
+        Int old = ai->due_levels->data[i];
+        if (old != c->ai_level)
+        {
+            if (old >= 0)
+                ai->levels[old]--;
+            if (c->ai_level >= 0)
+                ai->levels[c->ai_level]++;
+        }
+        ai_schedule(ai, c, c->ai_turn);
+    }
+
+    AiStats* stats = &ai->stats;
+    for (Int l = 0; l < AI_LOD_LEVELS; l++)
+    {
+        stats->creatures[l] = ai->levels[l];
+        stats->thinks[l] = 0;
+        for (Int w = 0; w < JOBS_MAX_WORKERS; w++)
+            stats->thinks[l] += ai->thinks[w][l];
+
+        stats->periods[l] = ai->periods[l];
+    }
+
+    // next tick's periods: level 0 takes up to half the budget, past it it waits longer;
+    // when levels 1 and up would think more than what is left, every one of them waits longer by the same factor
+    Int near_budget = AI_THINK_BUDGET / 2;
+    ai->periods[0] = stats->creatures[0] > near_budget ? (stats->creatures[0] + near_budget - 1) / near_budget : 1;
+    Int budget = AI_THINK_BUDGET - (stats->creatures[0] + ai->periods[0] - 1) / ai->periods[0];
+
+    Int wanted = 0;
+    for (Int l = 1; l < AI_LOD_LEVELS; l++)
+        wanted += (stats->creatures[l] + ai_lod_period[l] - 1) / ai_lod_period[l];
+
+    for (Int l = 1; l < AI_LOD_LEVELS; l++)
+    {
+        Int period = ai_lod_period[l];
+        if (wanted > budget)
+            period = (period * wanted + budget - 1) / budget;
+
+        ai->periods[l] = period;
+    }
+
+    stats->observers = ai->observer_count;
+    ai->observer_count = 0;
+    ai->tick++;
+    stats->ms = ai_now_ms() - start;
+
+    profile_count("ai level 0", stats->creatures[0]);
+    profile_count("ai level 1", stats->creatures[1]);
+    profile_count("ai level 2", stats->creatures[2]);
+    profile_count("ai level 3", stats->creatures[3]);
+    profile_count("ai thinks", stats->thinks[0] + stats->thinks[1] + stats->thinks[2] + stats->thinks[3]);
+}
+
+// the push on an agent at (px, pz) from count neighbours;
+// the weight (r^2 - d^2) / (d^2 + e) is 0 at the radius and grows fast as they close in, with no square root and no branch,
+// and the agent itself adds nothing since its dx and dz are 0
+static Vector2 separation_push(float px, float pz, const float *xs, const float *zs, Int count)
+{
+    const float r2 = AI_SEPARATION_RADIUS * AI_SEPARATION_RADIUS, e = 0.01f * r2;
+    float sum_x = 0, sum_z = 0;
+    for (Int j = 0; j < count; j++)
+    {
+        float dx = px - xs[j], dz = pz - zs[j];
+        float d2 = dx * dx + dz * dz;
+        float weight = (r2 > d2 ? r2 - d2 : 0) / (d2 + e);
+        sum_x += dx * weight;
+        sum_z += dz * weight;
+    }
+    return (Vector2){sum_x, sum_z};
+}
+
+// one bucket at a time, and in it one cell at a time: the agents of the 3x3 cells around are copied into one run,
+// then every agent of the cell walks that run; a crowded cell keeps its first AI_SEPARATION_MAX_NEIGHBOURS;
+// only the crowd arrays are touched here, the creatures get their push afterwards in list order
+static void separation_job(void *data, Int start, Int end)
+{
+    AiScheduler* ai = data;
+    SpatialHash* crowd = ai->crowd;
+    const int *cells_x = ai->crowd_cell_x, *cells_z = ai->crowd_cell_z;
+    float xs[AI_SEPARATION_MAX_NEIGHBOURS], zs[AI_SEPARATION_MAX_NEIGHBOURS];
+    for (Int bucket = start; bucket < end; bucket++)
+    {
+        for (Int e = crowd->starts[bucket]; e < crowd->starts[bucket + 1]; e++)
+        {
+            int cell_x = cells_x[e], cell_z = cells_z[e];
+            // cells sharing the bucket are done when their first agent comes up
+            bool done = false;
+            for (Int k = crowd->starts[bucket]; k < e && !done; k++)
+                done = cells_x[k] == cell_x && cells_z[k] == cell_z;
+
+            if (done)
+                continue;
+
+            // a bucket two of the neighbour cells share is read once
+            Int buckets[9], bucket_count = 0, count = 0;
+            for (int x = cell_x - 1; x <= cell_x + 1; x++)
+            {
+                for (int z = cell_z - 1; z <= cell_z + 1; z++)
+                {
+                    Int b = spatial_hash_bucket(x, z);
+                    bool seen = false;
+                    for (Int k = 0; k < bucket_count; k++)
+                        seen = seen || buckets[k] == b;
+
+                    if (seen)
+                        continue;
+
+                    buckets[bucket_count++] = b;
+                    for (Int k = crowd->starts[b]; k < crowd->starts[b + 1] && count < AI_SEPARATION_MAX_NEIGHBOURS; k++)
+                    {
+                        if (abs(cells_x[k] - cell_x) <= 1 && abs(cells_z[k] - cell_z) <= 1)
+                        {
+                            xs[count] = ai->crowd_x[k];
+                            zs[count] = ai->crowd_z[k];
+                            count++;
+                        }
+                    }
+                }
+            }
+
+            for (Int k = e; k < crowd->starts[bucket + 1]; k++)
+            {
+                if (cells_x[k] == cell_x && cells_z[k] == cell_z)
+                {
+                    Vector2 push = separation_push(ai->crowd_x[k], ai->crowd_z[k], xs, zs, count);
+                    ai->crowd_push_x[k] = push.x;
+                    ai->crowd_push_z[k] = push.y;
+                }
+            }
+        }
+    }
+}
+
+// boids style separation for the agents (creatures with a target), after update_ai and before update_movement;
+// every agent reads the positions as they were at the start and only writes its own move, so replays and thread counts agree;
+// the move is what the agent decided when it last thought (Creature.steer) plus the push
+void update_separation(InternalSystem* sys)
+{
+    profile_zone("update_separation");
+    AiScheduler* ai = sys->ai;
+    double start = ai_now_ms();
+
+    // agents on the exact same spot couldn't tell which way to go, so each one is nudged by a few mm picked by its id
+    SpatialHash* crowd = ai->crowd;
+    spatial_hash_clear(crowd);
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        Creature* c = sys->world.creatures->data[i];
+        if (c->target_id < 0)
+            continue;
+
+        unsigned long hash = (unsigned long)c->id * 2654435761UL;
+        Vector3 nudge = {((hash & 1023) / 1023.0f - 0.5f) * 0.01f, 0, (((hash >> 10) & 1023) / 1023.0f - 0.5f) * 0.01f};
+        spatial_hash_insert(crowd, i, Vector3Add(c->position, nudge));
+    }
+    spatial_hash_build(crowd);
+
+    Int count = crowd->entries->size;
+    if (count > ai->crowd_capacity)
+    {
+        ai->crowd_capacity = count * 2;
+        ai->crowd_x = (float*)realloc(ai->crowd_x, sizeof(float) * ai->crowd_capacity);
+        ai->crowd_z = (float*)realloc(ai->crowd_z, sizeof(float) * ai->crowd_capacity);
+        ai->crowd_push_x = (float*)realloc(ai->crowd_push_x, sizeof(float) * ai->crowd_capacity);
+        ai->crowd_push_z = (float*)realloc(ai->crowd_push_z, sizeof(float) * ai->crowd_capacity);
+        ai->crowd_cell_x = (int*)realloc(ai->crowd_cell_x, sizeof(int) * ai->crowd_capacity);
+        ai->crowd_cell_z = (int*)realloc(ai->crowd_cell_z, sizeof(int) * ai->crowd_capacity);
+    }
+    if (sys->world.creatures->size > ai->slot_capacity)
+    {
+        ai->slot_capacity = sys->world.creatures->size * 2;
+        ai->crowd_slot = (Int*)realloc(ai->crowd_slot, sizeof(Int) * ai->slot_capacity);
+    }
+    for (Int e = 0; e < count; e++)
+    {
+        SpatialEntry* entry = &crowd->entries->data[e];
+        ai->crowd_x[e] = entry->position.x;
+        ai->crowd_z[e] = entry->position.z;
+        ai->crowd_cell_x[e] = entry->cell_x;
+        ai->crowd_cell_z[e] = entry->cell_z;
+        ai->crowd_slot[entry->index] = e;
+    }
+
+    jobs_parallel_for(sys->jobs, SPATIAL_HASH_BUCKETS, CREATURE_JOB_GRAIN, separation_job, ai);
+
+    const float scale = AI_SEPARATION_STRENGTH / (AI_SEPARATION_RADIUS * AI_SEPARATION_RADIUS * AI_SEPARATION_RADIUS);
+    Int pushed = 0;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        Creature* c = sys->world.creatures->data[i];
+        if (c->target_id < 0)
+            continue;
+
+        Int e = ai->crowd_slot[i];
+        c->move = c->steer;
+        if (ai->crowd_push_x[e] == 0 && ai->crowd_push_z[e] == 0)
+            continue;
+
+        pushed++;
+        Vector3 move = {c->move.x + ai->crowd_push_x[e] * scale, c->move.y, c->move.z + ai->crowd_push_z[e] * scale};
+        // never faster than walking
+        float length = sqrtf(move.x * move.x + move.z * move.z);
+        if (length > 1)
+        {
+            move.x /= length;
+            move.z /= length;
+        }
+        c->move = move;
+    }
+
+    ai->stats.agents = count;
+    ai->stats.pushed = pushed;
+    ai->stats.separation_ms = ai_now_ms() - start;
+    profile_count("ai agents", count);
+}
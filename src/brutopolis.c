@@ -0,0 +1,1317 @@
+#define C_PROFILER_IMPLEMENTATION
+#define C_JOBS_IMPLEMENTATION
+#include "brutopolis.h"
+#include "save.h"
+#include "nav.h"
+#include "ai.h"
+
+const char* item_names[] = 
+{
+    "hand",
+    "revolver",
+    "revolver bullets"
+};
+
+const char* equip_image_paths[] = 
+{
+    "data/img/equip_hand.png",
+    "data/img/equip_revolver.png",
+    "data/img/equip_bullet_revolver.png"
+};
+
+const char* item_image_paths[] = 
+{
+    "data/img/item_hand.png",
+    "data/img/item_revolver.png",
+    "data/img/item_bullet_revolver.png"
+};
+
+const int item_capacities[] = 
+{
+    0,
+    6,
+    12
+};
+
+InternalSystem* new_system(char* name, int size_x, int size_y)
+{
+    InternalSystem* _sys = (InternalSystem*)malloc(sizeof(InternalSystem));
+    _sys->player_id = -1;
+    _sys->player_index = -1;
+
+    _sys->resolution = (Vector2){size_x, size_y};
+
+    _sys->name = str_duplicate(name);
+
+    _sys->world.creatures = list_init(CreatureList);
+
+    _sys->world.bullets = list_init(BulletList);
+
+    _sys->world.items = list_init(ItemList);
+
+    _sys->world.creature_slab = slab_init(CreatureSlab, CREATURE_PAGE_SIZE);
+
+    _sys->world.bullet_slab = slab_init(BulletSlab, BULLET_PAGE_SIZE);
+
+    _sys->world.item_slab = slab_init(ItemSlab, ITEM_PAGE_SIZE);
+
+    _sys->world.next_id = 0;
+
+    _sys->world.track_changes = false;
+    for (Int i = 0; i < JOBS_MAX_WORKERS; i++)
+        _sys->world.dirty[i] = list_init(CreatureList);
+
+    _sys->world.removed = list_init(IntList);
+
+    _sys->equip_textures = list_init(TextureList);
+
+    _sys->item_textures = list_init(TextureList);
+
+    _sys->models = list_init(ModelList);
+    _sys->model_lods = list_init(ModelLodList);
+
+    _sys->maps = list_init(MapList);
+
+    _sys->current_map = 0;
+
+    _sys->messages = deque_init(MessageDeque);
+
+    _sys->frame_arena = arena_init(FRAME_ARENA_SIZE);
+    _sys->frame_bytes = 0;
+    _sys->frame_bytes_peak = 0;
+
+    _sys->time = 0;
+
+    _sys->jobs = NULL;
+
+    _sys->nav = nav_init();
+    _sys->ai = ai_init();
+
+    _sys->vm = NULL;
+    _sys->event_creature = -1;
+    _sys->trigger_fires = list_init(TriggerFireList);
+    _sys->event_trigger = -1;
+
+    // camera setup
+    _sys->camera.position = (Vector3){ 0.0f, 1.72f, 3.0f };
+    _sys->camera.target = (Vector3){ 0.0f, 1.72f, 0.0f };
+    _sys->camera.up = (Vector3){ 0.0f, 1.0f, 0.0f };
+    _sys->camera.fovy = 90.0f;
+    _sys->camera.projection = CAMERA_PERSPECTIVE;
+
+    // mouse setup
+    _sys->mouse.delta = (Vector2) {0,0};
+    _sys->mouse.position = (Vector2) {0,0};
+    _sys->mouse.sensibility = 0.003f;
+
+    return _sys;
+}
+
+// drops everything allocated from the frame arena during the frame
+void reset_frame(InternalSystem* _sys)
+{
+    _sys->frame_bytes = _sys->frame_arena->used;
+    if (_sys->frame_bytes > _sys->frame_bytes_peak)
+    {
+        _sys->frame_bytes_peak = _sys->frame_bytes;
+    }
+    arena_reset(_sys->frame_arena);
+}
+
+BoundingBox creature_hitbox(Vector3 position)
+{
+    return (BoundingBox){(Vector3){position.x - 0.4f, position.y, position.z - 0.5f}, (Vector3){position.x + 0.4f, position.y + 1.93, position.z + 0.5f}};
+}
+
+void free_system(InternalSystem* _sys)
+{
+    free(_sys->name);
+    for (Int i = 0; i < _sys->world.creatures->size; i++)
+    {
+        free(_sys->world.creatures->data[i]->name);
+        small_list_free(_sys->world.creatures->data[i]->inventory);
+    }
+    list_free(*_sys->world.creatures);
+    list_free(*_sys->world.bullets);
+    list_free(*_sys->world.items);
+    for (Int i = 0; i < JOBS_MAX_WORKERS; i++)
+        list_free(*_sys->world.dirty[i]);
+    list_free(*_sys->world.removed);
+    list_free(*_sys->trigger_fires);
+    slab_free(*_sys->world.creature_slab);
+    slab_free(*_sys->world.bullet_slab);
+    slab_free(*_sys->world.item_slab);
+    while (_sys->messages->size > 0)
+    {
+        free(deque_shift(*_sys->messages).text);
+    }
+    deque_free(*_sys->messages);
+    arena_free(_sys->frame_arena);
+    nav_free(_sys->nav);
+    ai_free(_sys->ai);
+    free(_sys);
+}
+
+void push_message(InternalSystem* _sys, const char* text)
+{
+    // repeated messages (e.g. holding a key) just refresh the last one
+    if (_sys->messages->size > 0 && strcmp(deque_last(*_sys->messages).text, text) == 0)
+    {
+        deque_last(*_sys->messages).time = _sys->time;
+        return;
+    }
+
+    if (_sys->messages->size == MAX_MESSAGES)
+    {
+        free(deque_shift(*_sys->messages).text);
+    }
+
+    Message message = {str_duplicate(text), _sys->time};
+    deque_push(*_sys->messages, message);
+}
+
+void expire_messages(InternalSystem* _sys)
+{
+    while (_sys->messages->size > 0 && _sys->time - deque_first(*_sys->messages).time > MESSAGE_DURATION)
+    {
+        free(deque_shift(*_sys->messages).text);
+    }
+}
+
+function(brl_push_message)
+{
+    push_message((InternalSystem*)arg(0).pointer, arg(1).string);
+    return -1;
+}
+
+Int new_creature(InternalSystem* _sys, const char* name, int x, int y, int z)
+{
+    Creature* creature = slab_alloc(*_sys->world.creature_slab);
+    creature->id = _sys->world.next_id++;
+    creature->position = (Vector3){ x, y, z };
+    creature->size = (Vector3){ 1.0f, 1.70f, 1.0f };
+    creature->current_item = 0;
+    creature->color = RED;
+    creature->speed = 0.1f;
+    creature->status = 0;
+    
+    creature->name = str_duplicate(name);
+    creature->direction = (Vector3){0,0,0};
+    creature->rotation = (Vector3){0,0,0};
+    creature->move = (Vector3){0,0,0};
+
+    // NAN never compares equal, so the first trigger update always treats the creature as moved
+    creature->last_position = (Vector3){NAN, NAN, NAN};
+    creature->trigger_count = 0;
+
+    small_list_init(creature->inventory);
+    array_index_by(small_list_data(creature->inventory), creature->inventory.size, .type, creature->item_slots, ITEM_COUNT);
+
+    creature->target_id = -1;
+    creature->steer = (Vector3){0,0,0};
+    ai_enroll(_sys->ai, creature);
+    creature->dirty = false;
+    mark_dirty(_sys, creature);
+    
+    list_push(*_sys->world.creatures, creature);
+    Int id = _sys->world.creatures->size - 1;
+    return id;
+}
+
+// swap removes the creature from the world and gives its memory back to the slab
+void kill_creature(InternalSystem* _sys, Int id)
+{
+    Creature* creature = list_fast_remove(*_sys->world.creatures, id);
+    ai_forget(_sys->ai, creature);
+    // the last creature took the slot, the player is gone or might be the one that moved
+    if (_sys->player_index == id)
+        _sys->player_index = -1;
+    else if (_sys->player_index == _sys->world.creatures->size)
+        _sys->player_index = id;
+
+    if (_sys->world.track_changes)
+        list_push(*_sys->world.removed, creature->id);
+
+    // still in a dirty list, the journal skips it (or writes whoever gets this memory next, marked by new_creature)
+    creature->dirty = false;
+    free(creature->name);
+    small_list_free(creature->inventory);
+    slab_release(*_sys->world.creature_slab, creature);
+}
+
+// index of the creature with that id, -1 when it is gone; hint is where it was last seen,
+// it is still there unless something was swap removed over it, so callers that keep the index mostly skip the scan
+Int find_creature(InternalSystem* _sys, Int id, Int hint)
+{
+    CreatureList* creatures = _sys->world.creatures;
+    if (hint >= 0 && hint < creatures->size && creatures->data[hint]->id == id)
+        return hint;
+
+    for (Int i = 0; i < creatures->size; i++)
+    {
+        if (creatures->data[i]->id == id)
+            return i;
+    }
+    return -1;
+}
+
+// the creature at index (-1 for none) becomes the player
+void set_player(InternalSystem* _sys, Int index)
+{
+    _sys->player_index = index;
+    _sys->player_id = index >= 0 ? _sys->world.creatures->data[index]->id : -1;
+}
+
+// player_index again from player_id, once a tick and after anything that rebuilds the world list
+void resolve_player(InternalSystem* _sys)
+{
+    _sys->player_index = _sys->player_id >= 0 ? find_creature(_sys, _sys->player_id, _sys->player_index) : -1;
+}
+
+// records the creature for the next journal entry, once until that entry is written;
+// a creature is only touched by one job at a time and every worker has its own list, so the parallel passes can call it
+void mark_dirty(InternalSystem* _sys, Creature* creature)
+{
+    if (!_sys->world.track_changes || creature->dirty)
+        return;
+
+    creature->dirty = true;
+    Int worker = jobs_worker_index();
+    list_push(*_sys->world.dirty[worker > 0 ? worker : 0], creature);
+}
+
+// forgets every change recorded so far, the world as it is becomes the base for the next journal entry
+void clear_dirty(InternalSystem* _sys)
+{
+    for (Int w = 0; w < JOBS_MAX_WORKERS; w++)
+    {
+        CreatureList *dirty = _sys->world.dirty[w];
+        // killed creatures stay in the list, their memory still belongs to the slab
+        for (Int i = 0; i < dirty->size; i++)
+            dirty->data[i]->dirty = false;
+
+        dirty->size = 0;
+    }
+    _sys->world.removed->size = 0;
+}
+
+// scripts only ever see creature ids, list indexes change on every removal
+function(brl_new_creature)
+{
+    InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
+    char* name = arg(1).string;
+    int x = (int)arg(2).number;
+    int y = (int)arg(3).number;
+    int z = (int)arg(4).number;
+    Int index = new_creature(_sys, name, x, y, z);
+    Int creature_id = new_number(vm, _sys->world.creatures->data[index]->id);
+    return creature_id;
+}
+
+// kill.creature system id, nothing happens when the creature is already gone
+function(brl_kill_creature)
+{
+    InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
+    Int index = find_creature(_sys, (Int)arg(1).number, -1);
+    if (index >= 0)
+        kill_creature(_sys, index);
+    return -1;
+}
+
+// presize the world lists, so spawning up to these counts never reallocates
+void reserve_world(InternalSystem* _sys, Int creatures, Int bullets)
+{
+    list_reserve(*_sys->world.creatures, creatures);
+    list_reserve(*_sys->world.bullets, bullets);
+}
+
+function(brl_reserve_world)
+{
+    reserve_world((InternalSystem*)arg(0).pointer, arg(1).number, arg(2).number);
+    return -1;
+}
+
+Bullet* new_bullet(InternalSystem* _sys, Vector3 position, Vector3 direction, Float speed)
+{
+    Bullet *bullet = slab_alloc(*_sys->world.bullet_slab);
+    bullet->id = _sys->world.next_id++;
+    bullet->position = position;
+    bullet->direction = direction;
+    bullet->speed = speed;
+    bullet->origin = position;
+    list_push(*_sys->world.bullets, bullet);
+    return bullet;
+}
+
+void remove_bullet(InternalSystem* _sys, Int id)
+{
+    Bullet* bullet = list_fast_remove(*_sys->world.bullets, id);
+    slab_release(*_sys->world.bullet_slab, bullet);
+}
+
+// items are mostly stored by value (inventories), new_item is for the ones that need a stable address,
+// they live in world.items (saved and journaled with the world) until remove_item
+Item make_item(char* name, char type, int capacity, int content_type, int content)
+{
+    Item item = {0};
+    item.type = type;
+    item.capacity = capacity;
+    item.content_type = content_type;
+    item.content = content;
+    return item;
+}
+
+Item* new_item(InternalSystem* _sys, char* name, char type, int capacity, int content_type, int content)
+{
+    Item* item = slab_alloc(*_sys->world.item_slab);
+    *item = make_item(name, type, capacity, content_type, content);
+    list_push(*_sys->world.items, item);
+    return item;
+}
+
+// swap removes the item from the world and gives its memory back to the slab
+void remove_item(InternalSystem* _sys, Int id)
+{
+    Item* item = list_fast_remove(*_sys->world.items, id);
+    slab_release(*_sys->world.item_slab, item);
+}
+
+function(brl_new_item)
+{
+    InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
+    char* name = arg(1).string;
+    char type = arg(2).number;
+    int capacity = (int)arg(3).number;
+    int content_type = (int)arg(4).number;
+    int content = (int)arg(5).number;
+    Item* item = new_item(_sys, name, type, capacity, content_type, content);
+    Int item_index = new_var(vm);
+    data(item_index).pointer = item;
+    return item_index;
+}
+
+// the item is gone after this, so should be every variable holding it
+function(brl_remove_item)
+{
+    InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
+    Int index = list_find(*_sys->world.items, (Item*)arg(1).pointer);
+    if (index >= 0)
+        remove_item(_sys, index);
+    return -1;
+}
+
+// item_slots must be rebuilt every time the inventory changes
+void inventory_add(Creature* creature, Item item)
+{
+    small_list_push(creature->inventory, item);
+    array_index_by(small_list_data(creature->inventory), creature->inventory.size, .type, creature->item_slots, ITEM_COUNT);
+}
+
+void inventory_remove(Creature* creature, Int slot)
+{
+    // the last item is swapped into slot, so the current item might move
+    if (creature->current_item == creature->inventory.size - 1)
+        creature->current_item = slot;
+
+    small_list_fast_remove(creature->inventory, slot);
+    if (creature->current_item >= creature->inventory.size)
+        creature->current_item = creature->inventory.size - 1;
+
+    array_index_by(small_list_data(creature->inventory), creature->inventory.size, .type, creature->item_slots, ITEM_COUNT);
+}
+
+void reload_item(InternalSystem* sys, Creature* creature)
+{
+    switch (small_list_get(creature->inventory, creature->current_item).type)
+    {
+        case ITEM_REVOLVER:
+        {
+            Item* weapon = &small_list_get(creature->inventory, creature->current_item);
+            Int ammo_type = weapon->content_type;
+            Int slot = ammo_type >= 0 && ammo_type < ITEM_COUNT ? creature->item_slots[ammo_type] : -1;
+            // take from the ammo stacks until the weapon is full or there is no ammo left
+            while (weapon->content < weapon->capacity && slot != -1)
+            {
+                Item* ammo = &small_list_get(creature->inventory, slot);
+                int needed = weapon->capacity - weapon->content;
+                int taken = ammo->content < needed ? ammo->content : needed;
+                mark_dirty(sys, creature);
+                weapon->content += taken;
+                ammo->content -= taken;
+                if (ammo->content > 0)
+                    break;
+
+                // remove the empty item, this might move the weapon
+                inventory_remove(creature, slot);
+                weapon = &small_list_get(creature->inventory, creature->current_item);
+                slot = creature->item_slots[ammo_type];
+            }
+            break;
+        }
+        default:
+            if (sys->player_index >= 0 && creature == sys->world.creatures->data[sys->player_index])
+                push_message(sys, "can't reload this item");
+            break;
+    }
+}
+
+void use_item(InternalSystem* sys, Creature* creature)
+{
+    switch (small_list_get(creature->inventory, creature->current_item).type)
+    {
+    case ITEM_HAND:
+        break;
+    case ITEM_REVOLVER:
+
+        if (small_list_get(creature->inventory, creature->current_item).content == 0)
+        {
+            if (sys->player_index >= 0 && creature == sys->world.creatures->data[sys->player_index])
+                push_message(sys, "no bullets");
+            // try to reload
+            reload_item(sys,creature);
+            return;
+        }
+
+        small_list_get(creature->inventory, creature->current_item).content--;
+        mark_dirty(sys, creature);
+
+        new_bullet(sys, (Vector3){creature->position.x, creature->position.y + 1.7f, creature->position.z}, creature->direction, BULLET_SPEED);
+        break;
+    case ITEM_BULLET_REVOLVER:
+        break;
+    default:
+        break;
+    }
+}
+
+// the hitboxes are filled by whoever loads the map geometry
+Int new_map(InternalSystem* sys, char* name, int model_id)
+{
+    Map map = {0};
+    map.name = str_duplicate(name);
+    map.model_id = model_id;
+    map.hitboxes = list_init(BoundingBoxList);
+    map.triggers = list_init(TriggerList);
+    map.trigger_grid = list_init(IntListList);
+    for (int i = 0; i < TRIGGER_GRID_BUCKETS; i++)
+    {
+        list_push(*map.trigger_grid, ((IntList){NULL, 0, 0}));
+    }
+    list_push(*sys->maps, map);
+    return sys->maps->size - 1;
+}
+
+Int trigger_bucket(Int cell_x, Int cell_z)
+{
+    return ((unsigned long)(cell_x * 73856093) ^ (unsigned long)(cell_z * 19349663)) % TRIGGER_GRID_BUCKETS;
+}
+
+Int trigger_bucket_at(Vector3 position)
+{
+    return trigger_bucket(floorf(position.x / TRIGGER_CELL_SIZE), floorf(position.z / TRIGGER_CELL_SIZE));
+}
+
+void new_trigger(InternalSystem* sys, Map* map, BoundingBox box, char kind, char* body)
+{
+    Trigger trigger = {0};
+    trigger.box = box;
+    trigger.kind = kind;
+    trigger.commands = list_init(CommandList);
+
+    // parse every command once, firing the trigger only interprets the parsed arguments
+    StringList *commands = special_split(body, ';');
+    for (Int i = 0; i < commands->size; i++)
+    {
+        char *command = commands->data[i];
+        while (isspace(*command))
+            command++;
+
+        if (*command != '\0')
+            list_push(*trigger.commands, parse(sys->vm, command, NULL));
+
+        free(commands->data[i]);
+    }
+    list_free(*commands);
+
+    list_push(*map->triggers, trigger);
+    Int id = map->triggers->size - 1;
+
+    // register the trigger in every cell its box overlaps
+    Int min_x = floorf(box.min.x / TRIGGER_CELL_SIZE), max_x = floorf(box.max.x / TRIGGER_CELL_SIZE);
+    Int min_z = floorf(box.min.z / TRIGGER_CELL_SIZE), max_z = floorf(box.max.z / TRIGGER_CELL_SIZE);
+    for (Int x = min_x; x <= max_x; x++)
+    {
+        for (Int z = min_z; z <= max_z; z++)
+        {
+            IntList *bucket = &map->trigger_grid->data[trigger_bucket(x, z)];
+            // ids are pushed in increasing order, so buckets stay sorted
+            if (list_sorted_find(*bucket, id) == -1)
+                list_push(*bucket, id);
+        }
+    }
+}
+
+// event file format, one trigger per line:
+// <enter|exit|stay> <min x> <min y> <min z> <max x> <max y> <max z> <bruter script>
+// lines starting with // are ignored
+void load_map_events(InternalSystem* sys, Map* map, char* path)
+{
+    profile_zone("load_map_events");
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return;
+
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char kind[16];
+        BoundingBox box;
+        int body = 0;
+        if (strncmp(line, "//", 2) == 0)
+            continue;
+
+        if (sscanf(line, "%15s %f %f %f %f %f %f %n", kind, &box.min.x, &box.min.y, &box.min.z, &box.max.x, &box.max.y, &box.max.z, &body) < 7 || body == 0)
+            continue;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(kind, "enter") == 0)
+            new_trigger(sys, map, box, EVENT_ENTER, line + body);
+        else if (strcmp(kind, "exit") == 0)
+            new_trigger(sys, map, box, EVENT_EXIT, line + body);
+        else if (strcmp(kind, "stay") == 0)
+            new_trigger(sys, map, box, EVENT_STAY, line + body);
+        else
+            printf("%s: unknown event kind '%s'\n", path, kind);
+    }
+    fclose(file);
+}
+
+// hitboxes straight from an obj file, for when there is no gl context to load the model with (the dedicated server);
+// same layout load_map expects: the first group with faces is the map itself (its box goes to bounds), every other group is a hitbox
+bool load_obj_hitboxes(char* path, BoundingBoxList* hitboxes, BoundingBox* bounds)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        printf("could not open %s\n", path);
+        return false;
+    }
+
+    typedef List(Vector3) VertexList;
+    VertexList *vertices = list_init(VertexList);
+    Int group = -1; // faces seen so far belong to this group, -1 before the first group with faces
+    bool new_group = true;
+    BoundingBox box = {0};
+    char line[1024];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == 'v' && line[1] == ' ')
+        {
+            Vector3 v;
+            if (sscanf(line + 2, "%f %f %f", &v.x, &v.y, &v.z) == 3)
+                list_push(*vertices, v);
+        }
+        else if ((line[0] == 'g' || line[0] == 'o') && line[1] == ' ')
+        {
+            new_group = true;
+        }
+        else if (line[0] == 'f' && line[1] == ' ')
+        {
+            if (new_group)
+            {
+                if (group == 0)
+                    *bounds = box;
+                else if (group > 0)
+                    list_push(*hitboxes, box);
+
+                group++;
+                new_group = false;
+                box = (BoundingBox){(Vector3){INFINITY, INFINITY, INFINITY}, (Vector3){-INFINITY, -INFINITY, -INFINITY}};
+            }
+
+            // f v/vt/vn ..., negative indexes count from the end
+            char *token = strtok(line + 2, " \t\r\n");
+            while (token != NULL)
+            {
+                long index = strtol(token, NULL, 10);
+                index = index < 0 ? vertices->size + index : index - 1;
+                if (index >= 0 && index < vertices->size)
+                {
+                    box.min = Vector3Min(box.min, vertices->data[index]);
+                    box.max = Vector3Max(box.max, vertices->data[index]);
+                }
+                token = strtok(NULL, " \t\r\n");
+            }
+        }
+    }
+
+    if (group == 0)
+        *bounds = box;
+    else if (group > 0)
+        list_push(*hitboxes, box);
+
+    list_free(*vertices);
+    fclose(file);
+    return group >= 0;
+}
+
+bool check_move_collision(InternalSystem* sys, Vector3 position, Vector3 move, float size)
+{
+    bool collision = false;
+    for (int i = 0; i < sys->maps->data[sys->current_map].hitboxes->size; i++)
+    {
+        if (box_sphere_collision(sys->maps->data[sys->current_map].hitboxes->data[i], Vector3Add(position, move), size))
+        {
+            collision = true;
+            break;
+        }
+    }
+    return collision;
+}
+
+// event.creature is the id of the creature, like everything a script gets to see of it
+void fire_trigger(InternalSystem* sys, Int creature_id, Int trigger_id)
+{
+    profile_zone("event");
+    // the commands list outlives a realloc of sys->maps by the script itself
+    CommandList* commands = sys->maps->data[sys->current_map].triggers->data[trigger_id].commands;
+    VirtualMachine *vm = sys->vm;
+    data(sys->event_creature).number = creature_id;
+    data(sys->event_trigger).number = trigger_id;
+    for (Int i = 0; i < commands->size; i++)
+    {
+        interpret_args(vm, commands->data[i], NULL);
+    }
+}
+
+static void queue_fire(InternalSystem* sys, Int index, Int trigger_id)
+{
+    TriggerFire fire = {creature(index).id, index, trigger_id};
+    list_push(*sys->trigger_fires, fire);
+}
+
+// the scan only queues the fires, the scripts can spawn or kill creatures, load a world or add maps
+// (which moves sys->maps), so they run afterwards; each fire finds its creature again by id and
+// is skipped if it is gone, a script that switches maps drops the fires left for the old one
+void update_triggers(InternalSystem* sys)
+{
+    Map* map = &sys->maps->data[sys->current_map];
+    if (map->triggers->size == 0)
+        return;
+
+    sys->trigger_fires->size = 0;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        Vector3 position = creature(i).position;
+        Vector3 last = creature(i).last_position;
+
+        if (position.x == last.x && position.y == last.y && position.z == last.z)
+        {
+            // did not move, nothing enters or leaves
+            for (Int t = 0; t < creature(i).trigger_count; t++)
+            {
+                if (map->triggers->data[creature(i).triggers[t]].kind == EVENT_STAY)
+                    queue_fire(sys, i, creature(i).triggers[t]);
+            }
+            continue;
+        }
+
+        creature(i).last_position = position;
+
+        Int inside[MAX_CREATURE_TRIGGERS];
+        Int inside_count = 0;
+        IntList *bucket = &map->trigger_grid->data[trigger_bucket_at(position)];
+        for (Int b = 0; b < bucket->size && inside_count < MAX_CREATURE_TRIGGERS; b++)
+        {
+            BoundingBox box = map->triggers->data[bucket->data[b]].box;
+            if (position.x >= box.min.x && position.x <= box.max.x &&
+                position.y >= box.min.y && position.y <= box.max.y &&
+                position.z >= box.min.z && position.z <= box.max.z)
+            {
+                inside[inside_count++] = bucket->data[b];
+            }
+        }
+
+        Int previous[MAX_CREATURE_TRIGGERS];
+        Int previous_count = creature(i).trigger_count;
+        memcpy(previous, creature(i).triggers, sizeof(Int) * previous_count);
+        memcpy(creature(i).triggers, inside, sizeof(Int) * inside_count);
+        creature(i).trigger_count = inside_count;
+
+        for (Int p = 0; p < previous_count; p++)
+        {
+            bool still_inside = false;
+            for (Int n = 0; n < inside_count; n++)
+                still_inside = still_inside || inside[n] == previous[p];
+
+            if (!still_inside && map->triggers->data[previous[p]].kind == EVENT_EXIT)
+                queue_fire(sys, i, previous[p]);
+        }
+
+        for (Int n = 0; n < inside_count; n++)
+        {
+            bool was_inside = false;
+            for (Int p = 0; p < previous_count; p++)
+                was_inside = was_inside || inside[n] == previous[p];
+
+            char kind = map->triggers->data[inside[n]].kind;
+            if ((!was_inside && kind == EVENT_ENTER) || (was_inside && kind == EVENT_STAY))
+                queue_fire(sys, i, inside[n]);
+        }
+    }
+
+    Int current_map = sys->current_map;
+    for (Int f = 0; f < sys->trigger_fires->size && sys->current_map == current_map; f++)
+    {
+        TriggerFire fire = sys->trigger_fires->data[f];
+        if (find_creature(sys, fire.creature_id, fire.creature_index) >= 0)
+            fire_trigger(sys, fire.creature_id, fire.trigger_id);
+    }
+}
+
+SpatialHash* spatial_hash_init(float cell_size)
+{
+    SpatialHash* hash = (SpatialHash*)malloc(sizeof(SpatialHash));
+    hash->cell_size = cell_size;
+    hash->pending = list_init(SpatialEntryList);
+    hash->entries = list_init(SpatialEntryList);
+    memset(hash->starts, 0, sizeof(hash->starts));
+    return hash;
+}
+
+void spatial_hash_free(SpatialHash* hash)
+{
+    list_free(*hash->pending);
+    list_free(*hash->entries);
+    free(hash);
+}
+
+Int spatial_hash_bucket(int cell_x, int cell_z)
+{
+    return ((unsigned long)(cell_x * 73856093) ^ (unsigned long)(cell_z * 19349663)) % SPATIAL_HASH_BUCKETS;
+}
+
+void spatial_hash_clear(SpatialHash* hash)
+{
+    hash->pending->size = 0;
+}
+
+void spatial_hash_insert(SpatialHash* hash, Int index, Vector3 position)
+{
+    SpatialEntry entry = {floorf(position.x / hash->cell_size), floorf(position.z / hash->cell_size), position, index};
+    list_push(*hash->pending, entry);
+}
+
+// counting sort by bucket
+void spatial_hash_build(SpatialHash* hash)
+{
+    SpatialEntryList *pending = hash->pending;
+    memset(hash->starts, 0, sizeof(hash->starts));
+    for (Int i = 0; i < pending->size; i++)
+        hash->starts[spatial_hash_bucket(pending->data[i].cell_x, pending->data[i].cell_z) + 1]++;
+
+    for (Int b = 0; b < SPATIAL_HASH_BUCKETS; b++)
+        hash->starts[b + 1] += hash->starts[b];
+
+    list_reserve(*hash->entries, pending->size);
+    hash->entries->size = pending->size;
+    Int next[SPATIAL_HASH_BUCKETS];
+    memcpy(next, hash->starts, sizeof(next));
+    for (Int i = 0; i < pending->size; i++)
+        hash->entries->data[next[spatial_hash_bucket(pending->data[i].cell_x, pending->data[i].cell_z)]++] = pending->data[i];
+}
+
+// appends the index of every point within radius of center on the xz plane, returns how many;
+// cells that share a bucket are told apart by their coordinates, so nothing comes out twice
+Int spatial_hash_query(SpatialHash* hash, Vector3 center, float radius, IntList* out)
+{
+    Int found = 0;
+    int min_x = floorf((center.x - radius) / hash->cell_size), max_x = floorf((center.x + radius) / hash->cell_size);
+    int min_z = floorf((center.z - radius) / hash->cell_size), max_z = floorf((center.z + radius) / hash->cell_size);
+    for (int x = min_x; x <= max_x; x++)
+    {
+        for (int z = min_z; z <= max_z; z++)
+        {
+            Int bucket = spatial_hash_bucket(x, z);
+            for (Int i = hash->starts[bucket]; i < hash->starts[bucket + 1]; i++)
+            {
+                SpatialEntry *entry = &hash->entries->data[i];
+                float dx = entry->position.x - center.x, dz = entry->position.z - center.z;
+                if (entry->cell_x == x && entry->cell_z == z && dx * dx + dz * dz <= radius * radius)
+                {
+                    list_push(*out, entry->index);
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void move_creature(InternalSystem* sys, Int id, Vector3 move)
+{
+    if (check_move_collision(sys, creature(id).position, move, 0.1) == 0)
+    {
+        creature(id).position = Vector3Add(creature(id).position, Vector3Scale(move, creature(id).speed));
+        mark_dirty(sys, &creature(id));
+    }
+}
+
+// the parallel passes only write to the creature/bullet they are given and read the map,
+// anything that touches the world lists is left to the serial part, so the result does not depend on the thread count
+
+static void movement_job(void *data, Int start, Int end)
+{
+    InternalSystem* sys = data;
+    for (Int i = start; i < end; i++)
+    {
+        if (creature(i).move.x != 0 || creature(i).move.y != 0 || creature(i).move.z != 0)
+        {
+            move_creature(sys, i, creature(i).move);
+            creature(i).move = (Vector3){0,0,0};
+        }
+    }
+}
+
+void update_movement(InternalSystem* sys)
+{
+    jobs_parallel_for(sys->jobs, sys->world.creatures->size, CREATURE_JOB_GRAIN, movement_job, sys);
+}
+
+typedef struct
+{
+    InternalSystem* sys;
+    BoundingBox* hitboxes; // creature hitboxes at the start of the tick
+    Int* hits; // first creature hit by each bullet, -1 if none
+    bool* far; // bullet is out of range
+} BulletPass;
+
+static void bullet_job(void *data, Int start, Int end)
+{
+    BulletPass* pass = data;
+    InternalSystem* sys = pass->sys;
+    Int creature_count = sys->world.creatures->size;
+    for (Int i = start; i < end; i++)
+    {
+        bullet(i).position = Vector3Add(bullet(i).position, Vector3Scale(bullet(i).direction, bullet(i).speed));
+
+        pass->hits[i] = -1;
+        for (Int j = 0; j < creature_count; j++)
+        {
+            if (box_sphere_collision(pass->hitboxes[j], bullet(i).position, 0.1f))
+            {
+                pass->hits[i] = j;
+                break;
+            }
+        }
+
+        pass->far[i] = Vector3Distance(bullet(i).origin, bullet(i).position) > BULLET_RANGE;
+    }
+}
+
+// moves the bullets and resolves their hits, bullets past their range are dropped
+// (by distance from where they were fired, the camera doesn't move on a server);
+// hits are resolved in bullet order, each creature takes the first bullet that reaches it,
+// removals are deferred until the end of the pass and done from the highest index down,
+// so the swaps of list_fast_remove never move an element that is still waiting to be removed
+void update_bullets(InternalSystem* sys)
+{
+    Int creature_count = sys->world.creatures->size;
+    Int bullet_count = sys->world.bullets->size;
+    if (bullet_count == 0)
+        return;
+
+    BulletPass pass;
+    pass.sys = sys;
+    pass.hitboxes = arena_array(sys->frame_arena, BoundingBox, creature_count);
+    pass.hits = arena_array(sys->frame_arena, Int, bullet_count);
+    pass.far = arena_array(sys->frame_arena, bool, bullet_count);
+    for (Int j = 0; j < creature_count; j++)
+    {
+        pass.hitboxes[j] = creature_hitbox(creature(j).position);
+    }
+
+    jobs_parallel_for(sys->jobs, bullet_count, BULLET_JOB_GRAIN, bullet_job, &pass);
+
+    bool* dead = arena_array(sys->frame_arena, bool, creature_count);
+    memset(dead, 0, sizeof(bool) * creature_count);
+    Int* removed_bullets = arena_array(sys->frame_arena, Int, bullet_count);
+    Int removed_count = 0;
+    for (Int i = 0; i < bullet_count; i++)
+    {
+        Int j = pass.hits[i];
+        // the creature was already taken by an earlier bullet, look for the next one this bullet touches
+        while (j >= 0 && dead[j])
+        {
+            Int next = -1;
+            for (Int k = j + 1; k < creature_count; k++)
+            {
+                if (box_sphere_collision(pass.hitboxes[k], bullet(i).position, 0.1f))
+                {
+                    next = k;
+                    break;
+                }
+            }
+            j = next;
+        }
+
+        if (j >= 0)
+            dead[j] = true;
+
+        if (j >= 0 || pass.far[i])
+            removed_bullets[removed_count++] = i;
+    }
+
+    for (Int j = creature_count - 1; j >= 0; j--)
+    {
+        if (dead[j])
+            kill_creature(sys, j);
+    }
+
+    for (Int i = removed_count - 1; i >= 0; i--)
+    {
+        remove_bullet(sys, removed_bullets[i]);
+    }
+}
+
+static void gravity_job(void *data, Int start, Int end)
+{
+    InternalSystem* sys = data;
+    BoundingBoxList* hitboxes = sys->maps->data[sys->current_map].hitboxes;
+    for (Int i = start; i < end; i++)
+    {
+        Vector3 below = Vector3Add(creature(i).position, (Vector3){0,-0.1,0});
+        // land on the highest surface the feet are touching
+        Int ground = -1;
+        for (Int j = 0; j < hitboxes->size; j++)
+        {
+            if (box_sphere_collision(hitboxes->data[j], below, 0.1) && (ground == -1 || hitboxes->data[j].max.y > hitboxes->data[ground].max.y))
+            {
+                ground = j;
+            }
+        }
+
+        if (ground == -1)
+        {
+            creature(i).position.y -= 0.1f;
+            mark_dirty(sys, &creature(i));
+        }
+        else if (hitboxes->data[ground].max.y <= creature(i).position.y)
+        {
+            // standing creatures land on the same height every tick, that is not a change
+            float y = hitboxes->data[ground].max.y + 0.2;
+            if (creature(i).position.y != y)
+            {
+                creature(i).position.y = y;
+                mark_dirty(sys, &creature(i));
+            }
+        }
+        // else only touching something from the side (a wall), stay put
+    }
+}
+
+void update_gravity(InternalSystem* sys)
+{
+    jobs_parallel_for(sys->jobs, sys->world.creatures->size, CREATURE_JOB_GRAIN, gravity_job, sys);
+}
+
+// one simulation step, everything but input and drawing
+void world_tick(InternalSystem* sys)
+{
+    resolve_player(sys);
+    profile_begin("navigation");
+    update_navigation(sys);
+    profile_end();
+
+    profile_begin("ai");
+    update_ai(sys);
+    update_separation(sys);
+    profile_end();
+
+    profile_begin("movement");
+    update_movement(sys);
+    profile_end();
+
+    profile_begin("bullets");
+    update_bullets(sys);
+    profile_end();
+
+    profile_begin("gravity");
+    update_gravity(sys);
+    profile_end();
+
+    profile_begin("triggers");
+    update_triggers(sys);
+    profile_end();
+}
+
+InputQueue* input_queue_init(void)
+{
+    InputQueue* queue = (InputQueue*)malloc(sizeof(InputQueue));
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    queue->dropped = 0;
+    return queue;
+}
+
+void input_queue_free(InputQueue* queue)
+{
+    free(queue);
+}
+
+// producer only, a full queue drops the event
+bool input_push(InputQueue* queue, InputEvent event)
+{
+    long tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&queue->head, memory_order_acquire) == INPUT_QUEUE_SIZE)
+    {
+        queue->dropped++;
+        return false;
+    }
+
+    event.sequence = tail;
+    queue->events[tail % INPUT_QUEUE_SIZE] = event;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// consumer only
+bool input_pop(InputQueue* queue, InputEvent* event)
+{
+    long head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&queue->tail, memory_order_acquire))
+        return false;
+
+    *event = queue->events[head % INPUT_QUEUE_SIZE];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
+}
+
+// Rotação com mouse, the renderer uses the same math to apply the look the simulation has not seen yet
+Vector3 apply_look(Vector3 rotation, Vector2 delta, float sensibility)
+{
+    rotation.x += delta.x * sensibility;
+    rotation.y -= delta.y * sensibility;
+
+    // Limitar rotação vertical
+    rotation.y = Clamp(rotation.y, -PI/2.5f, PI/2.5f);
+    return rotation;
+}
+
+// Calcular direção da câmera
+Vector3 look_direction(Vector3 rotation)
+{
+    Vector3 direction =
+    {
+        cosf(rotation.x) * cosf(rotation.y),
+        sinf(rotation.y),
+        sinf(rotation.x) * cosf(rotation.y)
+    };
+    return Vector3Normalize(direction);
+}
+
+void init_player_input(PlayerInput* input)
+{
+    memset(input, 0, sizeof(PlayerInput));
+    input->sequence = -1;
+}
+
+// the player part of a tick: every queued event is applied in order, so a shot uses the aim it was fired with,
+// then the player moves once with the keys held at the end of the tick
+void apply_player_input(InternalSystem* sys, InputQueue* queue, PlayerInput* input)
+{
+    resolve_player(sys);
+    if (sys->player_index < 0)
+        return;
+
+    Int player_index = sys->player_index;
+    Creature* player = sys->world.creatures->data[player_index];
+    bool fired = false;
+    InputEvent event;
+    while (input_pop(queue, &event))
+    {
+        input->sequence = event.sequence;
+        input->time = event.time;
+        switch (event.type)
+        {
+            case INPUT_LOOK:
+                sys->mouse.delta = (Vector2){event.value.x, event.value.y};
+                input->look_x += event.value.x;
+                input->look_y += event.value.y;
+                player->rotation = apply_look(player->rotation, sys->mouse.delta, sys->mouse.sensibility);
+                player->direction = look_direction(player->rotation);
+                mark_dirty(sys, player);
+                sys->camera.target = Vector3Add(sys->camera.position, player->direction);
+                break;
+            case INPUT_MOVE:
+                input->move = event.value;
+                break;
+            case INPUT_RELOAD:
+                input->reload = event.value.x != 0;
+                break;
+            case INPUT_WHEEL:
+                // mouse wheel to scroll through items
+                player->current_item += (Int)event.value.x;
+                player->current_item = Clamp(player->current_item, 0, player->inventory.size - 1);
+                mark_dirty(sys, player);
+                break;
+            case INPUT_FIRE:
+            {
+                // Atirar
+                Int bullet_count = sys->world.bullets->size;
+                use_item(sys, player);
+                fired = true;
+                if (sys->world.bullets->size > bullet_count)
+                {
+                    // the shot happened between ticks, move the bullet to where it would be by now
+                    float lead = Clamp((sys->time - event.time) * TICK_RATE, 0, MAX_SHOT_LEAD_TICKS);
+                    Bullet* shot = sys->world.bullets->data[sys->world.bullets->size - 1];
+                    shot->position = Vector3Add(shot->position, Vector3Scale(shot->direction, shot->speed * lead));
+                }
+                break;
+            }
+            case INPUT_MESSAGE:
+                push_message(sys, event.text);
+                break;
+            case INPUT_SAVE:
+                push_message(sys, world_save_async(sys, SAVE_PATH) ? "saving" : "still saving");
+                break;
+            case INPUT_LOAD:
+                push_message(sys, world_load(sys, SAVE_PATH) ? "world loaded" : "could not load " SAVE_PATH);
+                // every creature is new, the player might not even exist anymore
+                if (sys->player_index < 0)
+                    return;
+
+                player_index = sys->player_index;
+                player = sys->world.creatures->data[player_index];
+                break;
+        }
+    }
+
+    if (!fired && input->reload)
+    {
+        reload_item(sys, player);
+    }
+
+    // Rotacionar movimento de acordo com a direção da câmera
+    Vector3 move = input->move;
+    Vector3 rotatedMove = 
+    {
+        move.x * cosf(player->rotation.x) - move.z * sinf(player->rotation.x),
+        0.0f,
+        move.x * sinf(player->rotation.x) + move.z * cosf(player->rotation.x)
+    };
+
+    move_creature(sys, player_index, rotatedMove);
+
+    // add 1.72 to the position to get the eye level
+    sys->camera.position = Vector3Add(player->position, (Vector3){0.0f, 1.72f, 0.0f});
+}
+
+SnapshotBuffer* snapshot_buffer_init(void)
+{
+    SnapshotBuffer* buffer = (SnapshotBuffer*)malloc(sizeof(SnapshotBuffer));
+    memset(buffer, 0, sizeof(SnapshotBuffer));
+    for (int i = 0; i < 3; i++)
+    {
+        buffer->slots[i].creatures = list_init(CreatureViewList);
+        buffer->slots[i].bullets = list_init(Vector3List);
+        buffer->slots[i].player_index = -1;
+        buffer->slots[i].tick = -1;
+        buffer->slots[i].input_sequence = -1;
+    }
+    buffer->write = 0;
+    atomic_init(&buffer->ready, 1);
+    buffer->read = 2;
+    return buffer;
+}
+
+void snapshot_buffer_free(SnapshotBuffer* buffer)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        list_free(*buffer->slots[i].creatures);
+        list_free(*buffer->slots[i].bullets);
+    }
+    free(buffer);
+}
+
+// copies what the renderer needs into the write slot and hands it over, the slot lists only grow so this does not allocate once warm
+void publish_snapshot(InternalSystem* sys, SnapshotBuffer* buffer, PlayerInput* input)
+{
+    profile_zone("publish");
+    Snapshot* snapshot = &buffer->slots[buffer->write];
+    snapshot->tick++;
+    snapshot->camera = sys->camera;
+    snapshot->player_index = sys->player_index;
+    snapshot->input_sequence = input->sequence;
+    snapshot->input_time = input->time;
+    snapshot->look_x = input->look_x;
+    snapshot->look_y = input->look_y;
+
+    snapshot->map_model = sys->current_map < sys->maps->size ? sys->maps->data[sys->current_map].model_id : -1;
+    if (sys->player_index >= 0)
+    {
+        Creature* player = sys->world.creatures->data[sys->player_index];
+        snapshot->player_position = player->position;
+        snapshot->player_rotation = player->rotation;
+        snapshot->player_slot = player->current_item;
+        snapshot->player_item = small_list_get(player->inventory, player->current_item);
+    }
+
+    snapshot->creatures->size = 0;
+    list_reserve(*snapshot->creatures, sys->world.creatures->size);
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        snapshot->creatures->data[i] = (CreatureView){creature(i).position, creature(i).rotation, creature(i).id};
+    }
+    snapshot->creatures->size = sys->world.creatures->size;
+
+    snapshot->bullets->size = 0;
+    list_reserve(*snapshot->bullets, sys->world.bullets->size);
+    for (Int i = 0; i < sys->world.bullets->size; i++)
+    {
+        snapshot->bullets->data[i] = bullet(i).position;
+    }
+    snapshot->bullets->size = sys->world.bullets->size;
+
+    snapshot->message_count = sys->messages->size;
+    for (Int i = 0; i < sys->messages->size; i++)
+    {
+        snprintf(snapshot->messages[i], MAX_MESSAGE_LENGTH, "%s", deque_get(*sys->messages, i).text);
+    }
+
+    snapshot->frame_bytes = sys->frame_bytes;
+    snapshot->frame_bytes_peak = sys->frame_bytes_peak;
+    snapshot->creatures_live = sys->world.creature_slab->live;
+    snapshot->creatures_peak = sys->world.creature_slab->peak;
+    snapshot->bullets_live = sys->world.bullet_slab->live;
+    snapshot->bullets_peak = sys->world.bullet_slab->peak;
+    snapshot->items_live = sys->world.item_slab->live;
+    snapshot->items_peak = sys->world.item_slab->peak;
+
+    // the tick counter carries over to whichever slot we get back
+    Int tick = snapshot->tick;
+    buffer->write = atomic_exchange(&buffer->ready, buffer->write | SNAPSHOT_FRESH) & ~SNAPSHOT_FRESH;
+    buffer->slots[buffer->write].tick = tick;
+}
+
+// newest published snapshot, the same one again if nothing new was published since the last call
+Snapshot* acquire_snapshot(SnapshotBuffer* buffer)
+{
+    if (atomic_load(&buffer->ready) & SNAPSHOT_FRESH)
+    {
+        buffer->read = atomic_exchange(&buffer->ready, buffer->read) & ~SNAPSHOT_FRESH;
+    }
+    return &buffer->slots[buffer->read];
+}
+
+init(world)
+{
+    register_builtin(vm, "new.creature", brl_new_creature);
+    register_builtin(vm, "kill.creature", brl_kill_creature);
+    register_builtin(vm, "new.item", brl_new_item);
+    register_builtin(vm, "remove.item", brl_remove_item);
+    register_builtin(vm, "push.message", brl_push_message);
+    register_builtin(vm, "reserve.world", brl_reserve_world);
+}
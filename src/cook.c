@@ -0,0 +1,49 @@
+// asset cooking, run by the Makefile on the data copied next to the game:
+// writes the lod chain of every obj given, name.lod1.obj to name.lod<MODEL_LOD_LEVELS - 1>.obj next to it;
+// ./cook [--levels N] file.obj...
+#include "lod.h"
+
+int main(int argc, char **argv)
+{
+    Int levels = MODEL_LOD_LEVELS;
+    int failed = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--levels") == 0 && i + 1 < argc)
+        {
+            levels = atol(argv[++i]);
+            if (levels < 1 || levels > MODEL_LOD_LEVELS)
+            {
+                printf("--levels goes from 1 to %d\n", MODEL_LOD_LEVELS);
+                return 1;
+            }
+            continue;
+        }
+
+        LodObj* obj = lod_obj_load(argv[i]);
+        if (obj == NULL)
+        {
+            printf("%s: can't read it\n", argv[i]);
+            failed = 1;
+            continue;
+        }
+
+        lod_build_chain(obj, levels);
+        printf("%s: %ld", argv[i], (long)lod_triangles(obj, 0));
+        for (Int l = 1; l < levels; l++)
+        {
+            char path[1024];
+            lod_path(argv[i], l, path, sizeof(path));
+            if (!lod_write(obj, l, path))
+            {
+                printf("\n%s: can't write it\n", path);
+                failed = 1;
+                break;
+            }
+            printf(" -> %ld", (long)lod_triangles(obj, l));
+        }
+        printf(" triangles\n");
+        lod_obj_free(obj);
+    }
+    return failed;
+}
@@ -0,0 +1,761 @@
+#include "lod.h"
+
+// lod_pixels[l]: level l is picked below this size on screen, level 0 has no limit
+static const float lod_pixels[MODEL_LOD_LEVELS] = {INFINITY, 160.0f, 80.0f, 40.0f};
+
+// obj loading, only what the faces need: positions, and how many uvs and normals came before (negative indexes)
+
+static bool lod_line_is(const char* line, const char* tag)
+{
+    Int n = strlen(tag);
+    return strncmp(line, tag, n) == 0 && (line[n] == ' ' || line[n] == '\t');
+}
+
+// 1 based, negative counts back from the end, 0 (missing) is -1
+static int lod_index(long index, Int count)
+{
+    if (index > 0)
+        return index - 1;
+    if (index < 0)
+        return count + index;
+    return -1;
+}
+
+static const char* lod_parse_corner(const char* p, Int counts[3], LodCorner* corner)
+{
+    char* end;
+    corner->v = lod_index(strtol(p, &end, 10), counts[0]);
+    corner->vt = -1;
+    corner->vn = -1;
+    p = end;
+    if (*p == '/')
+    {
+        p++;
+        if (*p != '/')
+        {
+            corner->vt = lod_index(strtol(p, &end, 10), counts[1]);
+            p = end;
+        }
+        if (*p == '/')
+        {
+            corner->vn = lod_index(strtol(p + 1, &end, 10), counts[2]);
+            p = end;
+        }
+    }
+    return p;
+}
+
+// polygons are split into a fan
+static void lod_parse_face(const char* p, const char* line_end, Int counts[3], LodFaceList* faces)
+{
+    LodCorner corners[3];
+    Int n = 0;
+    while (p < line_end)
+    {
+        while (p < line_end && (*p == ' ' || *p == '\t'))
+            p++;
+        if (p >= line_end || *p == '\r')
+            break;
+
+        LodCorner corner;
+        const char* next = lod_parse_corner(p, counts, &corner);
+        if (next == p || corner.v < 0 || corner.v >= counts[0])
+            break;
+        p = next;
+
+        if (n < 3)
+            corners[n] = corner;
+        else
+        {
+            corners[1] = corners[2];
+            corners[2] = corner;
+        }
+        if (++n >= 3)
+            list_push(*faces, ((LodFace){{corners[0], corners[1], corners[2]}}));
+    }
+}
+
+LodObj* lod_obj_load(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    Int length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    LodObj* obj = (LodObj*)malloc(sizeof(LodObj));
+    obj->source = (char*)malloc(length + 1);
+    obj->source_length = fread(obj->source, 1, length, file);
+    obj->source[obj->source_length] = '\0';
+    fclose(file);
+
+    obj->positions = list_init(Vector3List);
+    obj->runs = list_init(LodRunList);
+    obj->levels = 1;
+
+    Int counts[3] = {0, 0, 0}; // v vt vn
+    Int text_start = 0;
+    LodRun* run = NULL; // open while the lines are faces
+    const char* source = obj->source;
+    for (Int start = 0; start < obj->source_length;)
+    {
+        const char* line = source + start;
+        const char* line_end = strchr(line, '\n');
+        if (line_end == NULL)
+            line_end = source + obj->source_length;
+        Int next = line_end - source + (*line_end == '\n');
+
+        if (lod_line_is(line, "f"))
+        {
+            if (run == NULL)
+            {
+                LodRun new_run = {.text_start = text_start, .text_length = start - text_start};
+                for (Int l = 0; l < MODEL_LOD_LEVELS; l++)
+                    new_run.levels[l] = list_init(LodFaceList);
+                list_push(*obj->runs, new_run);
+                run = &obj->runs->data[obj->runs->size - 1];
+            }
+            lod_parse_face(line + 2, line_end, counts, run->levels[0]);
+        }
+        else
+        {
+            if (run != NULL)
+            {
+                run = NULL;
+                text_start = start;
+            }
+            if (lod_line_is(line, "v"))
+            {
+                Vector3 v = {0};
+                sscanf(line + 2, "%f %f %f", &v.x, &v.y, &v.z);
+                list_push(*obj->positions, v);
+                counts[0]++;
+            }
+            else if (lod_line_is(line, "vt"))
+                counts[1]++;
+            else if (lod_line_is(line, "vn"))
+                counts[2]++;
+        }
+        start = next;
+    }
+    obj->tail_start = run != NULL ? obj->source_length : text_start;
+    return obj;
+}
+
+void lod_obj_free(LodObj* obj)
+{
+    for (Int r = 0; r < obj->runs->size; r++)
+        for (Int l = 0; l < MODEL_LOD_LEVELS; l++)
+            list_free(*obj->runs->data[r].levels[l]);
+    list_free(*obj->runs);
+    list_free(*obj->positions);
+    free(obj->source);
+    free(obj);
+}
+
+// simplification
+
+// symmetric 4x4 error quadric, a2 ab ac ad b2 bc bd c2 cd d2
+typedef struct
+{
+    double q[10];
+} LodQuadric;
+
+static void lod_quadric_add_plane(LodQuadric* quadric, double a, double b, double c, double d, double weight)
+{
+    double* q = quadric->q;
+    q[0] += weight * a * a; q[1] += weight * a * b; q[2] += weight * a * c; q[3] += weight * a * d;
+    q[4] += weight * b * b; q[5] += weight * b * c; q[6] += weight * b * d;
+    q[7] += weight * c * c; q[8] += weight * c * d;
+    q[9] += weight * d * d;
+}
+
+static double lod_quadric_error(const LodQuadric* a, const LodQuadric* b, Vector3 p)
+{
+    double q[10];
+    for (int i = 0; i < 10; i++)
+        q[i] = a->q[i] + b->q[i];
+    double x = p.x, y = p.y, z = p.z;
+    return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+        + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+        + q[7] * z * z + 2 * q[8] * z
+        + q[9];
+}
+
+// a manifold vertex can move onto any neighbour, a border one only along an edge with one face, a junction one
+// (on an edge with more than two faces: double sided sheets, fins) only along an edge with more than two faces,
+// so borders and junctions keep their shape and the surfaces that meet there stay glued together
+enum
+{
+    LOD_VERTEX_MANIFOLD,
+    LOD_VERTEX_BORDER,
+    LOD_VERTEX_JUNCTION
+};
+
+// moving vertex from onto vertex to
+typedef struct
+{
+    double cost;
+    int from, to;
+    unsigned int from_stamp, to_stamp; // the collapse is stale once either vertex changed
+} LodCollapse;
+typedef List(LodCollapse) LodCollapseList;
+
+typedef struct
+{
+    int a, b; // a < b
+    int face;
+} LodEdge;
+typedef List(LodEdge) LodEdgeList;
+
+typedef struct
+{
+    Vector3List *positions; // of the obj
+    int *local; // per obj position, its vertex in the run being simplified, -1 when unused
+    IntList *global; // per vertex, its obj position
+    LodQuadric *quadrics;
+    unsigned int *stamps;
+    bool *removed;
+    char *kinds; // LOD_VERTEX_*
+    IntList **vertex_faces; // faces using each vertex, dead ones are dropped lazily
+    Int vertex_capacity;
+    LodFaceList *faces; // corners hold vertexes in v, not obj positions
+    bool *dead;
+    Int face_capacity;
+    LodEdgeList *edges;
+    LodCollapseList *heap;
+} LodSimplifier;
+
+static void lod_heap_push(LodCollapseList* heap, LodCollapse collapse)
+{
+    list_push(*heap, collapse);
+    Int i = heap->size - 1;
+    while (i > 0 && heap->data[(i - 1) / 2].cost > heap->data[i].cost)
+    {
+        list_swap(*heap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static LodCollapse lod_heap_pop(LodCollapseList* heap)
+{
+    LodCollapse top = heap->data[0];
+    heap->data[0] = heap->data[--heap->size];
+    Int i = 0;
+    while (true)
+    {
+        Int left = 2 * i + 1, right = 2 * i + 2, smallest = i;
+        if (left < heap->size && heap->data[left].cost < heap->data[smallest].cost)
+            smallest = left;
+        if (right < heap->size && heap->data[right].cost < heap->data[smallest].cost)
+            smallest = right;
+        if (smallest == i)
+            break;
+        list_swap(*heap, i, smallest);
+        i = smallest;
+    }
+    return top;
+}
+
+static Vector3 lod_position(LodSimplifier* s, int vertex)
+{
+    return s->positions->data[s->global->data[vertex]];
+}
+
+static void lod_push_collapse(LodSimplifier* s, int from, int to)
+{
+    double cost = lod_quadric_error(&s->quadrics[from], &s->quadrics[to], lod_position(s, to));
+    lod_heap_push(s->heap, (LodCollapse){cost, from, to, s->stamps[from], s->stamps[to]});
+}
+
+static Vector3 lod_face_normal(Vector3 a, Vector3 b, Vector3 c)
+{
+    return Vector3CrossProduct(Vector3Subtract(b, a), Vector3Subtract(c, a));
+}
+
+static int lod_edge_compare(const void* a, const void* b)
+{
+    const LodEdge* x = (const LodEdge*)a;
+    const LodEdge* y = (const LodEdge*)b;
+    if (x->a != y->a)
+        return x->a < y->a ? -1 : 1;
+    if (x->b != y->b)
+        return x->b < y->b ? -1 : 1;
+    return 0;
+}
+
+// maps the run onto its own vertexes, leaving out degenerate faces, and sums the quadrics: the plane of each face, weighted by area,
+// and for every edge used by one face only, a plane through it standing on that face
+static void lod_setup(LodSimplifier* s, LodFaceList* source)
+{
+    s->global->size = 0;
+    s->faces->size = 0;
+    s->edges->size = 0;
+    s->heap->size = 0;
+
+    for (Int f = 0; f < source->size; f++)
+    {
+        LodFace face = source->data[f];
+        // a corner repeated draws nothing, and exporters leave plenty of those
+        if (face.corner[0].v == face.corner[1].v || face.corner[1].v == face.corner[2].v || face.corner[2].v == face.corner[0].v)
+            continue;
+        for (int k = 0; k < 3; k++)
+        {
+            int position = face.corner[k].v;
+            if (s->local[position] < 0)
+            {
+                s->local[position] = s->global->size;
+                list_push(*s->global, position);
+            }
+            face.corner[k].v = s->local[position];
+        }
+        list_push(*s->faces, face);
+    }
+
+    Int vertexes = s->global->size;
+    if (vertexes > s->vertex_capacity)
+    {
+        s->quadrics = (LodQuadric*)realloc(s->quadrics, vertexes * sizeof(LodQuadric));
+        s->stamps = (unsigned int*)realloc(s->stamps, vertexes * sizeof(unsigned int));
+        s->removed = (bool*)realloc(s->removed, vertexes * sizeof(bool));
+        s->kinds = (char*)realloc(s->kinds, vertexes * sizeof(char));
+        s->vertex_faces = (IntList**)realloc(s->vertex_faces, vertexes * sizeof(IntList*));
+        for (Int v = s->vertex_capacity; v < vertexes; v++)
+            s->vertex_faces[v] = list_init(IntList);
+        s->vertex_capacity = vertexes;
+    }
+    if (s->faces->size > s->face_capacity)
+    {
+        s->face_capacity = s->faces->size;
+        s->dead = (bool*)realloc(s->dead, s->face_capacity * sizeof(bool));
+    }
+    memset(s->quadrics, 0, vertexes * sizeof(LodQuadric));
+    memset(s->stamps, 0, vertexes * sizeof(unsigned int));
+    memset(s->removed, 0, vertexes * sizeof(bool));
+    memset(s->kinds, LOD_VERTEX_MANIFOLD, vertexes * sizeof(char));
+    memset(s->dead, 0, s->faces->size * sizeof(bool));
+    for (Int v = 0; v < vertexes; v++)
+        s->vertex_faces[v]->size = 0;
+
+    for (Int f = 0; f < s->faces->size; f++)
+    {
+        LodFace* face = &s->faces->data[f];
+        Vector3 p[3];
+        for (int k = 0; k < 3; k++)
+        {
+            p[k] = lod_position(s, face->corner[k].v);
+            list_push(*s->vertex_faces[face->corner[k].v], f);
+            int a = face->corner[k].v, b = face->corner[(k + 1) % 3].v;
+            list_push(*s->edges, ((LodEdge){a < b ? a : b, a < b ? b : a, f}));
+        }
+
+        Vector3 normal = lod_face_normal(p[0], p[1], p[2]);
+        float length = Vector3Length(normal);
+        if (length <= 0)
+            continue;
+        normal = Vector3Scale(normal, 1.0f / length);
+        for (int k = 0; k < 3; k++)
+            lod_quadric_add_plane(&s->quadrics[face->corner[k].v], normal.x, normal.y, normal.z, -Vector3DotProduct(normal, p[0]), length * 0.5);
+    }
+
+    qsort(s->edges->data, s->edges->size, sizeof(LodEdge), lod_edge_compare);
+    for (Int e = 0; e < s->edges->size;)
+    {
+        Int end = e + 1;
+        while (end < s->edges->size && s->edges->data[end].a == s->edges->data[e].a && s->edges->data[end].b == s->edges->data[e].b)
+            end++;
+
+        LodEdge edge = s->edges->data[e];
+        if (end - e != 2)
+        {
+            char kind = end - e == 1 ? LOD_VERTEX_BORDER : LOD_VERTEX_JUNCTION;
+            if (s->kinds[edge.a] < kind)
+                s->kinds[edge.a] = kind;
+            if (s->kinds[edge.b] < kind)
+                s->kinds[edge.b] = kind;
+
+            // a plane through the edge standing on each face, moving off the edge costs
+            Vector3 a = lod_position(s, edge.a), b = lod_position(s, edge.b);
+            double weight = LOD_BOUNDARY_WEIGHT * Vector3LengthSqr(Vector3Subtract(b, a));
+            for (Int i = e; i < end; i++)
+            {
+                LodFace* face = &s->faces->data[s->edges->data[i].face];
+                Vector3 face_normal = lod_face_normal(lod_position(s, face->corner[0].v), lod_position(s, face->corner[1].v), lod_position(s, face->corner[2].v));
+                Vector3 normal = Vector3Normalize(Vector3CrossProduct(Vector3Subtract(b, a), face_normal));
+                lod_quadric_add_plane(&s->quadrics[edge.a], normal.x, normal.y, normal.z, -Vector3DotProduct(normal, a), weight);
+                lod_quadric_add_plane(&s->quadrics[edge.b], normal.x, normal.y, normal.z, -Vector3DotProduct(normal, a), weight);
+            }
+        }
+        e = end;
+    }
+
+    for (Int e = 0; e < s->edges->size; e++)
+    {
+        LodEdge edge = s->edges->data[e];
+        if (e > 0 && edge.a == s->edges->data[e - 1].a && edge.b == s->edges->data[e - 1].b)
+            continue;
+        lod_push_collapse(s, edge.a, edge.b);
+        lod_push_collapse(s, edge.b, edge.a);
+    }
+}
+
+static bool lod_face_has(LodFace* face, int vertex)
+{
+    return face->corner[0].v == vertex || face->corner[1].v == vertex || face->corner[2].v == vertex;
+}
+
+// from has to be free to move that way (see LOD_VERTEX_*), and no remaining face of from may turn over or collapse into a line
+static bool lod_collapse_allowed(LodSimplifier* s, int from, int to)
+{
+    Vector3 target = lod_position(s, to);
+    IntList* faces = s->vertex_faces[from];
+    Int shared = 0;
+    for (Int i = 0; i < faces->size; i++)
+    {
+        LodFace* face = &s->faces->data[faces->data[i]];
+        if (s->dead[faces->data[i]])
+            continue;
+        if (lod_face_has(face, to))
+        {
+            shared++;
+            continue;
+        }
+
+        Vector3 p[3], moved[3];
+        for (int k = 0; k < 3; k++)
+        {
+            p[k] = lod_position(s, face->corner[k].v);
+            moved[k] = face->corner[k].v == from ? target : p[k];
+        }
+        Vector3 before = lod_face_normal(p[0], p[1], p[2]);
+        Vector3 after = lod_face_normal(moved[0], moved[1], moved[2]);
+        float before_length = Vector3Length(before), after_length = Vector3Length(after);
+        if (after_length <= 1e-12f)
+            return false;
+        if (before_length > 0 && Vector3DotProduct(before, after) < LOD_MIN_NORMAL_DOT * before_length * after_length)
+            return false;
+    }
+    if (s->kinds[from] == LOD_VERTEX_BORDER)
+        return shared == 1;
+    if (s->kinds[from] == LOD_VERTEX_JUNCTION)
+        return shared > 2;
+    return true;
+}
+
+static LodCorner* lod_corner_of(LodFace* face, int vertex)
+{
+    for (int k = 0; k < 3; k++)
+        if (face->corner[k].v == vertex)
+            return &face->corner[k];
+    return NULL;
+}
+
+// returns the faces removed
+static Int lod_collapse(LodSimplifier* s, int from, int to)
+{
+    IntList* faces = s->vertex_faces[from];
+    Int removed = 0;
+    LodCorner from_corners[2], to_corners[2]; // of the faces removed, to carry the uvs and normals of to across
+    for (Int i = 0; i < faces->size; i++)
+    {
+        Int f = faces->data[i];
+        LodFace* face = &s->faces->data[f];
+        if (s->dead[f] || !lod_face_has(face, to))
+            continue;
+        if (removed < 2)
+        {
+            from_corners[removed] = *lod_corner_of(face, from);
+            to_corners[removed] = *lod_corner_of(face, to);
+        }
+        s->dead[f] = true;
+        removed++;
+    }
+
+    for (Int i = 0; i < faces->size; i++)
+    {
+        Int f = faces->data[i];
+        if (s->dead[f])
+            continue;
+        LodCorner* corner = lod_corner_of(&s->faces->data[f], from);
+        // a corner that shared its attributes with from in a removed face gets the ones to had there,
+        // otherwise it is across a uv seam and keeps its own
+        LodCorner moved = {to, corner->vt, corner->vn};
+        for (Int r = 0; r < removed && r < 2; r++)
+        {
+            if (from_corners[r].vt == corner->vt && from_corners[r].vn == corner->vn)
+            {
+                moved.vt = to_corners[r].vt;
+                moved.vn = to_corners[r].vn;
+                break;
+            }
+        }
+        *corner = moved;
+        list_push(*s->vertex_faces[to], f);
+    }
+    faces->size = 0;
+
+    for (int i = 0; i < 10; i++)
+        s->quadrics[to].q[i] += s->quadrics[from].q[i];
+    s->removed[from] = true;
+    s->stamps[to]++;
+
+    // drop the dead faces of to and queue its edges again with the new quadric
+    IntList* to_faces = s->vertex_faces[to];
+    Int kept = 0;
+    for (Int i = 0; i < to_faces->size; i++)
+    {
+        Int f = to_faces->data[i];
+        if (s->dead[f])
+            continue;
+        to_faces->data[kept++] = f;
+        LodFace* face = &s->faces->data[f];
+        for (int k = 0; k < 3; k++)
+        {
+            int other = face->corner[k].v;
+            if (other == to)
+                continue;
+            lod_push_collapse(s, other, to);
+            lod_push_collapse(s, to, other);
+        }
+    }
+    to_faces->size = kept;
+    return removed;
+}
+
+static void lod_emit(LodSimplifier* s, LodFaceList* out)
+{
+    out->size = 0;
+    for (Int f = 0; f < s->faces->size; f++)
+    {
+        if (s->dead[f])
+            continue;
+        LodFace face = s->faces->data[f];
+        for (int k = 0; k < 3; k++)
+            face.corner[k].v = s->global->data[face.corner[k].v];
+        list_push(*out, face);
+    }
+}
+
+// one pass per run, the faces are copied out each time the count gets down to the next level
+static void lod_simplify_run(LodSimplifier* s, LodRun* run, Int levels)
+{
+    LodFaceList* source = run->levels[0];
+    if (source->size < LOD_MIN_TRIANGLES)
+    {
+        for (Int l = 1; l < levels; l++)
+        {
+            run->levels[l]->size = 0;
+            list_push_n(*run->levels[l], source->data, source->size);
+        }
+        return;
+    }
+
+    lod_setup(s, source);
+    Int live = s->faces->size;
+    Int level = 1;
+    while (level < levels)
+    {
+        Int target = s->faces->size * powf(LOD_RATIO, level);
+        if (target < LOD_MIN_TRIANGLES)
+            target = LOD_MIN_TRIANGLES;
+
+        while (live > target && s->heap->size > 0)
+        {
+            LodCollapse collapse = lod_heap_pop(s->heap);
+            if (s->removed[collapse.from] || s->removed[collapse.to] || s->stamps[collapse.from] != collapse.from_stamp || s->stamps[collapse.to] != collapse.to_stamp)
+                continue;
+            if (!lod_collapse_allowed(s, collapse.from, collapse.to))
+                continue;
+            live -= lod_collapse(s, collapse.from, collapse.to);
+        }
+        // out of collapses, the rest of the levels stay at this count
+        lod_emit(s, run->levels[level]);
+        level++;
+    }
+
+    for (Int v = 0; v < s->global->size; v++)
+        s->local[s->global->data[v]] = -1;
+}
+
+void lod_build_chain(LodObj* obj, Int levels)
+{
+    if (levels > MODEL_LOD_LEVELS)
+        levels = MODEL_LOD_LEVELS;
+
+    LodSimplifier s = {0};
+    s.positions = obj->positions;
+    s.local = (int*)malloc(obj->positions->size * sizeof(int));
+    for (Int i = 0; i < obj->positions->size; i++)
+        s.local[i] = -1;
+    s.global = list_init(IntList);
+    s.faces = list_init(LodFaceList);
+    s.edges = list_init(LodEdgeList);
+    s.heap = list_init(LodCollapseList);
+
+    for (Int r = 0; r < obj->runs->size; r++)
+        lod_simplify_run(&s, &obj->runs->data[r], levels);
+    obj->levels = levels;
+
+    free(s.local);
+    for (Int v = 0; v < s.vertex_capacity; v++)
+        list_free(*s.vertex_faces[v]);
+    free(s.vertex_faces);
+    free(s.quadrics);
+    free(s.stamps);
+    free(s.removed);
+    free(s.kinds);
+    free(s.dead);
+    list_free(*s.global);
+    list_free(*s.faces);
+    list_free(*s.edges);
+    list_free(*s.heap);
+}
+
+Int lod_triangles(LodObj* obj, Int level)
+{
+    Int triangles = 0;
+    for (Int r = 0; r < obj->runs->size; r++)
+        triangles += obj->runs->data[r].levels[level]->size;
+    return triangles;
+}
+
+static void lod_write_corner(FILE* file, LodCorner corner)
+{
+    fprintf(file, " %d", corner.v + 1);
+    if (corner.vt < 0 && corner.vn < 0)
+        return;
+    fputc('/', file);
+    if (corner.vt >= 0)
+        fprintf(file, "%d", corner.vt + 1);
+    if (corner.vn >= 0)
+        fprintf(file, "/%d", corner.vn + 1);
+}
+
+// the source with the faces of each run replaced by the ones of the level, indexes are written 1 based
+bool lod_write(LodObj* obj, Int level, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    for (Int r = 0; r < obj->runs->size; r++)
+    {
+        LodRun* run = &obj->runs->data[r];
+        fwrite(obj->source + run->text_start, 1, run->text_length, file);
+        LodFaceList* faces = run->levels[level];
+        for (Int f = 0; f < faces->size; f++)
+        {
+            fputc('f', file);
+            for (int k = 0; k < 3; k++)
+                lod_write_corner(file, faces->data[f].corner[k]);
+            fputc('\n', file);
+        }
+    }
+    fwrite(obj->source + obj->tail_start, 1, obj->source_length - obj->tail_start, file);
+    return fclose(file) == 0;
+}
+
+// name.obj -> name.lod2.obj
+void lod_path(const char* path, Int level, char* buffer, Int size)
+{
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    if (dot == NULL || (slash != NULL && dot < slash))
+        dot = path + strlen(path);
+    snprintf(buffer, size, "%.*s.lod%ld%s", (int)(dot - path), path, (long)level, dot);
+}
+
+// picking
+
+// pixels of screen height per world unit at distance 1 from a perspective camera, once per frame
+float lod_screen_scale(Camera camera, float screen_height)
+{
+    return screen_height / (2 * tanf(camera.fovy * DEG2RAD / 2));
+}
+
+// pixels of screen height covered by a sphere
+float lod_screen_size(Vector3 eye, float scale, Vector3 center, float radius)
+{
+    float distance = Vector3Distance(eye, center);
+    if (distance <= radius)
+        return INFINITY;
+    return 2 * radius / distance * scale;
+}
+
+// below this many pixels level is picked, the impostor comes after the last level
+static float lod_threshold(const ModelLod* lod, int level)
+{
+    return level == lod->count ? LOD_IMPOSTOR_PIXELS : lod_pixels[level];
+}
+
+// current is the level picked last frame, -1 for none
+int lod_select(const ModelLod* lod, float pixels, int current)
+{
+    int levels = lod->count + (lod->impostor.id != 0);
+    if (current < 0 || current >= levels)
+    {
+        int level = 0;
+        while (level + 1 < levels && pixels < lod_threshold(lod, level + 1))
+            level++;
+        return level;
+    }
+
+    while (current + 1 < levels && pixels < lod_threshold(lod, current + 1) * (1 - LOD_HYSTERESIS))
+        current++;
+    while (current > 0 && pixels > lod_threshold(lod, current) * (1 + LOD_HYSTERESIS))
+        current--;
+    return current;
+}
+
+// impostors
+
+// view v looks at the model from direction (model space, y up), and is drawn in the atlas cell at cell (in cells,
+// from the bottom left, as gl addresses both the framebuffer and the texture)
+void lod_impostor_view(Int view, Vector3* direction, Vector2* cell)
+{
+    float angle = view * 2 * PI / LOD_IMPOSTOR_VIEWS;
+    *direction = (Vector3){sinf(angle), 0, cosf(angle)};
+    *cell = (Vector2){view % LOD_IMPOSTOR_GRID, view / LOD_IMPOSTOR_GRID};
+}
+
+// the two triangles of the impostor of a model at position, turned yaw degrees around y (like DrawModelEx does it),
+// seen from eye: 6 vertexes into vertices (xyz) and texcoords (uv), front facing
+void lod_impostor_quad(const ModelLod* lod, Vector3 eye, Vector3 position, float yaw, float* vertices, float* texcoords)
+{
+    Vector3 center = Vector3Add(position, lod->center);
+    float dx = eye.x - center.x, dz = eye.z - center.z;
+    float length = sqrtf(dx * dx + dz * dz);
+    // a view turns with the model, so the one to use is where the eye is in model space
+    float azimuth = atan2f(dx, dz) - yaw * DEG2RAD;
+    Int view = (Int)floorf(azimuth / (2 * PI) * LOD_IMPOSTOR_VIEWS + 0.5f) % LOD_IMPOSTOR_VIEWS;
+    if (view < 0)
+        view += LOD_IMPOSTOR_VIEWS;
+    Vector2 cell = {view % LOD_IMPOSTOR_GRID, view / LOD_IMPOSTOR_GRID};
+
+    // right of a camera looking from the eye at the model, the way the view was rendered
+    float rx = 1, rz = 0;
+    if (length > 1e-6f)
+    {
+        rx = dz / length;
+        rz = -dx / length;
+    }
+    float r = lod->radius;
+    float left = center.x - rx * r, right = center.x + rx * r;
+    float left_z = center.z - rz * r, right_z = center.z + rz * r;
+    float bottom = center.y - r, top = center.y + r;
+    float u0 = cell.x / LOD_IMPOSTOR_GRID, u1 = (cell.x + 1) / LOD_IMPOSTOR_GRID;
+    float v0 = cell.y / LOD_IMPOSTOR_GRID, v1 = (cell.y + 1) / LOD_IMPOSTOR_GRID;
+
+    // bottom left, bottom right, top right, bottom left, top right, top left; bit 0 is right, bit 1 top
+    static const int corners[6] = {0, 1, 3, 0, 3, 2};
+    for (int k = 0; k < 6; k++)
+    {
+        int corner = corners[k];
+        vertices[k * 3 + 0] = corner & 1 ? right : left;
+        vertices[k * 3 + 1] = corner & 2 ? top : bottom;
+        vertices[k * 3 + 2] = corner & 1 ? right_z : left_z;
+        texcoords[k * 2 + 0] = corner & 1 ? u1 : u0;
+        texcoords[k * 2 + 1] = corner & 2 ? v1 : v0;
+    }
+}
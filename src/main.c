@@ -1,175 +1,294 @@
-#include "raylib.h"
-#include "raymath.h"
-#include <math.h>
-#include "bruter.h"
+#include "brutopolis.h"
+#include "save.h"
+#include "lod.h"
+#include "rlgl.h"
 
-#define MAX_ENEMIES 10
-#define BULLET_SPEED 1.0f
+// frames per second of the window, the time left in a frame is spent polling input
+#define FRAME_RATE 60
 
-enum 
-{
-    ITEM_HAND,
-    ITEM_REVOLVER,
-    ITEM_BULLET_REVOLVER
-} items;
-
-const char* item_names[] = 
-{
-    "hand",
-    "revolver",
-    "revolver bullets"
-};
-
-const char* equip_image_paths[] = 
+// time from an input sample to the frame that shows it, measured right after the buffer swap
+typedef struct
 {
-    "data/img/equip_hand.png",
-    "data/img/equip_revolver.png",
-    "data/img/equip_bullet_revolver.png"
-};
+    double last_input; // sample time of the last measurement
+    double last_ms;
+    double avg_ms;
+    double window_max_ms;
+    double max_ms; // biggest last_ms in the last full window
+    Int samples;
+} LatencyStats;
 
-const char* item_image_paths[] = 
+void measure_latency(LatencyStats* latency, double input_time, double present_time)
 {
-    "data/img/item_hand.png",
-    "data/img/item_revolver.png",
-    "data/img/item_bullet_revolver.png"
-};
+    if (input_time <= latency->last_input)
+        return;
 
-const int item_capacities[] = 
-{
-    0,
-    6,
-    12
-};
+    latency->last_input = input_time;
+    latency->last_ms = (present_time - input_time) * 1000.0;
+    latency->avg_ms = latency->samples == 0 ? latency->last_ms : latency->avg_ms * 0.95 + latency->last_ms * 0.05;
+    if (latency->last_ms > latency->window_max_ms)
+        latency->window_max_ms = latency->last_ms;
 
-// CREATURE DEFINES
-#define CREATURE_IDLE 0
-#define CREATURE_RELOAD 1
-#define CREATURE_SHOOT 2
+    if (++latency->samples % PROFILER_WINDOW == 0)
+    {
+        latency->max_ms = latency->window_max_ms;
+        latency->window_max_ms = 0;
+    }
+}
 
-typedef struct 
+// what the window thread knows about the input it sampled
+typedef struct
 {
-    Vector3 position;
-    char type; 
-    Int capacity; // if storage
-    Int content_type;
-    Int content;
-} Item;
-typedef List(Item) ItemList;
-
-typedef struct 
+    Vector3 move;
+    bool reload;
+    double look_x, look_y; // sum of every look delta pushed, see PlayerInput
+    double look_time; // sample time of the newest look delta
+    LatencyStats look_latency; // newest look sample to present, the camera is turned by the renderer right before drawing
+    LatencyStats tick_latency; // newest event a tick applied to present, what shots, movement and the world see
+} InputSampler;
+
+// the simulation runs on its own thread at TICK_RATE, the main thread only polls input and draws the newest snapshot;
+// raylib (glfw) wants the window, the gl context and the event polling on the thread that created the window,
+// so it is the simulation that moves out, not the renderer;
+// with NO_THREADS (the web build) simulation_tick is called from the main loop instead
+typedef struct
 {
-    char* name;
-    Vector3 position;
-    Vector3 size;
-    Vector3 rotation;
-    Vector3 direction;
-    Color color;
-    Float speed;
-    ItemList *inventory; 
-    Int current_item;
-    Int status;
-} Creature;
-typedef List(Creature) CreatureList;
-
-typedef struct 
+    InternalSystem* sys;
+    SnapshotBuffer* snapshots;
+    InputQueue* input_queue; // filled by the main thread
+    PlayerInput input; // simulation only
+#ifndef NO_THREADS
+    pthread_t thread;
+#endif
+    atomic_bool running;
+} Simulation;
+
+// what the renderer reads besides the snapshots, copied out of the system before the simulation thread starts;
+// the models and textures are loaded by data.br on this thread (they need the gl context) and frozen after that
+typedef struct
 {
-    Vector3 position;
-    Vector3 direction;
-    Float speed;
-} Bullet;
-typedef List(Bullet) BulletList;
+    ModelLodList* model_lods;
+    TextureList* equip_textures;
+    Vector2 resolution;
+    float sensibility;
+} RenderAssets;
+
+// set once the simulation owns the world, the render assets can't change after that
+static bool assets_frozen = false;
 
-typedef struct 
+// messages belong to the simulation, they go through the input queue too
+void post_message(Simulation* sim, const char* text)
 {
-    CreatureList *creatures;
-    BulletList *bullets;
-    ItemList *items;
-} World;
+    input_push(sim->input_queue, (InputEvent){.type = INPUT_MESSAGE, .time = GetTime(), .text = text});
+}
 
-typedef struct 
+// reads what raylib collected on the last poll and queues what changed, with the time it was read
+void sample_input(Simulation* sim, InputSampler* sampler)
 {
-    Vector2 delta; // where applies
-    Vector2 position; // where applies
-    float sensibility;
-} Mouse;
+    double now = GetTime();
 
-typedef List(BoundingBox) BoundingBoxList;
+    if (IsKeyPressed(KEY_F3))
+    {
+        profiler_enable(!profiler.enabled);
+    }
 
+    if (IsKeyPressed(KEY_F4))
+    {
+        if (!profiler.recording)
+        {
+            profiler_start_recording();
+            post_message(sim, "recording trace");
+        }
+        else
+        {
+            post_message(sim, profiler_stop_recording("trace.json") ? "trace saved to trace.json" : "could not save trace.json");
+        }
+    }
 
+    // F5 saves the world in the background, F9 loads the last save
+    if (IsKeyPressed(KEY_F5))
+    {
+        input_push(sim->input_queue, (InputEvent){.type = INPUT_SAVE, .time = now});
+    }
 
-typedef List(Texture2D) TextureList;
-typedef List(Model) ModelList;
+    if (IsKeyPressed(KEY_F9))
+    {
+        input_push(sim->input_queue, (InputEvent){.type = INPUT_LOAD, .time = now});
+    }
 
-typedef struct
-{
-    Int model_id;
-    BoundingBoxList *hitboxes;
-    char* name;
-} Map;
+    Vector2 delta = GetMouseDelta();
+    if (delta.x != 0 || delta.y != 0)
+    {
+        if (input_push(sim->input_queue, (InputEvent){.type = INPUT_LOOK, .time = now, .value = {delta.x, delta.y, 0}}))
+        {
+            sampler->look_x += delta.x;
+            sampler->look_y += delta.y;
+            sampler->look_time = now;
+        }
+    }
 
-typedef List(Map) MapList;
+    // Movimento do jogador
+    Vector3 move = {0};
+    if (IsKeyDown(KEY_W)) move.x = 1;
+    if (IsKeyDown(KEY_S)) move.x = -1;
+    if (IsKeyDown(KEY_A)) move.z = -1;
+    if (IsKeyDown(KEY_D)) move.z = 1;
+    if (move.x != sampler->move.x || move.z != sampler->move.z)
+    {
+        sampler->move = move;
+        input_push(sim->input_queue, (InputEvent){.type = INPUT_MOVE, .time = now, .value = move});
+    }
+
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON))
+    {
+        input_push(sim->input_queue, (InputEvent){.type = INPUT_FIRE, .time = now});
+    }
 
+    bool reload = IsKeyDown(KEY_R);
+    if (reload != sampler->reload)
+    {
+        sampler->reload = reload;
+        input_push(sim->input_queue, (InputEvent){.type = INPUT_RELOAD, .time = now, .value = {reload, 0, 0}});
+    }
 
-typedef struct 
+    int wheel = GetMouseWheelMove();
+    if (wheel != 0)
+    {
+        input_push(sim->input_queue, (InputEvent){.type = INPUT_WHEEL, .time = now, .value = {wheel, 0, 0}});
+    }
+}
+
+// the snapshot camera turned by the look deltas the simulation has not applied yet
+Camera late_camera(RenderAssets* assets, Snapshot* snapshot, InputSampler* sampler)
 {
-    char* name;
-    Int player_index;
-    Vector2 resolution;
-    World world;
-    Camera camera;
-    Mouse mouse;
-    TextureList *equip_textures;
-    TextureList *item_textures;
-    ModelList *models;
-    MapList *maps;
-    Int current_map;
-} InternalSystem;
-
-// macro to acess &sys->world.creatures->data[name];
-#define creature(name) sys->world.creatures->data[name]
-
-InternalSystem* new_system(char* name, int size_x, int size_y)
+    Camera camera = snapshot->camera;
+    if (snapshot->player_index < 0)
+        return camera;
+
+    Vector2 pending = {sampler->look_x - snapshot->look_x, sampler->look_y - snapshot->look_y};
+    Vector3 rotation = apply_look(snapshot->player_rotation, pending, assets->sensibility);
+    camera.target = Vector3Add(camera.position, look_direction(rotation));
+    return camera;
+}
+
+void simulation_tick(Simulation* sim)
 {
-    InternalSystem* _sys = (InternalSystem*)malloc(sizeof(InternalSystem));
-    _sys->player_index = -1;
+    // zones left open on this thread by a profiler toggle are dropped
+    profiler_reset_thread();
+    profile_zone("tick");
+    InternalSystem* sys = sim->sys;
+    sys->time = GetTime();
 
-    _sys->resolution = (Vector2){size_x, size_y};
+    profile_begin("player");
+    apply_player_input(sys, sim->input_queue, &sim->input);
+    profile_end();
 
-    _sys->name = str_duplicate(name);
+    world_tick(sys);
+    autosave(sys);
 
-    _sys->world.creatures = list_init(CreatureList);
+    int save_status = world_save_status();
+    if (save_status == SAVE_DONE)
+        push_message(sys, "world saved to " SAVE_PATH);
+    else if (save_status == SAVE_FAILED)
+        push_message(sys, "could not save " SAVE_PATH);
 
-    _sys->world.bullets = list_init(BulletList);
+    expire_messages(sys);
+    publish_snapshot(sys, sim->snapshots, &sim->input);
+    reset_frame(sys);
+}
 
-    _sys->equip_textures = list_init(TextureList);
+#ifndef NO_THREADS
+void* simulation_main(void* arg)
+{
+    Simulation* sim = (Simulation*)arg;
+    // created here so this thread is worker 0 of the job system
+    sim->sys->jobs = jobs_init(0);
 
-    _sys->item_textures = list_init(TextureList);
+    double step = 1.0 / TICK_RATE;
+    double next = GetTime();
+    while (atomic_load(&sim->running))
+    {
+        double now = GetTime();
+        if (now < next)
+        {
+            struct timespec wait = {0, (long)((next - now) * 1e9)};
+            nanosleep(&wait, NULL);
+            continue;
+        }
 
-    _sys->models = list_init(ModelList);
+        simulation_tick(sim);
+        next += step;
 
-    _sys->maps = list_init(MapList);
+        // far behind (a debugger, a huge spike), skip the missed ticks instead of running a burst of them
+        if (GetTime() - next > step * 5)
+            next = GetTime();
+    }
 
-    _sys->current_map = 0;
+    jobs_free(sim->sys->jobs);
+    sim->sys->jobs = NULL;
+    return NULL;
+}
+#endif
 
-    // camera setup
-    _sys->camera.position = (Vector3){ 0.0f, 1.72f, 3.0f };
-    _sys->camera.target = (Vector3){ 0.0f, 1.72f, 0.0f };
-    _sys->camera.up = (Vector3){ 0.0f, 1.0f, 0.0f };
-    _sys->camera.fovy = 90.0f;
-    _sys->camera.projection = CAMERA_PERSPECTIVE;
+// ends the frame and drops everything allocated from the render arena during it
+void end_frame(Arena* arena)
+{
+    profile_begin("present");
+    EndDrawing();
+    profile_end();
+    arena_reset(arena);
+}
 
-    // mouse setup
-    _sys->mouse.delta = (Vector2) {0,0};
-    _sys->mouse.position = (Vector2) {0,0};
-    _sys->mouse.sensibility = 0.003f;
+// F3 toggles it, F4 starts/stops a trace capture
+void draw_profiler_overlay(Snapshot* snapshot, InputSampler* sampler, Arena* arena)
+{
+    int x = 10;
+    int y = 40;
+    DrawRectangle(x - 5, y - 5, 420, 22 + (profiler.stat_count + 6) * 16, Fade(BLACK, 0.6f));
+    DrawText(arena_format(arena, "%d fps %.2f ms%s", GetFPS(), GetFrameTime() * 1000.0f, profiler.recording ? "  [recording]" : ""), x, y, 10, GREEN);
+    y += 16;
+    DrawText("zone", x, y, 10, LIGHTGRAY);
+    DrawText("avg ms", x + 160, y, 10, LIGHTGRAY);
+    DrawText("max ms", x + 240, y, 10, LIGHTGRAY);
+    DrawText("calls", x + 320, y, 10, LIGHTGRAY);
+    y += 16;
+
+    for (int i = 0; i < profiler.stat_count; i++)
+    {
+        ProfileStat *stat = &profiler.stats[i];
+        DrawText(stat->name, x, y, 10, WHITE);
+        if (stat->is_counter)
+        {
+            DrawText(arena_format(arena, "%g", profiler_counter_value(i)), x + 160, y, 10, SKYBLUE);
+        }
+        else
+        {
+            DrawText(arena_format(arena, "%.3f", stat->avg_ms), x + 160, y, 10, WHITE);
+            DrawText(arena_format(arena, "%.3f", stat->max_ms), x + 240, y, 10, WHITE);
+            DrawText(arena_format(arena, "%ld", (long)stat->last_calls), x + 320, y, 10, WHITE);
+        }
+        y += 16;
+    }
 
-    return _sys;
+    Vector3 position = snapshot->player_position;
+    DrawText(arena_format(arena, "player position: %f %f %f", position.x, position.y, position.z), x, y, 10, LIGHTGRAY);
+    y += 16;
+    DrawText(arena_format(arena, "look to present: %.2f ms, avg %.2f, max %.2f", sampler->look_latency.last_ms, sampler->look_latency.avg_ms, sampler->look_latency.max_ms), x, y, 10, LIGHTGRAY);
+    y += 16;
+    DrawText(arena_format(arena, "tick input to present: %.2f ms, avg %.2f, max %.2f", sampler->tick_latency.last_ms, sampler->tick_latency.avg_ms, sampler->tick_latency.max_ms), x, y, 10, LIGHTGRAY);
+    y += 16;
+    DrawText(arena_format(arena, "tick %ld, frame arena: %ld bytes, peak %ld", (long)snapshot->tick, (long)snapshot->frame_bytes, (long)snapshot->frame_bytes_peak), x, y, 10, LIGHTGRAY);
+    y += 16;
+    DrawText(arena_format(arena, "creatures %ld/%ld bullets %ld/%ld items %ld/%ld (live/peak)",
+        (long)snapshot->creatures_live, (long)snapshot->creatures_peak,
+        (long)snapshot->bullets_live, (long)snapshot->bullets_peak,
+        (long)snapshot->items_live, (long)snapshot->items_peak), x, y, 10, LIGHTGRAY);
 }
 
 void system_startup(InternalSystem* _sys)
 {
     InitWindow(_sys->resolution.x, _sys->resolution.y, _sys->name);
-    SetTargetFPS(60);
+    // no frame limit here, the main loop paces the frames itself while polling input
+    SetTargetFPS(0);
     DisableCursor();
 }
 
@@ -181,65 +300,19 @@ function(brl_new_system)
     InternalSystem* _sys = new_system(name, size_x, size_y);
     Int sys_index = new_var(vm);
     data(sys_index).pointer = _sys;
+
+    // event scripts read these to know who triggered what
+    _sys->vm = vm;
+    _sys->event_creature = register_number(vm, "event.creature", -1);
+    _sys->event_trigger = register_number(vm, "event.trigger", -1);
     
     system_startup(_sys);
     return sys_index;
 }
 
-void free_system(InternalSystem* _sys)
-{
-    free(_sys->name);
-    list_free(*_sys->world.creatures);
-    list_free(*_sys->world.bullets);
-    free(_sys);
-}
-
-Int new_creature(InternalSystem* _sys, char* name, int x, int y, int z)
-{
-    Creature* creature = (Creature*)malloc(sizeof(Creature));
-    creature->position = (Vector3){ x, y, z };
-    creature->size = (Vector3){ 1.0f, 1.70f, 1.0f };
-    creature->current_item = 0;
-    creature->color = RED;
-    creature->speed = 0.1f;
-    creature->status = 0;
-    
-    creature->inventory = (ItemList*)malloc(sizeof(ItemList));
-
-    creature->name = str_duplicate(name);
-    creature->direction = (Vector3){0,0,0};
-    creature->rotation = (Vector3){0,0,0};
-
-    creature->inventory = list_init(ItemList);
-    
-    list_push(*_sys->world.creatures, *creature);
-    Int id = _sys->world.creatures->size - 1;
-    return id;
-}
-
-function(brl_new_creature)
-{
-    InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
-    char* name = arg(1).string;
-    int x = (int)arg(2).number;
-    int y = (int)arg(3).number;
-    int z = (int)arg(4).number;
-    Int creature_id = new_number(vm, new_creature(_sys, name, x, y, z));
-    return creature_id;
-}
-
-Bullet* new_bullet(InternalSystem* _sys, Vector3 position, Vector3 direction, Float speed)
-{
-    Bullet *bullet = (Bullet*)malloc(sizeof(Bullet));
-    bullet->position = position;
-    bullet->direction = direction;
-    bullet->speed = speed;
-    list_push(*_sys->world.bullets, *bullet);
-    return bullet;
-}
-
 void load_texture(InternalSystem* _sys, char* path, bool is_equip)
 {
+    profile_zone("load_texture");
     Image handimg = LoadImage(path);
     ImageResize(&handimg, 450, 300);
     //ImageRotate(&handimg, 25.0f);
@@ -256,131 +329,206 @@ function(brl_load_texture)
 {
     InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
     char* path = arg(1).string;
+    if (assets_frozen)
+    {
+        printf("load.texture %s: textures can only be loaded at startup\n", path);
+        return -1;
+    }
     load_texture(_sys, path, arg_i(2) != 0);
     return -1;
 }
 
+static Int model_triangles(Model model)
+{
+    Int triangles = 0;
+    for (int m = 0; m < model.meshCount; m++)
+        triangles += model.meshes[m].triangleCount;
+    return triangles;
+}
+
+// the lod chain is whatever the cook step left next to the model (see lod.h), a model without one has a single level
 Int load_model(InternalSystem* _sys, char* path)
 {
+    profile_zone("load_model");
     Model model = LoadModel(path);
     list_push(*_sys->models, model);
+
+    ModelLod lod = {0};
+    lod.levels[0] = model;
+    lod.triangles[0] = model_triangles(model);
+    lod.count = 1;
+    BoundingBox bounds = GetModelBoundingBox(model);
+    lod.center = Vector3Scale(Vector3Add(bounds.min, bounds.max), 0.5f);
+    lod.radius = Vector3Distance(bounds.min, bounds.max) * 0.5f;
+    for (; lod.count < MODEL_LOD_LEVELS; lod.count++)
+    {
+        char lod_file[1024];
+        lod_path(path, lod.count, lod_file, sizeof(lod_file));
+        if (!FileExists(lod_file))
+            break;
+        lod.levels[lod.count] = LoadModel(lod_file);
+        lod.triangles[lod.count] = model_triangles(lod.levels[lod.count]);
+    }
+    list_push(*_sys->model_lods, lod);
     return _sys->models->size - 1;
 }
 
-function(brl_load_model)
+// renders the views of the impostor atlas (lod.h), one orthographic camera per view fitted to the bounding sphere,
+// into its own cell of the render texture
+void bake_impostor(ModelLod* lod)
 {
-    InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
-    char* path = arg(1).string;
-    load_model(_sys, path);
-    return -1;
+    profile_zone("bake_impostor");
+    int size = LOD_IMPOSTOR_GRID * LOD_IMPOSTOR_CELL;
+    lod->impostor = LoadRenderTexture(size, size);
+    BeginTextureMode(lod->impostor);
+    ClearBackground(BLANK);
+    for (Int v = 0; v < LOD_IMPOSTOR_VIEWS; v++)
+    {
+        Vector3 direction;
+        Vector2 cell;
+        lod_impostor_view(v, &direction, &cell);
+        Camera camera = {0};
+        camera.target = lod->center;
+        camera.position = Vector3Add(lod->center, Vector3Scale(direction, lod->radius * 2));
+        camera.up = (Vector3){0, 1, 0};
+        camera.fovy = lod->radius * 2;
+        camera.projection = CAMERA_ORTHOGRAPHIC;
+
+        rlViewport(cell.x * LOD_IMPOSTOR_CELL, cell.y * LOD_IMPOSTOR_CELL, LOD_IMPOSTOR_CELL, LOD_IMPOSTOR_CELL);
+        BeginMode3D(camera);
+            DrawModel(lod->levels[0], (Vector3){0, 0, 0}, 1.0f, WHITE);
+        EndMode3D();
+    }
+    EndTextureMode();
+    // far away a view covers a few pixels, without mipmaps it sparkles
+    GenTextureMipmaps(&lod->impostor.texture);
+    SetTextureFilter(lod->impostor.texture, TEXTURE_FILTER_TRILINEAR);
 }
 
-Item* new_item(char* name, char type, int capacity, int content_type, int content)
+// the impostors of one frame: a quad per creature in a single dynamic mesh, drawn with one DrawMesh;
+// not indexed, raylib mesh indexes are 16 bit and 50k quads are way past that
+typedef struct
 {
-    Item* item = (Item*)malloc(sizeof(Item));
-    item->type = type;
-    item->capacity = capacity;
-    item->content_type = content_type;
-    item->content = content;
-    return item;
+    Mesh mesh; // vertexCount is the capacity, 6 per quad
+    Material material;
+    Int capacity; // quads
+    Int count; // this frame
+} ImpostorBatch;
+
+// the empty part of a view is cut out instead of blended, so impostors need no sorting
+#ifdef __EMSCRIPTEN__
+static const char* impostor_fragment_shader =
+    "#version 100\n"
+    "precision mediump float;\n"
+    "varying vec2 fragTexCoord;\n"
+    "varying vec4 fragColor;\n"
+    "uniform sampler2D texture0;\n"
+    "uniform vec4 colDiffuse;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 texel = texture2D(texture0, fragTexCoord);\n"
+    "    if (texel.a < 0.5) discard;\n"
+    "    gl_FragColor = texel * colDiffuse * fragColor;\n"
+    "}\n";
+#else
+static const char* impostor_fragment_shader =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "in vec4 fragColor;\n"
+    "uniform sampler2D texture0;\n"
+    "uniform vec4 colDiffuse;\n"
+    "out vec4 finalColor;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 texel = texture(texture0, fragTexCoord);\n"
+    "    if (texel.a < 0.5) discard;\n"
+    "    finalColor = texel * colDiffuse * fragColor;\n"
+    "}\n";
+#endif
+
+ImpostorBatch* impostor_batch_init(ModelLod* lod, Color tint)
+{
+    ImpostorBatch* batch = (ImpostorBatch*)malloc(sizeof(ImpostorBatch));
+    memset(batch, 0, sizeof(ImpostorBatch));
+    batch->material = LoadMaterialDefault();
+    batch->material.shader = LoadShaderFromMemory(NULL, impostor_fragment_shader);
+    batch->material.maps[MATERIAL_MAP_DIFFUSE].texture = lod->impostor.texture;
+    batch->material.maps[MATERIAL_MAP_DIFFUSE].color = tint;
+    return batch;
 }
 
-function(brl_new_item)
-{
-    char* name = arg(0).string;
-    char type = arg(1).number;
-    int capacity = (int)arg(2).number;
-    int content_type = (int)arg(3).number;
-    int content = (int)arg(4).number;
-    Item* item = new_item(name, type, capacity, content_type, content);
-    Int item_index = new_var(vm);
-    data(item_index).pointer = item;
-    return item_index;
+// room for quads impostors, the mesh is uploaded again when it grows
+void impostor_batch_reserve(ImpostorBatch* batch, Int quads)
+{
+    if (quads <= batch->capacity)
+        return;
+    if (batch->capacity > 0)
+        UnloadMesh(batch->mesh);
+
+    batch->capacity = quads > batch->capacity * 2 ? quads : batch->capacity * 2;
+    batch->mesh = (Mesh){0};
+    batch->mesh.vertexCount = batch->capacity * 6;
+    batch->mesh.triangleCount = batch->capacity * 2;
+    batch->mesh.vertices = (float*)MemAlloc(batch->mesh.vertexCount * 3 * sizeof(float));
+    batch->mesh.texcoords = (float*)MemAlloc(batch->mesh.vertexCount * 2 * sizeof(float));
+    UploadMesh(&batch->mesh, true);
 }
 
-void reload_item(InternalSystem* sys, Creature* creature)
+void impostor_batch_push(ImpostorBatch* batch, ModelLod* lod, Vector3 eye, Vector3 position, float yaw)
 {
-    switch (creature->inventory->data[creature->current_item].type)
-    {
-        case ITEM_REVOLVER:
-            if (creature->inventory->data[creature->current_item].content == creature->inventory->data[creature->current_item].capacity)
-                return;
-            
-            for (int i = 0; i < creature->inventory->size; i++)
-            {
-                if (creature->inventory->data[i].type == ITEM_BULLET_REVOLVER)
-                {
-                    int needed = creature->inventory->data[creature->current_item].capacity - creature->inventory->data[creature->current_item].content;
-                    if (creature->inventory->data[i].content >= needed)
-                    {
-                        creature->inventory->data[creature->current_item].content += needed;
-                        creature->inventory->data[i].content -= needed;
-                        if (creature->inventory->data[i].content == 0)
-                            list_fast_remove(*creature->inventory, i);// remove the empty item
-                        break;
-                    }
-                    else
-                    {
-                        creature->inventory->data[creature->current_item].content += creature->inventory->data[i].content;
-                        creature->inventory->data[i].content = 0;
-                        list_fast_remove(*creature->inventory, i);// remove the empty item
-                        i--;// we need to check the same index again
-                    }
-                }
-            }
-            break;
-        default:
-            // need a message system to show messages to the player
-            // "can't reload this item"
-            break;
-    }
+    Int first = batch->count * 6;
+    lod_impostor_quad(lod, eye, position, yaw, batch->mesh.vertices + first * 3, batch->mesh.texcoords + first * 2);
+    batch->count++;
 }
 
-void use_item(InternalSystem* sys, Creature* creature)
+// one draw call for every impostor of the frame
+void impostor_batch_draw(ImpostorBatch* batch)
+{
+    if (batch->count == 0)
+        return;
+    Mesh mesh = batch->mesh;
+    mesh.vertexCount = batch->count * 6;
+    mesh.triangleCount = batch->count * 2;
+    UpdateMeshBuffer(mesh, RL_DEFAULT_SHADER_ATTRIB_LOCATION_POSITION, mesh.vertices, mesh.vertexCount * 3 * sizeof(float), 0);
+    UpdateMeshBuffer(mesh, RL_DEFAULT_SHADER_ATTRIB_LOCATION_TEXCOORD, mesh.texcoords, mesh.vertexCount * 2 * sizeof(float), 0);
+    DrawMesh(mesh, batch->material, MatrixIdentity());
+    batch->count = 0;
+}
+
+function(brl_load_model)
 {
-    switch (creature->inventory->data[creature->current_item].type)
+    InternalSystem* _sys = (InternalSystem*)arg(0).pointer;
+    char* path = arg(1).string;
+    if (assets_frozen)
     {
-    case ITEM_HAND:
-        break;
-    case ITEM_REVOLVER:
-
-        if (creature->inventory->data[creature->current_item].content == 0)
-        {
-            // need a message system to show messages to the player
-            // "no bullets"
-            // try to reload
-            reload_item(sys,creature);
-            return;
-        }
-
-        creature->inventory->data[creature->current_item].content--;
-
-        Bullet bullet = {0};
-        bullet.position = (Vector3){creature->position.x, creature->position.y + 1.7f, creature->position.z};
-        bullet.direction = (Vector3){creature->direction.x, creature->direction.y, creature->direction.z};
-        bullet.speed = BULLET_SPEED;
-        list_push(*sys->world.bullets, bullet);
-        break;
-    case ITEM_BULLET_REVOLVER:
-        break;
-    default:
-        break;
+        printf("load.model %s: models can only be loaded at startup\n", path);
+        return -1;
     }
+    load_model(_sys, path);
+    return -1;
 }
 
-void new_map(InternalSystem* sys, char* name, int model_id)
+// loads the map model, mesh 0 is the map, all other meshes are hitboxes;
+// event.txt next to the model holds the map triggers
+Int load_map(InternalSystem* sys, char* name, char* model_path)
 {
-    Map map = {0};
-    map.name = str_duplicate(name);
-    map.model_id = model_id;
-    map.hitboxes = list_init(BoundingBoxList);
-    // mesh 0 is the map, all other meshes are hitboxes
+    profile_zone("load_map");
+    Int model_id = load_model(sys, model_path);
+    Int map_id = new_map(sys, name, model_id);
+    Map* map = &sys->maps->data[map_id];
+
+    list_reserve(*map->hitboxes, sys->models->data[model_id].meshCount - 1);
     for (int i = 1; i < sys->models->data[model_id].meshCount; i++)
     {
         BoundingBox box = GetMeshBoundingBox(sys->models->data[model_id].meshes[i]);
-        list_push(*map.hitboxes, box);
+        list_push(*map->hitboxes, box);
     }
-    list_push(*sys->maps, map);
+
+    char* slash = strrchr(model_path, '/');
+    char* event_path = slash == NULL ? str_duplicate("event.txt") : str_format("%.*s/event.txt", (int)(slash - model_path), model_path);
+    load_map_events(sys, map, event_path);
+    free(event_path);
+    return map_id;
 }
 
 function(brl_new_map)
@@ -388,23 +536,13 @@ function(brl_new_map)
     InternalSystem* sys = (InternalSystem*)arg(0).pointer;
     char* name = arg(1).string;
     char* model_path = arg(2).string;
-    Int model_id = load_model(sys, model_path);
-    new_map(sys, name, model_id);
-    return -1;
-}
-
-bool check_move_collision(InternalSystem* sys, Vector3 position, Vector3 move, float size)
-{
-    bool collision = false;
-    for (int i = 0; i < sys->maps->data[sys->current_map].hitboxes->size; i++)
+    if (assets_frozen)
     {
-        if (CheckCollisionBoxSphere(sys->maps->data[sys->current_map].hitboxes->data[i], Vector3Add(position, move), size) == 1)
-        {
-            collision = true;
-            break;
-        }
+        printf("new.map %s: maps can only be loaded at startup\n", name);
+        return -1;
     }
-    return collision;
+    load_map(sys, name, model_path);
+    return -1;
 }
 
 init(brutopolis)
@@ -413,8 +551,7 @@ init(brutopolis)
     register_builtin(vm, "load.texture", brl_load_texture);
     register_builtin(vm, "load.model", brl_load_model);
     register_builtin(vm, "new.map", brl_new_map);
-    register_builtin(vm, "new.creature", brl_new_creature);
-    register_builtin(vm, "new.item", brl_new_item);
+    init_world(vm);
 }
 
 int main(void)
@@ -424,200 +561,228 @@ int main(void)
     init_brutopolis(vm);
 
     char* datascript = readfile("data/data.br");
+    profile_begin("eval");
     eval(vm, datascript, NULL);
+    profile_end();
     free(datascript);
 
     InternalSystem* sys = (InternalSystem*)data(hash_find(vm, "game.system")).pointer;
 
-    /*Texture2D creaturetexture = LoadTexture("data/img/creature.png");
-
-    Rectangle source = { 0.0f, 0.0f, (float)creaturetexture.width, (float)creaturetexture.height };
-
-    // NOTE: Billboard locked on axis-Y
-    Vector3 billUp = { 0.0f, 1.0f, 0.0f };
-
-    // Set the height of the rotating billboard to 1.0 with the aspect ratio fixed
-    Vector2 size = { source.width/source.height, 1.0f };*/
+    // far creatures are drawn as impostors of model 0
+    bake_impostor(&sys->model_lods->data[0]);
+    ImpostorBatch* impostors = impostor_batch_init(&sys->model_lods->data[0], RED);
 
-    Int player_id = data(hash_find(vm, "player")).number;
-    Item* hand = new_item("hand", ITEM_HAND, 0, 0, 0);
-    Item* revolver = new_item("revolver", ITEM_REVOLVER, item_capacities[ITEM_REVOLVER], ITEM_BULLET_REVOLVER, 6);
-    Item* bullet_revolver = new_item("buller_revolver", ITEM_BULLET_REVOLVER, item_capacities[ITEM_BULLET_REVOLVER], 0, item_capacities[ITEM_BULLET_REVOLVER]);
-    sys->player_index = 0;
-
-    list_push(*creature(player_id).inventory, *hand);
-    list_push(*creature(player_id).inventory, *revolver);
-    list_push(*creature(player_id).inventory, *bullet_revolver);
+    // data.br keeps the id of the player's creature in player
+    set_player(sys, find_creature(sys, data(hash_find(vm, "player")).number, -1));
+    Item hand = make_item("hand", ITEM_HAND, 0, 0, 0);
+    Item revolver = make_item("revolver", ITEM_REVOLVER, item_capacities[ITEM_REVOLVER], ITEM_BULLET_REVOLVER, 6);
+    Item bullet_revolver = make_item("buller_revolver", ITEM_BULLET_REVOLVER, item_capacities[ITEM_BULLET_REVOLVER], 0, item_capacities[ITEM_BULLET_REVOLVER]);
+    if (sys->player_index >= 0)
+    {
+        inventory_add(&creature(sys->player_index), hand);
+        inventory_add(&creature(sys->player_index), revolver);
+        inventory_add(&creature(sys->player_index), bullet_revolver);
+    }
     
-    for (int i = 0;i < GetRandomValue(2,100);i++)
+    int creature_count = GetRandomValue(2,100);
+    list_reserve(*sys->world.creatures, sys->world.creatures->size + creature_count);
+    for (int i = 0;i < creature_count;i++)
     {
-        char* _name = TextFormat("joao%d", i);
+        const char* _name = TextFormat("joao%d", i);
         new_creature(sys, _name, GetRandomValue(-20,20), 15, GetRandomValue(-20,20));
         // lets set a random rotation
-        sys->world.creatures->data[sys->world.creatures->size-1].rotation = (Vector3){0,GetRandomValue(-180,180),0};
+        creature(sys->world.creatures->size-1).rotation = (Vector3){0,GetRandomValue(-180,180),0};
+        // the horde walks after the player
+        creature(sys->world.creatures->size-1).target_id = sys->player_id;
 
     }
 
 
+    // only a crash leaves an autosave behind, a clean exit removes it
+    if (world_recover(sys, AUTOSAVE_PATH))
+        push_message(sys, "recovered " AUTOSAVE_PATH);
+
+    sys->time = GetTime();
+    autosave_start(sys, AUTOSAVE_PATH);
+
+    Simulation* sim = (Simulation*)malloc(sizeof(Simulation));
+    memset(sim, 0, sizeof(Simulation));
+    sim->sys = sys;
+    sim->snapshots = snapshot_buffer_init();
+    sim->input_queue = input_queue_init();
+    init_player_input(&sim->input);
+    atomic_init(&sim->running, true);
+    RenderAssets assets = {sys->model_lods, sys->equip_textures, sys->resolution, sys->mouse.sensibility};
+    assets_frozen = true;
+#ifndef NO_THREADS
+    pthread_create(&sim->thread, NULL, simulation_main, sim);
+#else
+    sys->jobs = jobs_init(0);
+#endif
+
+    // from here on the world belongs to the simulation, this thread only reads snapshots and the assets
+    Arena* render_arena = arena_init(16 * 1024);
+    InputSampler sampler = {0};
+    // lod levels drawn last frame, lod_select needs them for its hysteresis
+    int map_level = -1;
+    LodPickList* creature_picks = list_init(LodPickList);
+    double next_frame = GetTime();
+
     while (!WindowShouldClose())
     {
-        // Atualização da câmera
-        // Rotação com mouse
-        sys->mouse.delta = GetMouseDelta();
-        creature(player_id).rotation.x += sys->mouse.delta.x * sys->mouse.sensibility;
-        creature(player_id).rotation.y -= sys->mouse.delta.y * sys->mouse.sensibility;
-
-        // Limitar rotação vertical
-        creature(player_id).rotation.y = Clamp(creature(player_id).rotation.y, -PI/2.5f, PI/2.5f);
+        profile_begin("frame");
+        profile_begin("poll input");
 
-        // Calcular direção da câmera
-        creature(player_id).direction = (Vector3)
-        {
-            cosf(creature(player_id).rotation.x) * cosf(creature(player_id).rotation.y),
-            sinf(creature(player_id).rotation.y),
-            sinf(creature(player_id).rotation.x) * cosf(creature(player_id).rotation.y)
-        };
-        creature(player_id).direction = Vector3Normalize(creature(player_id).direction);
-        sys->camera.target = Vector3Add(sys->camera.position, creature(player_id).direction);
-
-        // Movimento do jogador
-        Vector3 move = {0};
-        if (IsKeyDown(KEY_W)) move.x = 1;
-        if (IsKeyDown(KEY_S)) move.x = -1;
-        if (IsKeyDown(KEY_A)) move.z = -1;
-        if (IsKeyDown(KEY_D)) move.z = 1;
-        // mouse wheel to scroll through items
-        int mouse_wheel = GetMouseWheelMove();
-        if (mouse_wheel != 0)
+        // whatever the poll in EndDrawing got, then keep polling until the frame is due,
+        // so input is read every millisecond or so instead of once per frame
+        sample_input(sim, &sampler);
+        while (GetTime() < next_frame)
         {
-            creature(player_id).current_item += mouse_wheel;
-            creature(player_id).current_item = Clamp(creature(player_id).current_item, 0, creature(player_id).inventory->size - 1);
+            WaitTime(fmin(INPUT_POLL_INTERVAL, next_frame - GetTime()));
+            PollInputEvents();
+            sample_input(sim, &sampler);
         }
+        next_frame += 1.0 / FRAME_RATE;
+        // late by more than a frame, don't try to catch up
+        if (next_frame < GetTime())
+            next_frame = GetTime() + 1.0 / FRAME_RATE;
 
-        // Rotacionar movimento de acordo com a direção da câmera
-        Vector3 rotatedMove = 
-        {
-            move.x * cosf(creature(player_id).rotation.x) - move.z * sinf(creature(player_id).rotation.x),
-            0.0f,
-            move.x * sinf(creature(player_id).rotation.x) + move.z * cosf(creature(player_id).rotation.x)
-        };
-
-        if(check_move_collision(sys, creature(player_id).position, rotatedMove, 0.1) == 0)
-            creature(player_id).position = Vector3Add(creature(player_id).position, Vector3Scale(rotatedMove, creature(player_id).speed));
-
-        // add 1.72 to the position to get the eye level
-        sys->camera.position = Vector3Add(
-            creature(player_id).position,
-            (Vector3){0.0f, 1.72f, 0.0f} // 
-        );
-
-        // Atirar
-        if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) 
-        {
-            use_item(sys, &creature(player_id));
-        }
-        else if (IsKeyDown(KEY_R))
-        {
-            reload_item(sys, &creature(player_id));
-        }
+        profile_end();
 
-        // Atualizar balas
-        for (int i = 0; i < sys->world.bullets->size; i++)
-        {
-            sys->world.bullets->data[i].position = Vector3Add(sys->world.bullets->data[i].position, Vector3Scale(sys->world.bullets->data[i].direction, sys->world.bullets->data[i].speed));
-            
-            // Verificar colisão com inimigos
-            for (int j = 0; j < sys->world.creatures->size; j++) 
-            {
-                if (CheckCollisionBoxSphere(
-                (BoundingBox){(Vector3){sys->world.creatures->data[j].position.x - 0.4f, sys->world.creatures->data[j].position.y, sys->world.creatures->data[j].position.z - 0.5f},
-                            (Vector3){sys->world.creatures->data[j].position.x + 0.4f, sys->world.creatures->data[j].position.y + 1.93, sys->world.creatures->data[j].position.z + 0.5f}},
-                sys->world.bullets->data[i].position,
-                0.1f))
-                {
-                    // swap the current Creature with the last Creature, then pop the last Creature
-                    list_fast_remove(*sys->world.creatures, j);
-                    // we need to check the same index again, so we decrement j
-                    j--;
-
-                    // same for the bullet
-                    list_fast_remove(*sys->world.bullets, i);
-                    i--;
-                }
-            }
-            
-            // Desativar balas muito longe
-            if (Vector3Distance(sys->camera.position, sys->world.bullets->data[i].position) > 50) 
-            {
-                list_fast_remove(*sys->world.bullets, i);
-            }
-        }
+#ifdef NO_THREADS
+        simulation_tick(sim);
+#endif
 
-        // gravity
-        for (int i = 0; i < sys->world.creatures->size; i++)
-        {
-            bool collision = false;
-            int j = 0;
-            // check hitboxes
-            for (j = 0; j < sys->maps->data[sys->current_map].hitboxes->size; j++)
-            {
-                if (check_move_collision(sys, creature(i).position, (Vector3){0,-0.1,0}, 0.1))
-                {
+        Snapshot* snapshot = acquire_snapshot(sim->snapshots);
 
-                    collision = true;
-                    break;
-                }
-            }
+        profile_begin("draw");
+        BeginDrawing();
+            ClearBackground(BLACK);
 
-            if (!collision)
-            {
-                creature(i).position.y -= 0.1f;
-            }
-            else 
-            {
-                creature(i).position.y = sys->maps->data[sys->current_map].hitboxes->data[j].max.y + 0.2;
-            }
+        // nothing published yet
+        if (snapshot->tick < 0)
+        {
+            profile_end();
+            end_frame(render_arena);
+            profile_end();
+            profiler_frame();
+            continue;
         }
 
-        BeginDrawing();
-            ClearBackground(BLACK);
+            // turned as late as possible, with every look delta sampled until now
+            Camera camera = late_camera(&assets, snapshot, &sampler);
+            double look_time = sampler.look_time;
 
-            BeginMode3D(sys->camera);
+            BeginMode3D(camera);
                 //DrawModel(sys->models->data[1], (Vector3){0,0,0}, 1.0f, WHITE);
 
-                // draw map (mesh, material, Matrix)
-                DrawMesh(sys->models->data[sys->maps->data[sys->current_map].model_id].meshes[0], sys->models->data[sys->maps->data[sys->current_map].model_id].materials[0], MatrixIdentity());
+                // draw map (mesh, material, Matrix), mesh 0 of every level is the map
+                float lod_scale = lod_screen_scale(camera, assets.resolution.y);
+                Int triangles = 0;
+                if (snapshot->map_model >= 0)
+                {
+                    ModelLod* map_lod = &assets.model_lods->data[snapshot->map_model];
+                    map_level = lod_select(map_lod, lod_screen_size(camera.position, lod_scale, map_lod->center, map_lod->radius), map_level);
+                    DrawMesh(map_lod->levels[map_level].meshes[0], map_lod->levels[map_level].materials[0], MatrixIdentity());
+                    triangles += map_lod->levels[map_level].meshes[0].triangleCount;
+                }
 
-                for (int i = 0; i < sys->world.creatures->size; i++) 
+                // the level each creature got last frame, by snapshot index, only kept while the same creature is there
+                ModelLod* creature_lod = &assets.model_lods->data[0];
+                Int picked = creature_picks->size;
+                list_reserve(*creature_picks, snapshot->creatures->size);
+                impostor_batch_reserve(impostors, snapshot->creatures->size);
+                for (int i = 0; i < snapshot->creatures->size; i++) 
                 {
+                    CreatureView* view = &snapshot->creatures->data[i];
+                    LodPick* pick = &creature_picks->data[i];
+                    int current = i < picked && pick->id == view->id ? pick->level : -1;
+                    *pick = (LodPick){view->id, -1};
                     // size 1x1.7x1
-                    if (i != sys->player_index)// we reduce -0.2 in the y axis to compensate hitbox
-                        DrawModelEx(sys->models->data[0], (Vector3){sys->world.creatures->data[i].position.x, sys->world.creatures->data[i].position.y-0.2, sys->world.creatures->data[i].position.z}, (Vector3){0,1,0}, sys->world.creatures->data[i].rotation.y, (Vector3){1,1,1}, RED);
-                        //DrawBillboardPro(sys->camera, creaturetexture, source, (Vector3){sys->world.creatures->data[i].position.x, sys->world.creatures->data[i].position.y + 0.85f, sys->world.creatures->data[i].position.z}, billUp, (Vector2){1.0f, 1.7f}, (Vector2){0.5f, 0.5f}, 0, WHITE);
+                    if (i != snapshot->player_index)// we reduce -0.2 in the y axis to compensate hitbox
+                    {
+                        Vector3 position = {view->position.x, view->position.y-0.2, view->position.z};
+                        pick->level = lod_select(creature_lod, lod_screen_size(camera.position, lod_scale, Vector3Add(position, creature_lod->center), creature_lod->radius), current);
+                        if (pick->level == creature_lod->count)
+                            impostor_batch_push(impostors, creature_lod, camera.position, position, view->rotation.y);
+                        else
+                        {
+                            DrawModelEx(creature_lod->levels[pick->level], position, (Vector3){0,1,0}, view->rotation.y, (Vector3){1,1,1}, RED);
+                            triangles += creature_lod->triangles[pick->level];
+                        }
+                    }
                 }
+                creature_picks->size = snapshot->creatures->size;
+                profile_count("impostors", impostors->count);
+                triangles += impostors->count * 2;
+                impostor_batch_draw(impostors);
+                profile_count("triangles", triangles);
 
                 // bullets
-                for (int i = 0; i < sys->world.bullets->size; i++) 
+                for (int i = 0; i < snapshot->bullets->size; i++) 
                 {
-                    DrawSphere(sys->world.bullets->data[i].position, 0.01f, BLACK);
+                    DrawSphere(snapshot->bullets->data[i], 0.01f, BLACK);
                 }
 
             EndMode3D();
+            profile_end();
+            profile_begin("hud");
 
             // crosshair
-            DrawLine(sys->resolution.x/2 - 10, sys->resolution.y/2, sys->resolution.x/2 + 10, sys->resolution.y/2, GREEN);
-            DrawLine(sys->resolution.x/2, sys->resolution.y/2 - 10, sys->resolution.x/2, sys->resolution.y/2 + 10, GREEN);
+            DrawLine(assets.resolution.x/2 - 10, assets.resolution.y/2, assets.resolution.x/2 + 10, assets.resolution.y/2, GREEN);
+            DrawLine(assets.resolution.x/2, assets.resolution.y/2 - 10, assets.resolution.x/2, assets.resolution.y/2 + 10, GREEN);
 
-            DrawTexture(sys->equip_textures->data[creature(player_id).current_item],
-            sys->resolution.x - sys->equip_textures->data[creature(player_id).current_item].width + 70, sys->resolution.y - sys->equip_textures->data[creature(player_id).current_item].height+25, WHITE);
+            DrawTexture(assets.equip_textures->data[snapshot->player_slot],
+            assets.resolution.x - assets.equip_textures->data[snapshot->player_slot].width + 70, assets.resolution.y - assets.equip_textures->data[snapshot->player_slot].height+25, WHITE);
 
-            DrawText(TextFormat("%s %d/%d", item_names[creature(player_id).inventory->data[creature(player_id).current_item].type], creature(player_id).inventory->data[creature(player_id).current_item].content, creature(player_id).inventory->data[creature(player_id).current_item].capacity), 10, 10, 20, DARKGRAY);
+            DrawText(arena_format(render_arena, "%s %d/%d", item_names[(int)snapshot->player_item.type], snapshot->player_item.content, snapshot->player_item.capacity), 10, 10, 20, DARKGRAY);
             //DrawText(TextFormat("Inimigos restantes: %d", enemies->size), 10, 10, 20, DARKGRAY);
-            DrawText(TextFormat("Player position: %f %f %f", creature(player_id).position.x, creature(player_id).position.y, creature(player_id).position.z), 10, 30, 20, DARKGRAY);
 
-        EndDrawing();
+            profile_count("creatures", snapshot->creatures->size);
+            profile_count("bullets", snapshot->bullets->size);
+            profile_count("frame arena bytes", snapshot->frame_bytes);
+            if (profiler.enabled)
+            {
+                draw_profiler_overlay(snapshot, &sampler, render_arena);
+            }
+
+            // messages, oldest on top
+            for (int i = 0; i < snapshot->message_count; i++)
+            {
+                DrawText(snapshot->messages[i], 10, assets.resolution.y - 30 - (snapshot->message_count - 1 - i) * 20, 20, LIGHTGRAY);
+            }
+            profile_end();
+
+        end_frame(render_arena);
+
+        double present_time = GetTime();
+        measure_latency(&sampler.look_latency, look_time, present_time);
+        measure_latency(&sampler.tick_latency, snapshot->input_time, present_time);
+        profile_count("look latency ms", sampler.look_latency.last_ms);
+        profile_count("tick latency ms", sampler.tick_latency.last_ms);
+        profile_count("input events dropped", sim->input_queue->dropped);
+
+        profile_end();
+        profiler_frame();
     }
 
+    atomic_store(&sim->running, false);
+#ifndef NO_THREADS
+    pthread_join(sim->thread, NULL);
+#else
+    jobs_free(sys->jobs);
+#endif
+    autosave_stop(sys, true);
+    snapshot_buffer_free(sim->snapshots);
+    input_queue_free(sim->input_queue);
+    free(sim);
+
+    if (impostors->capacity > 0)
+        UnloadMesh(impostors->mesh);
+    UnloadShader(impostors->material.shader);
+    free(impostors);
     CloseWindow();
+    list_free(*creature_picks);
+    arena_free(render_arena);
     return 0;
-}
\ No newline at end of file
+}
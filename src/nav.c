@@ -0,0 +1,844 @@
+#include "nav.h"
+
+// neighbour k and neighbour 7 - k are opposite
+static const int nav_dx[8] = {-1, 0, 1, -1, 1, -1, 0, 1};
+static const int nav_dz[8] = {-1, -1, -1, 0, 0, 1, 1, 1};
+static const float nav_cost[8] = {1.41421356f, 1, 1.41421356f, 1, 1, 1.41421356f, 1, 1.41421356f};
+// atan2f(dz, dx), the yaw of a creature stepping that way
+static const float nav_yaw[8] = {-3 * PI / 4, -PI / 2, -PI / 4, PI, 0, 3 * PI / 4, PI / 2, PI / 4};
+
+Navigation* nav_init(void)
+{
+    Navigation* nav = (Navigation*)malloc(sizeof(Navigation));
+    memset(nav, 0, sizeof(Navigation));
+    nav->map = -1;
+    for (Int f = 0; f < NAV_MAX_FIELDS; f++)
+    {
+        nav->fields[f].target_id = -1;
+        nav->fields[f].goal = -1;
+        nav->fields[f].building = -1;
+        nav->fields[f].open = list_init(NavOpenList);
+    }
+
+    nav->polys = list_init(NavPolyList);
+    nav->links = list_init(NavLinkList);
+    nav->pending = list_init(IntList);
+    for (Int e = 0; e < NAV_PATH_CACHE_SIZE; e++)
+        nav->cache[e].corridor = list_init(IntList);
+
+    nav_cache_clear(nav);
+    return nav;
+}
+
+static void nav_free_cells(Navigation* nav)
+{
+    free(nav->height);
+    nav->height = NULL;
+    for (Int f = 0; f < NAV_MAX_FIELDS; f++)
+    {
+        FlowField* field = &nav->fields[f];
+        free(field->direction);
+        free(field->distance);
+        free(field->next_direction);
+        field->direction = NULL;
+        field->distance = NULL;
+        field->next_direction = NULL;
+        field->target_id = -1;
+        field->goal = -1;
+        field->building = -1;
+        field->open->size = 0;
+    }
+
+    free(nav->cell_poly);
+    nav->cell_poly = NULL;
+    nav->polys->size = 0;
+    nav->links->size = 0;
+    nav_cache_clear(nav);
+}
+
+void nav_free(Navigation* nav)
+{
+    nav_free_cells(nav);
+    for (Int f = 0; f < NAV_MAX_FIELDS; f++)
+        list_free(*nav->fields[f].open);
+
+    for (Int e = 0; e < NAV_PATH_CACHE_SIZE; e++)
+        list_free(*nav->cache[e].corridor);
+
+    for (Int w = 0; w < JOBS_MAX_WORKERS; w++)
+    {
+        free(nav->searches[w].cost);
+        free(nav->searches[w].parent);
+        free(nav->searches[w].seen);
+        if (nav->searches[w].open != NULL)
+            list_free(*nav->searches[w].open);
+    }
+
+    list_free(*nav->polys);
+    list_free(*nav->links);
+    list_free(*nav->pending);
+    free(nav);
+}
+
+// every hitbox raises the cells under it to its top, so the grid only costs the area the boxes cover;
+// fields are dropped, their cells no longer mean anything
+void nav_build_grid(Navigation* nav, Map* map, Int map_id)
+{
+    profile_zone("nav_build_grid");
+    nav_free_cells(nav);
+    nav->map = map_id;
+    nav->hitbox_count = map->hitboxes->size;
+    nav->width = nav->depth = 0;
+    if (map->hitboxes->size == 0)
+        return;
+
+    BoundingBox bounds = map->hitboxes->data[0];
+    for (Int i = 1; i < map->hitboxes->size; i++)
+    {
+        bounds.min = Vector3Min(bounds.min, map->hitboxes->data[i].min);
+        bounds.max = Vector3Max(bounds.max, map->hitboxes->data[i].max);
+    }
+
+    nav->origin = bounds.min;
+    nav->width = ceilf((bounds.max.x - bounds.min.x) / NAV_CELL_SIZE);
+    nav->depth = ceilf((bounds.max.z - bounds.min.z) / NAV_CELL_SIZE);
+    if (nav->width < 1 || nav->depth < 1 || (Int)nav->width * nav->depth > NAV_MAX_CELLS)
+    {
+        printf("map %s is too big to navigate (%d x %d cells)\n", map->name, nav->width, nav->depth);
+        nav->width = nav->depth = 0;
+        return;
+    }
+
+    Int cells = (Int)nav->width * nav->depth;
+    nav->height = (float*)malloc(sizeof(float) * cells);
+    for (Int c = 0; c < cells; c++)
+        nav->height[c] = NAN;
+
+    for (Int i = 0; i < map->hitboxes->size; i++)
+    {
+        BoundingBox box = map->hitboxes->data[i];
+        // cells whose center is inside the box
+        int min_x = ceilf((box.min.x - nav->origin.x) / NAV_CELL_SIZE - 0.5f), max_x = floorf((box.max.x - nav->origin.x) / NAV_CELL_SIZE - 0.5f);
+        int min_z = ceilf((box.min.z - nav->origin.z) / NAV_CELL_SIZE - 0.5f), max_z = floorf((box.max.z - nav->origin.z) / NAV_CELL_SIZE - 0.5f);
+        min_x = min_x < 0 ? 0 : min_x;
+        min_z = min_z < 0 ? 0 : min_z;
+        max_x = max_x >= nav->width ? nav->width - 1 : max_x;
+        max_z = max_z >= nav->depth ? nav->depth - 1 : max_z;
+        for (int z = min_z; z <= max_z; z++)
+        {
+            for (int x = min_x; x <= max_x; x++)
+            {
+                float *height = &nav->height[(Int)z * nav->width + x];
+                if (isnan(*height) || box.max.y > *height)
+                    *height = box.max.y;
+            }
+        }
+    }
+
+    nav_build_mesh(nav);
+}
+
+// -1 outside the grid
+Int nav_cell(Navigation* nav, Vector3 position)
+{
+    int x = floorf((position.x - nav->origin.x) / NAV_CELL_SIZE);
+    int z = floorf((position.z - nav->origin.z) / NAV_CELL_SIZE);
+    if (x < 0 || z < 0 || x >= nav->width || z >= nav->depth)
+        return -1;
+
+    return (Int)z * nav->width + x;
+}
+
+FlowField* nav_find_field(Navigation* nav, Int target_id)
+{
+    for (Int f = 0; f < NAV_MAX_FIELDS; f++)
+    {
+        if (nav->fields[f].target_id == target_id)
+            return &nav->fields[f];
+    }
+    return NULL;
+}
+
+static void nav_heap_push(NavOpenList *heap, NavOpen open)
+{
+    list_push(*heap, open);
+    Int i = heap->size - 1;
+    while (i > 0 && heap->data[(i - 1) / 2].distance > heap->data[i].distance)
+    {
+        list_swap(*heap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static NavOpen nav_heap_pop(NavOpenList *heap)
+{
+    NavOpen top = heap->data[0];
+    heap->data[0] = heap->data[--heap->size];
+    Int i = 0;
+    while (true)
+    {
+        Int smallest = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < heap->size && heap->data[left].distance < heap->data[smallest].distance)
+            smallest = left;
+        if (right < heap->size && heap->data[right].distance < heap->data[smallest].distance)
+            smallest = right;
+        if (smallest == i)
+            break;
+
+        list_swap(*heap, i, smallest);
+        i = smallest;
+    }
+    return top;
+}
+
+// from can walk into to
+static bool nav_can_step(Navigation* nav, Int from, Int to)
+{
+    return !isnan(nav->height[to]) && nav->height[to] - nav->height[from] <= NAV_STEP_HEIGHT;
+}
+
+// drops the rebuild in progress, if any, and starts one towards goal
+void nav_start_field(Navigation* nav, FlowField* field, Int goal)
+{
+    Int cells = (Int)nav->width * nav->depth;
+    if (field->distance == NULL)
+    {
+        field->distance = (float*)malloc(sizeof(float) * cells);
+        field->next_direction = (unsigned char*)malloc(cells);
+    }
+
+    for (Int c = 0; c < cells; c++)
+        field->distance[c] = INFINITY;
+
+    memset(field->next_direction, NAV_NO_DIRECTION, cells);
+    field->open->size = 0;
+    field->building = goal;
+    field->distance[goal] = 0;
+    nav_heap_push(field->open, (NavOpen){0, goal});
+}
+
+// settles up to budget cells of the rebuild in progress, dijkstra run backwards from the goal:
+// a cell is reached from a neighbour it can walk into, and its direction points at that neighbour;
+// true once the new field is swapped in
+bool nav_update_field(Navigation* nav, FlowField* field, Int budget)
+{
+    if (field->building < 0)
+        return false;
+
+    while (field->open->size > 0 && budget-- > 0)
+    {
+        NavOpen open = nav_heap_pop(field->open);
+        // a shorter way here was found after this one was pushed
+        if (open.distance > field->distance[open.cell])
+            continue;
+
+        int x = open.cell % nav->width, z = open.cell / nav->width;
+        for (int k = 0; k < 8; k++)
+        {
+            int nx = x + nav_dx[k], nz = z + nav_dz[k];
+            if (nx < 0 || nz < 0 || nx >= nav->width || nz >= nav->depth)
+                continue;
+
+            Int next = (Int)nz * nav->width + nx;
+            if (isnan(nav->height[next]) || !nav_can_step(nav, next, open.cell))
+                continue;
+
+            // no cutting corners: a diagonal step needs both cells beside it to be walkable too
+            if (nav_dx[k] != 0 && nav_dz[k] != 0 &&
+                (!nav_can_step(nav, next, (Int)z * nav->width + nx) || !nav_can_step(nav, next, (Int)nz * nav->width + x)))
+                continue;
+
+            float distance = open.distance + nav_cost[k];
+            if (distance < field->distance[next])
+            {
+                field->distance[next] = distance;
+                field->next_direction[next] = 7 - k;
+                nav_heap_push(field->open, (NavOpen){distance, next});
+            }
+        }
+    }
+
+    if (field->open->size > 0)
+        return false;
+
+    Int cells = (Int)nav->width * nav->depth;
+    if (field->direction == NULL)
+        field->direction = (unsigned char*)malloc(cells);
+
+    unsigned char *done = field->next_direction;
+    field->next_direction = field->direction;
+    field->direction = done;
+    field->goal = field->building;
+    field->building = -1;
+    return true;
+}
+
+// the creature's decision for its target, kept in steer until it thinks again (ai.h);
+// field is a hint from the previous call, a horde shares one target so it is almost always the right one
+void nav_steer(InternalSystem* sys, Creature* c, FlowField** field)
+{
+    Navigation* nav = sys->nav;
+    c->steer = (Vector3){0, 0, 0};
+    if (c->target_id < 0 || nav->width == 0)
+        return;
+
+    if (*field == NULL || (*field)->target_id != c->target_id)
+        *field = nav_find_field(nav, c->target_id);
+
+    if (*field == NULL || (*field)->goal < 0)
+        return;
+
+    Int cell = nav_cell(nav, c->position);
+    if (cell < 0)
+        return;
+
+    Vector3 move;
+    float yaw;
+    if (cell == (*field)->goal || cell == nav_cell(nav, (*field)->target_position))
+    {
+        move = (Vector3){(*field)->target_position.x - c->position.x, 0, (*field)->target_position.z - c->position.z};
+        if (Vector3Length(move) < NAV_ARRIVE_DISTANCE)
+            return;
+
+        move = Vector3Normalize(move);
+        yaw = atan2f(move.z, move.x);
+    }
+    else
+    {
+        unsigned char k = (*field)->direction[cell];
+        if (k == NAV_NO_DIRECTION)
+            return;
+
+        move = Vector3Normalize((Vector3){nav_dx[k], 0, nav_dz[k]});
+        yaw = nav_yaw[k];
+    }
+
+    c->steer = move;
+    // face where it walks, same convention as look_direction
+    if (c->rotation.x != yaw)
+    {
+        c->rotation.x = yaw;
+        mark_dirty(sys, c);
+    }
+}
+
+// (re)builds the grid and the navmesh when the current map changed, false if there is nothing to navigate
+bool nav_sync(InternalSystem* sys)
+{
+    Navigation* nav = sys->nav;
+    if (sys->current_map < 0 || sys->current_map >= sys->maps->size)
+        return false;
+
+    Map* map = &sys->maps->data[sys->current_map];
+    if (nav->map != sys->current_map || nav->hitbox_count != map->hitboxes->size)
+        nav_build_grid(nav, map, sys->current_map);
+
+    return nav->width > 0;
+}
+
+// fields follow their targets, the creatures chasing something steer by them when update_ai lets them think;
+// a field is rebuilt only when its target walks into another cell, and then over as many ticks as it takes
+void update_navigation(InternalSystem* sys)
+{
+    Navigation* nav = sys->nav;
+    if (!nav_sync(sys))
+        return;
+
+    nav->tick++;
+    // every target somebody chases gets a field
+    Int last_target = -1;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        Int target = creature(i).target_id;
+        if (target < 0 || target == last_target)
+            continue;
+
+        last_target = target;
+        FlowField* field = nav_find_field(nav, target);
+        if (field == NULL)
+        {
+            field = nav_find_field(nav, -1);
+            if (field == NULL)
+                continue;
+
+            field->target_id = target;
+            field->target_index = -1;
+            field->goal = -1;
+            field->building = -1;
+        }
+        field->last_used = nav->tick;
+    }
+
+    for (Int f = 0; f < NAV_MAX_FIELDS; f++)
+    {
+        FlowField* field = &nav->fields[f];
+        if (field->target_id < 0)
+            continue;
+
+        Int index = field->target_index;
+        if (index < 0 || index >= sys->world.creatures->size || creature(index).id != field->target_id)
+        {
+            index = -1;
+            for (Int i = 0; i < sys->world.creatures->size && index < 0; i++)
+            {
+                if (creature(i).id == field->target_id)
+                    index = i;
+            }
+        }
+
+        // the target is gone or nobody chases it anymore
+        if (index < 0 || nav->tick - field->last_used > NAV_FIELD_TIMEOUT)
+        {
+            field->target_id = -1;
+            field->goal = -1;
+            field->building = -1;
+            continue;
+        }
+
+        field->target_index = index;
+        field->target_position = creature(index).position;
+        Int goal = nav_cell(nav, field->target_position);
+        if (goal >= 0 && field->building < 0 && goal != field->goal && !isnan(nav->height[goal]))
+            nav_start_field(nav, field, goal);
+
+        nav_update_field(nav, field, NAV_EXPANSIONS_PER_TICK);
+    }
+}
+
+// twice the signed area of abc on the xz plane, the sign tells on which side of ab c is
+static float nav_triarea(Vector3 a, Vector3 b, Vector3 c)
+{
+    return (c.x - a.x) * (b.z - a.z) - (b.x - a.x) * (c.z - a.z);
+}
+
+static Vector3 nav_poly_center(NavPoly* poly)
+{
+    return (Vector3){(poly->min.x + poly->max.x) / 2, poly->min.y, (poly->min.z + poly->max.z) / 2};
+}
+
+// a portal from p into q along the segment a b of the side they share
+static void nav_add_link(Navigation* nav, Int p, Int q, Vector3 a, Vector3 b)
+{
+    float length = Vector3Distance(a, b);
+    Vector3 middle = Vector3Lerp(a, b, 0.5f);
+    if (length > 2 * NAV_AGENT_RADIUS)
+    {
+        Vector3 along = Vector3Scale(Vector3Subtract(b, a), NAV_AGENT_RADIUS / length);
+        a = Vector3Add(a, along);
+        b = Vector3Subtract(b, along);
+    }
+    else
+    {
+        a = b = middle;
+    }
+
+    // the funnel wants right on the positive side looking from the polygon through the portal
+    Vector3 center = nav_poly_center(&nav->polys->data[p]);
+    NavLink link = {q, a, b};
+    if (nav_triarea(center, middle, a) > 0)
+    {
+        link.left = b;
+        link.right = a;
+    }
+    list_push(*nav->links, link);
+}
+
+// the cells just outside one side of polygon p, from (x, z) stepping (dx, dz) count times;
+// every run of cells in the same walkable neighbour becomes one portal on the line from a stepping by step
+static void nav_link_side(Navigation* nav, Int p, int x, int z, int dx, int dz, int count, Vector3 a, Vector3 step)
+{
+    NavPoly* poly = &nav->polys->data[p];
+    Int run_poly = -1;
+    int run_start = 0;
+    for (int i = 0; i <= count; i++)
+    {
+        int cx = x + dx * i, cz = z + dz * i;
+        Int q = -1;
+        if (i < count && cx >= 0 && cz >= 0 && cx < nav->width && cz < nav->depth)
+        {
+            q = nav->cell_poly[(Int)cz * nav->width + cx];
+            if (q >= 0 && nav->polys->data[q].min.y - poly->min.y > NAV_STEP_HEIGHT)
+                q = -1;
+        }
+
+        if (q == run_poly)
+            continue;
+
+        if (run_poly >= 0)
+            nav_add_link(nav, p, run_poly, Vector3Add(a, Vector3Scale(step, run_start)), Vector3Add(a, Vector3Scale(step, i)));
+
+        run_poly = q;
+        run_start = i;
+    }
+}
+
+// greedy: the first free walkable cell grows along x, then along z while whole rows of the same height fit,
+// so every polygon is a rectangle and the whole mesh costs a couple of passes over the grid
+void nav_build_mesh(Navigation* nav)
+{
+    profile_zone("nav_build_mesh");
+    Int cells = (Int)nav->width * nav->depth;
+    nav->cell_poly = (Int*)malloc(sizeof(Int) * cells);
+    for (Int c = 0; c < cells; c++)
+        nav->cell_poly[c] = -1;
+
+    for (int z = 0; z < nav->depth; z++)
+    {
+        for (int x = 0; x < nav->width; x++)
+        {
+            Int c = (Int)z * nav->width + x;
+            if (isnan(nav->height[c]) || nav->cell_poly[c] >= 0)
+                continue;
+
+            float height = nav->height[c];
+            int width = 1, depth = 1;
+            while (x + width < nav->width && nav->cell_poly[c + width] < 0 && nav->height[c + width] == height)
+                width++;
+
+            for (bool fits = true; fits && z + depth < nav->depth; )
+            {
+                Int row = (Int)(z + depth) * nav->width + x;
+                for (int i = 0; i < width && fits; i++)
+                    fits = nav->cell_poly[row + i] < 0 && nav->height[row + i] == height;
+
+                if (fits)
+                    depth++;
+            }
+
+            Int p = nav->polys->size;
+            for (int j = 0; j < depth; j++)
+            {
+                for (int i = 0; i < width; i++)
+                    nav->cell_poly[(Int)(z + j) * nav->width + x + i] = p;
+            }
+
+            NavPoly poly = {0};
+            poly.min = (Vector3){nav->origin.x + x * NAV_CELL_SIZE, height, nav->origin.z + z * NAV_CELL_SIZE};
+            poly.max = (Vector3){nav->origin.x + (x + width) * NAV_CELL_SIZE, height, nav->origin.z + (z + depth) * NAV_CELL_SIZE};
+            list_push(*nav->polys, poly);
+        }
+    }
+
+    for (Int p = 0; p < nav->polys->size; p++)
+    {
+        NavPoly poly = nav->polys->data[p];
+        int x = lroundf((poly.min.x - nav->origin.x) / NAV_CELL_SIZE), z = lroundf((poly.min.z - nav->origin.z) / NAV_CELL_SIZE);
+        int width = lroundf((poly.max.x - poly.min.x) / NAV_CELL_SIZE), depth = lroundf((poly.max.z - poly.min.z) / NAV_CELL_SIZE);
+        Vector3 along_x = {NAV_CELL_SIZE, 0, 0}, along_z = {0, 0, NAV_CELL_SIZE};
+        nav->polys->data[p].first_link = nav->links->size;
+        nav_link_side(nav, p, x, z - 1, 1, 0, width, poly.min, along_x);
+        nav_link_side(nav, p, x, z + depth, 1, 0, width, (Vector3){poly.min.x, poly.min.y, poly.max.z}, along_x);
+        nav_link_side(nav, p, x - 1, z, 0, 1, depth, poly.min, along_z);
+        nav_link_side(nav, p, x + width, z, 0, 1, depth, (Vector3){poly.max.x, poly.min.y, poly.min.z}, along_z);
+        nav->polys->data[p].link_count = nav->links->size - nav->polys->data[p].first_link;
+    }
+}
+
+// polygon under position, -1 off the navmesh
+Int nav_locate(Navigation* nav, Vector3 position)
+{
+    if (nav->cell_poly == NULL)
+        return -1;
+
+    Int cell = nav_cell(nav, position);
+    return cell < 0 ? -1 : nav->cell_poly[cell];
+}
+
+// every corridor is dropped, the entries are chained oldest last in index order
+void nav_cache_clear(Navigation* nav)
+{
+    for (Int b = 0; b < NAV_PATH_CACHE_BUCKETS; b++)
+        nav->buckets[b] = -1;
+
+    for (Int e = 0; e < NAV_PATH_CACHE_SIZE; e++)
+    {
+        NavCacheEntry* entry = &nav->cache[e];
+        entry->start = entry->goal = -1;
+        entry->corridor->size = 0;
+        entry->pending = false;
+        entry->newer = e - 1;
+        entry->older = e + 1 < NAV_PATH_CACHE_SIZE ? e + 1 : -1;
+        entry->next = -1;
+    }
+    nav->newest = 0;
+    nav->oldest = NAV_PATH_CACHE_SIZE - 1;
+}
+
+static Int nav_cache_bucket(Int start, Int goal)
+{
+    return ((unsigned long)(start * 73856093) ^ (unsigned long)(goal * 19349663)) % NAV_PATH_CACHE_BUCKETS;
+}
+
+static void nav_cache_touch(Navigation* nav, Int e)
+{
+    NavCacheEntry* entry = &nav->cache[e];
+    if (nav->newest == e)
+        return;
+
+    // unlink, it is not the newest so it has a newer one
+    nav->cache[entry->newer].older = entry->older;
+    if (entry->older >= 0)
+        nav->cache[entry->older].newer = entry->newer;
+    else
+        nav->oldest = entry->newer;
+
+    entry->newer = -1;
+    entry->older = nav->newest;
+    nav->cache[nav->newest].newer = e;
+    nav->newest = e;
+}
+
+// the entry for start to goal, a miss takes over the least recently used entry and leaves it pending
+static Int nav_cache_get(Navigation* nav, Int start, Int goal)
+{
+    Int bucket = nav_cache_bucket(start, goal);
+    for (Int e = nav->buckets[bucket]; e >= 0; e = nav->cache[e].next)
+    {
+        if (nav->cache[e].start == start && nav->cache[e].goal == goal)
+        {
+            nav->cache_hits++;
+            nav_cache_touch(nav, e);
+            return e;
+        }
+    }
+
+    nav->cache_misses++;
+    Int e = nav->oldest;
+    NavCacheEntry* entry = &nav->cache[e];
+    if (entry->start >= 0)
+    {
+        Int *link = &nav->buckets[nav_cache_bucket(entry->start, entry->goal)];
+        while (*link != e)
+            link = &nav->cache[*link].next;
+
+        *link = entry->next;
+    }
+
+    entry->start = start;
+    entry->goal = goal;
+    entry->corridor->size = 0;
+    entry->pending = true;
+    entry->next = nav->buckets[bucket];
+    nav->buckets[bucket] = e;
+    nav_cache_touch(nav, e);
+    list_push(*nav->pending, e);
+    return e;
+}
+
+// a* over the polygons, costs between polygon centers; false and an empty corridor when goal can't be reached
+bool nav_find_corridor(Navigation* nav, NavSearch* search, Int start, Int goal, IntList* corridor)
+{
+    corridor->size = 0;
+    Int count = nav->polys->size;
+    if (search->capacity < count)
+    {
+        free(search->cost);
+        free(search->parent);
+        free(search->seen);
+        search->cost = (float*)malloc(sizeof(float) * count);
+        search->parent = (Int*)malloc(sizeof(Int) * count);
+        search->seen = (unsigned int*)calloc(count, sizeof(unsigned int));
+        search->capacity = count;
+        search->stamp = 0;
+        if (search->open == NULL)
+            search->open = list_init(NavOpenList);
+    }
+
+    // stamps instead of clearing the arrays every search
+    if (++search->stamp == 0)
+    {
+        memset(search->seen, 0, sizeof(unsigned int) * search->capacity);
+        search->stamp = 1;
+    }
+
+    NavPoly* polys = nav->polys->data;
+    Vector3 target = nav_poly_center(&polys[goal]);
+    search->open->size = 0;
+    search->cost[start] = 0;
+    search->parent[start] = -1;
+    search->seen[start] = search->stamp;
+    nav_heap_push(search->open, (NavOpen){Vector3Distance(nav_poly_center(&polys[start]), target), start});
+    while (search->open->size > 0)
+    {
+        NavOpen open = nav_heap_pop(search->open);
+        Int p = open.cell;
+        if (p == goal)
+            break;
+
+        Vector3 center = nav_poly_center(&polys[p]);
+        // pushed again with a lower cost since
+        if (open.distance > search->cost[p] + Vector3Distance(center, target) + 1e-3f)
+            continue;
+
+        for (Int l = polys[p].first_link; l < polys[p].first_link + polys[p].link_count; l++)
+        {
+            Int q = nav->links->data[l].poly;
+            Vector3 next = nav_poly_center(&polys[q]);
+            float cost = search->cost[p] + Vector3Distance(center, next);
+            if (search->seen[q] != search->stamp || cost < search->cost[q])
+            {
+                search->seen[q] = search->stamp;
+                search->cost[q] = cost;
+                search->parent[q] = p;
+                nav_heap_push(search->open, (NavOpen){cost + Vector3Distance(next, target), q});
+            }
+        }
+    }
+
+    if (search->seen[goal] != search->stamp)
+        return false;
+
+    for (Int p = goal; p >= 0; p = search->parent[p])
+        list_push(*corridor, p);
+
+    list_reverse(*corridor);
+    return true;
+}
+
+// portal i of a corridor walk: 0 is the start point, the last one the goal, the ones between are the links
+static void nav_portal(Navigation* nav, IntList* corridor, Int i, Vector3 start, Vector3 goal, Vector3* left, Vector3* right)
+{
+    if (i == 0 || i >= corridor->size)
+    {
+        *left = *right = i == 0 ? start : goal;
+        return;
+    }
+
+    NavPoly* poly = &nav->polys->data[corridor->data[i - 1]];
+    for (Int l = poly->first_link; l < poly->first_link + poly->link_count; l++)
+    {
+        if (nav->links->data[l].poly == corridor->data[i])
+        {
+            *left = nav->links->data[l].left;
+            *right = nav->links->data[l].right;
+            return;
+        }
+    }
+    *left = *right = nav_poly_center(&nav->polys->data[corridor->data[i]]);
+}
+
+// simple stupid funnel: the path only turns at portal ends, where the funnel from the last turn collapses
+void nav_funnel(Navigation* nav, IntList* corridor, Vector3 start, Vector3 goal, Vector3List* path)
+{
+    path->size = 0;
+    list_push(*path, start);
+    Vector3 apex = start, funnel_left = start, funnel_right = start;
+    Int apex_index = 0, left_index = 0, right_index = 0;
+    for (Int i = 1; i <= corridor->size; i++)
+    {
+        Vector3 left, right;
+        nav_portal(nav, corridor, i, start, goal, &left, &right);
+
+        if (nav_triarea(apex, funnel_right, right) <= 0)
+        {
+            if (Vector3Equals(apex, funnel_right) || nav_triarea(apex, funnel_left, right) > 0)
+            {
+                funnel_right = right;
+                right_index = i;
+            }
+            else
+            {
+                // right crossed over left, the left end is a corner
+                list_push(*path, funnel_left);
+                apex = funnel_right = funnel_left;
+                apex_index = right_index = left_index;
+                i = apex_index;
+                continue;
+            }
+        }
+
+        if (nav_triarea(apex, funnel_left, left) >= 0)
+        {
+            if (Vector3Equals(apex, funnel_left) || nav_triarea(apex, funnel_right, left) < 0)
+            {
+                funnel_left = left;
+                left_index = i;
+            }
+            else
+            {
+                list_push(*path, funnel_right);
+                apex = funnel_left = funnel_right;
+                apex_index = left_index = right_index;
+                i = apex_index;
+                continue;
+            }
+        }
+    }
+
+    if (!Vector3Equals(path->data[path->size - 1], goal))
+        list_push(*path, goal);
+
+    // corners stand on the floor of the cell they are in
+    for (Int i = 1; i < path->size - 1; i++)
+    {
+        Int cell = nav_cell(nav, path->data[i]);
+        if (cell >= 0 && !isnan(nav->height[cell]))
+            path->data[i].y = nav->height[cell];
+    }
+}
+
+typedef struct
+{
+    Navigation* nav;
+    NavPathQuery* queries;
+} NavBatch;
+
+static void corridor_job(void *data, Int start, Int end)
+{
+    NavBatch* batch = data;
+    Navigation* nav = batch->nav;
+    Int worker = jobs_worker_index();
+    NavSearch* search = &nav->searches[worker > 0 ? worker : 0];
+    for (Int i = start; i < end; i++)
+    {
+        NavCacheEntry* entry = &nav->cache[nav->pending->data[i]];
+        nav_find_corridor(nav, search, entry->start, entry->goal, entry->corridor);
+        entry->pending = false;
+    }
+}
+
+static void funnel_job(void *data, Int start, Int end)
+{
+    NavBatch* batch = data;
+    for (Int i = start; i < end; i++)
+    {
+        NavPathQuery* query = &batch->queries[i];
+        query->path->size = 0;
+        if (query->entry >= 0 && batch->nav->cache[query->entry].corridor->size > 0)
+            nav_funnel(batch->nav, batch->nav->cache[query->entry].corridor, query->start, query->goal, query->path);
+    }
+}
+
+// paths for a whole batch: cache lookups on the calling thread, then the missing corridors and every funnel on the job workers;
+// the queries own their path lists
+void nav_find_paths(InternalSystem* sys, NavPathQuery* queries, Int count)
+{
+    profile_zone("nav_find_paths");
+    Navigation* nav = sys->nav;
+    bool ready = nav_sync(sys);
+    for (Int first = 0; first < count; first += NAV_PATH_CACHE_SIZE)
+    {
+        Int chunk = count - first < NAV_PATH_CACHE_SIZE ? count - first : NAV_PATH_CACHE_SIZE;
+        NavBatch batch = {nav, queries + first};
+        nav->pending->size = 0;
+        for (Int i = 0; i < chunk; i++)
+        {
+            NavPathQuery* query = &batch.queries[i];
+            query->entry = -1;
+            Int start = ready ? nav_locate(nav, query->start) : -1;
+            Int goal = ready ? nav_locate(nav, query->goal) : -1;
+            if (start >= 0 && goal >= 0)
+                query->entry = nav_cache_get(nav, start, goal);
+        }
+
+        jobs_parallel_for(sys->jobs, nav->pending->size, 4, corridor_job, &batch);
+        jobs_parallel_for(sys->jobs, chunk, 64, funnel_job, &batch);
+    }
+}
+
+bool nav_find_path(InternalSystem* sys, Vector3 start, Vector3 goal, Vector3List* path)
+{
+    NavPathQuery query = {start, goal, path, -1};
+    nav_find_paths(sys, &query, 1);
+    return path->size > 0;
+}
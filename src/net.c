@@ -0,0 +1,671 @@
+#include "net.h"
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// every write checks the room left, a write that does not fit sets overflow and writes nothing
+static bool writer_room(PacketWriter *writer, Int bytes)
+{
+    if (writer->overflow || writer->size + bytes > NET_MAX_PACKET)
+    {
+        writer->overflow = true;
+        return false;
+    }
+    return true;
+}
+
+void write_u8(PacketWriter *writer, unsigned int value)
+{
+    if (writer_room(writer, 1))
+        writer->data[writer->size++] = value;
+}
+
+// little endian
+void write_u16(PacketWriter *writer, unsigned int value)
+{
+    if (!writer_room(writer, 2))
+        return;
+
+    writer->data[writer->size++] = value & 0xFF;
+    writer->data[writer->size++] = (value >> 8) & 0xFF;
+}
+
+void write_u32(PacketWriter *writer, unsigned int value)
+{
+    if (!writer_room(writer, 4))
+        return;
+
+    for (int i = 0; i < 4; i++)
+        writer->data[writer->size++] = (value >> (i * 8)) & 0xFF;
+}
+
+// 7 bits per byte, high bit set while more bytes follow
+void write_varint(PacketWriter *writer, unsigned long value)
+{
+    unsigned char bytes[10];
+    Int count = 0;
+    do
+    {
+        bytes[count] = value & 0x7F;
+        value >>= 7;
+        if (value != 0)
+            bytes[count] |= 0x80;
+        count++;
+    } while (value != 0);
+
+    if (!writer_room(writer, count))
+        return;
+
+    memcpy(writer->data + writer->size, bytes, count);
+    writer->size += count;
+}
+
+// small negative numbers stay small: 0 -1 1 -2 2 ... become 0 1 2 3 4 ...
+void write_zigzag(PacketWriter *writer, long value)
+{
+    write_varint(writer, ((unsigned long)value << 1) ^ (unsigned long)(value >> 63));
+}
+
+static bool reader_has(PacketReader *reader, Int bytes)
+{
+    if (reader->error || reader->position + bytes > reader->size)
+    {
+        reader->error = true;
+        return false;
+    }
+    return true;
+}
+
+unsigned int read_u8(PacketReader *reader)
+{
+    if (!reader_has(reader, 1))
+        return 0;
+
+    return reader->data[reader->position++];
+}
+
+unsigned int read_u16(PacketReader *reader)
+{
+    if (!reader_has(reader, 2))
+        return 0;
+
+    unsigned int value = reader->data[reader->position] | (reader->data[reader->position + 1] << 8);
+    reader->position += 2;
+    return value;
+}
+
+unsigned int read_u32(PacketReader *reader)
+{
+    if (!reader_has(reader, 4))
+        return 0;
+
+    unsigned int value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (unsigned int)reader->data[reader->position + i] << (i * 8);
+
+    reader->position += 4;
+    return value;
+}
+
+unsigned long read_varint(PacketReader *reader)
+{
+    unsigned long value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        unsigned int byte = read_u8(reader);
+        if (reader->error)
+            return 0;
+
+        value |= (unsigned long)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    reader->error = true;
+    return 0;
+}
+
+long read_zigzag(PacketReader *reader)
+{
+    unsigned long value = read_varint(reader);
+    return (long)(value >> 1) ^ -(long)(value & 1);
+}
+
+static short quantize(float value, float scale)
+{
+    float q = roundf(value * scale);
+    return q > 32767 ? 32767 : q < -32768 ? -32768 : (short)q;
+}
+
+short quantize_position(float value)
+{
+    return quantize(value, NET_POSITION_SCALE);
+}
+
+float dequantize_position(short value)
+{
+    return value / NET_POSITION_SCALE;
+}
+
+short quantize_rotation(float value)
+{
+    return quantize(value, NET_ROTATION_SCALE);
+}
+
+float dequantize_rotation(short value)
+{
+    return value / NET_ROTATION_SCALE;
+}
+
+void net_snapshot_init(NetSnapshot *snapshot)
+{
+    snapshot->tick = -1;
+    snapshot->entities = list_init(EntityStateList);
+}
+
+void net_snapshot_free(NetSnapshot *snapshot)
+{
+    list_free(*snapshot->entities);
+    snapshot->entities = NULL;
+}
+
+void net_snapshot_copy(NetSnapshot *to, NetSnapshot *from)
+{
+    to->tick = from->tick;
+    to->entities->size = 0;
+    list_reserve(*to->entities, from->entities->size);
+    memcpy(to->entities->data, from->entities->data, sizeof(EntityState) * from->entities->size);
+    to->entities->size = from->entities->size;
+}
+
+static int compare_entities(const void *a, const void *b)
+{
+    Int x = ((const EntityState*)a)->id, y = ((const EntityState*)b)->id;
+    return (x > y) - (x < y);
+}
+
+// entities are sorted by id
+EntityState* find_entity(EntityStateList *entities, Int id)
+{
+    EntityState key = {0};
+    key.id = id;
+    return (EntityState*)bsearch(&key, entities->data, entities->size, sizeof(EntityState), compare_entities);
+}
+
+void build_world_state(InternalSystem* sys, NetSnapshot *snapshot, Int tick)
+{
+    EntityStateList *entities = snapshot->entities;
+    snapshot->tick = tick;
+    entities->size = 0;
+    list_reserve(*entities, sys->world.creatures->size + sys->world.bullets->size);
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        EntityState *state = &entities->data[entities->size++];
+        state->id = creature(i).id;
+        state->type = ENTITY_CREATURE;
+        state->fields[FIELD_POSITION_X] = quantize_position(creature(i).position.x);
+        state->fields[FIELD_POSITION_Y] = quantize_position(creature(i).position.y);
+        state->fields[FIELD_POSITION_Z] = quantize_position(creature(i).position.z);
+        // yaw keeps adding up while the player turns around, wrap it
+        state->fields[FIELD_ROTATION_X] = quantize_rotation(remainderf(creature(i).rotation.x, 2 * PI));
+        state->fields[FIELD_ROTATION_Y] = quantize_rotation(creature(i).rotation.y);
+    }
+
+    for (Int i = 0; i < sys->world.bullets->size; i++)
+    {
+        EntityState *state = &entities->data[entities->size++];
+        state->id = bullet(i).id;
+        state->type = ENTITY_BULLET;
+        state->fields[FIELD_POSITION_X] = quantize_position(bullet(i).position.x);
+        state->fields[FIELD_POSITION_Y] = quantize_position(bullet(i).position.y);
+        state->fields[FIELD_POSITION_Z] = quantize_position(bullet(i).position.z);
+        state->fields[FIELD_ROTATION_X] = 0;
+        state->fields[FIELD_ROTATION_Y] = 0;
+    }
+
+    qsort(entities->data, entities->size, sizeof(EntityState), compare_entities);
+}
+
+// snapshot packet:
+// u8 PACKET_SNAPSHOT, u32 tick, u32 baseline tick, varint own id + 1
+// u16 removed count, removed ids as varints
+// u16 update count, per update: varint id, u8 change mask (| FIELD_NEW), u8 type if new,
+// the changed fields as zigzag deltas from the baseline (from 0 for new entities)
+//
+// updates go in the order of the current indexes in order, or own entity first and then by id when order is NULL,
+// what does not fit in NET_MAX_PACKET is left out;
+// sent gets the state the client will have after decoding it, that is the baseline for the next snapshots
+void write_snapshot(PacketWriter *writer, NetSnapshot *baseline, NetSnapshot *current, Int own_id, IntList *order, NetSnapshot *sent)
+{
+    static EntityStateList empty = {NULL, 0, 0};
+    EntityStateList *base = baseline != NULL ? baseline->entities : &empty;
+    EntityStateList *now = current->entities;
+
+    write_u8(writer, PACKET_SNAPSHOT);
+    write_u32(writer, current->tick);
+    write_u32(writer, baseline != NULL ? (unsigned int)baseline->tick : NET_NO_BASELINE);
+    write_varint(writer, own_id + 1);
+
+    bool *removed = (bool*)calloc(base->size + 1, sizeof(bool));
+    bool *written = (bool*)calloc(now->size + 1, sizeof(bool));
+    // baseline index of every current entity, -1 for new ones, one walk since both are sorted by id
+    Int *old_index = (Int*)malloc(sizeof(Int) * (now->size + 1));
+    for (Int i = 0, j = 0; j < now->size; j++)
+    {
+        while (i < base->size && base->data[i].id < now->data[j].id)
+            i++;
+
+        old_index[j] = i < base->size && base->data[i].id == now->data[j].id ? i : -1;
+    }
+
+    // removals first, they are cheap and a client that keeps dead entities around looks broken
+    Int count_at = writer->size;
+    Int count = 0;
+    write_u16(writer, 0);
+    for (Int i = 0, j = 0; i < base->size && !writer->overflow; i++)
+    {
+        while (j < now->size && now->data[j].id < base->data[i].id)
+            j++;
+
+        if (j < now->size && now->data[j].id == base->data[i].id)
+            continue;
+
+        Int save = writer->size;
+        write_varint(writer, base->data[i].id);
+        if (writer->overflow)
+        {
+            writer->size = save;
+            break;
+        }
+        removed[i] = true;
+        count++;
+    }
+    writer->overflow = false;
+    writer->data[count_at] = count & 0xFF;
+    writer->data[count_at + 1] = (count >> 8) & 0xFF;
+
+    count_at = writer->size;
+    count = 0;
+    write_u16(writer, 0);
+    EntityState *own = find_entity(now, own_id);
+    Int own_index = own != NULL ? own - now->data : -1;
+    Int total = order != NULL ? order->size : now->size;
+    for (Int n = order != NULL ? 0 : -1; n < total && !writer->overflow; n++)
+    {
+        Int j;
+        if (order != NULL)
+        {
+            j = order->data[n];
+        }
+        else
+        {
+            j = n == -1 ? own_index : n;
+            if (n >= 0 && j == own_index)
+                continue;
+        }
+
+        if (j < 0)
+            continue;
+
+        EntityState *state = &now->data[j];
+        EntityState *old = old_index[j] >= 0 ? &base->data[old_index[j]] : NULL;
+        unsigned int mask = 0;
+        for (int f = 0; f < FIELD_COUNT; f++)
+        {
+            if (old == NULL ? state->fields[f] != 0 : state->fields[f] != old->fields[f])
+                mask |= 1 << f;
+        }
+
+        if (old != NULL && mask == 0)
+        {
+            // unchanged, the client already has it
+            written[j] = true;
+            continue;
+        }
+
+        Int save = writer->size;
+        write_varint(writer, state->id);
+        write_u8(writer, mask | (old == NULL ? FIELD_NEW : 0));
+        if (old == NULL)
+            write_u8(writer, state->type);
+
+        for (int f = 0; f < FIELD_COUNT; f++)
+        {
+            if (mask & (1 << f))
+                write_zigzag(writer, (long)state->fields[f] - (old != NULL ? old->fields[f] : 0));
+        }
+
+        if (writer->overflow)
+        {
+            writer->size = save;
+            break;
+        }
+        written[j] = true;
+        count++;
+    }
+    writer->overflow = false;
+    writer->data[count_at] = count & 0xFF;
+    writer->data[count_at + 1] = (count >> 8) & 0xFF;
+
+    // merge what the client will end up with, both lists are sorted so the result is too
+    sent->tick = current->tick;
+    sent->entities->size = 0;
+    list_reserve(*sent->entities, base->size + now->size);
+    EntityState *out = sent->entities->data;
+    Int size = 0;
+    Int i = 0, j = 0;
+    while (i < base->size || j < now->size)
+    {
+        if (j >= now->size || (i < base->size && base->data[i].id < now->data[j].id))
+        {
+            if (!removed[i])
+                out[size++] = base->data[i];
+            i++;
+        }
+        else if (i >= base->size || now->data[j].id < base->data[i].id)
+        {
+            if (written[j])
+                out[size++] = now->data[j];
+            j++;
+        }
+        else
+        {
+            out[size++] = written[j] ? now->data[j] : base->data[i];
+            i++;
+            j++;
+        }
+    }
+    sent->entities->size = size;
+
+    free(removed);
+    free(written);
+    free(old_index);
+}
+
+// entity i of world goes in as index i
+void build_interest_grid(NetSnapshot *world, SpatialHash *grid)
+{
+    spatial_hash_clear(grid);
+    for (Int i = 0; i < world->entities->size; i++)
+    {
+        EntityState *state = &world->entities->data[i];
+        Vector3 position = {dequantize_position(state->fields[FIELD_POSITION_X]), dequantize_position(state->fields[FIELD_POSITION_Y]),
+            dequantize_position(state->fields[FIELD_POSITION_Z])};
+        spatial_hash_insert(grid, i, position);
+    }
+    spatial_hash_build(grid);
+}
+
+typedef struct
+{
+    float distance;
+    Int index;
+} InterestCandidate;
+
+static int compare_candidates(const void *a, const void *b)
+{
+    const InterestCandidate *x = a, *y = b;
+    if (x->distance != y->distance)
+        return (x->distance > y->distance) - (x->distance < y->distance);
+
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+static Int update_interval(float distance)
+{
+    return distance < NET_NEAR_DISTANCE ? 1 : distance < NET_MID_DISTANCE ? NET_MID_INTERVAL : NET_FAR_INTERVAL;
+}
+
+// the part of world a client gets this tick, around its own creature:
+// entities that are not due this tick keep their baseline state, so they cost nothing in the delta,
+// entities that left the radius are not in the view, so the delta removes them;
+// order gets the view indexes by update interval, own entity first, for write_snapshot
+void build_client_view(NetSnapshot *world, SpatialHash *grid, Int own_id, NetSnapshot *baseline, NetSnapshot *view, IntList *order)
+{
+    view->tick = world->tick;
+    view->entities->size = 0;
+    order->size = 0;
+
+    EntityState *own = find_entity(world->entities, own_id);
+    if (own == NULL)
+        return;
+
+    Vector3 center = {dequantize_position(own->fields[FIELD_POSITION_X]), dequantize_position(own->fields[FIELD_POSITION_Y]),
+        dequantize_position(own->fields[FIELD_POSITION_Z])};
+    spatial_hash_query(grid, center, NET_INTEREST_RADIUS, order);
+
+    InterestCandidate *candidates = (InterestCandidate*)malloc(sizeof(InterestCandidate) * (order->size + 1));
+    for (Int i = 0; i < order->size; i++)
+    {
+        EntityState *state = &world->entities->data[order->data[i]];
+        Vector3 position = {dequantize_position(state->fields[FIELD_POSITION_X]), dequantize_position(state->fields[FIELD_POSITION_Y]),
+            dequantize_position(state->fields[FIELD_POSITION_Z])};
+        // the own creature always makes the cut
+        candidates[i].distance = state->id == own_id ? -1 : Vector3Distance(center, position);
+        candidates[i].index = order->data[i];
+    }
+
+    // only a crowd needs sorting, to keep the nearest
+    Int count = order->size;
+    if (count > NET_MAX_RELEVANT)
+    {
+        qsort(candidates, count, sizeof(InterestCandidate), compare_candidates);
+        count = NET_MAX_RELEVANT;
+    }
+
+    // update interval of every world entity in the view, 0 for the rest;
+    // walking it in world order gives the view sorted by id without sorting it
+    unsigned char *intervals = (unsigned char*)calloc(world->entities->size + count + 1, 1);
+    unsigned char *view_intervals = intervals + world->entities->size;
+    for (Int i = 0; i < count; i++)
+        intervals[candidates[i].index] = update_interval(candidates[i].distance);
+
+    list_reserve(*view->entities, count);
+    EntityStateList *base = baseline != NULL ? baseline->entities : NULL;
+    Int own_index = 0;
+    for (Int i = 0, b = 0; i < world->entities->size; i++)
+    {
+        if (intervals[i] == 0)
+            continue;
+
+        EntityState *state = &world->entities->data[i];
+        // staggered by id, so the far entities do not all update on the same tick
+        bool due = (world->tick + state->id) % intervals[i] == 0;
+        EntityState *old = NULL;
+        while (base != NULL && b < base->size && base->data[b].id < state->id)
+            b++;
+
+        if (!due && base != NULL && b < base->size && base->data[b].id == state->id)
+            old = &base->data[b];
+
+        if (state->id == own_id)
+            own_index = view->entities->size;
+
+        view_intervals[view->entities->size] = intervals[i];
+        view->entities->data[view->entities->size++] = old != NULL ? *old : *state;
+    }
+
+    // what updates more often goes first, if the packet runs out it is the far ones that wait
+    static const unsigned char tiers[] = {1, NET_MID_INTERVAL, NET_FAR_INTERVAL};
+    order->size = 0;
+    list_push(*order, own_index);
+    for (Int t = 0; t < 3; t++)
+    {
+        for (Int v = 0; v < view->entities->size; v++)
+        {
+            if (view_intervals[v] == tiers[t] && v != own_index)
+                list_push(*order, v);
+        }
+    }
+
+    free(intervals);
+    free(candidates);
+}
+
+bool read_snapshot_header(PacketReader *reader, unsigned int *tick, unsigned int *baseline_tick, Int *own_id)
+{
+    if (read_u8(reader) != PACKET_SNAPSHOT)
+        return false;
+
+    *tick = read_u32(reader);
+    *baseline_tick = read_u32(reader);
+    *own_id = (Int)read_varint(reader) - 1;
+    return !reader->error;
+}
+
+// baseline is NULL when the header says NET_NO_BASELINE, out must not be the baseline
+bool read_snapshot(PacketReader *reader, NetSnapshot *baseline, unsigned int tick, NetSnapshot *out)
+{
+    if (baseline != NULL)
+        net_snapshot_copy(out, baseline);
+    else
+        out->entities->size = 0;
+
+    out->tick = tick;
+    EntityStateList *entities = out->entities;
+
+    // removed entities are marked and compacted at the end, so the list stays sorted for find_entity meanwhile
+    Int removed_count = read_u16(reader);
+    for (Int i = 0; i < removed_count && !reader->error; i++)
+    {
+        EntityState *state = find_entity(entities, read_varint(reader));
+        if (state != NULL)
+            state->type = -1;
+    }
+
+    Int base_size = entities->size;
+    Int update_count = read_u16(reader);
+    for (Int i = 0; i < update_count && !reader->error; i++)
+    {
+        Int id = read_varint(reader);
+        unsigned int mask = read_u8(reader);
+        EntityState *state;
+        if (mask & FIELD_NEW)
+        {
+            EntityState fresh = {0};
+            fresh.id = id;
+            fresh.type = read_u8(reader);
+            list_push(*entities, fresh);
+            state = &entities->data[entities->size - 1];
+        }
+        else
+        {
+            // only the baseline part is sorted
+            EntityStateList sorted = {entities->data, base_size, base_size};
+            state = find_entity(&sorted, id);
+            if (state == NULL)
+            {
+                reader->error = true;
+                break;
+            }
+        }
+
+        for (int f = 0; f < FIELD_COUNT; f++)
+        {
+            if (mask & (1 << f))
+                state->fields[f] += read_zigzag(reader);
+        }
+    }
+
+    Int size = 0;
+    for (Int i = 0; i < entities->size; i++)
+    {
+        if (entities->data[i].type != -1)
+            entities->data[size++] = entities->data[i];
+    }
+    entities->size = size;
+    qsort(entities->data, entities->size, sizeof(EntityState), compare_entities);
+    return !reader->error;
+}
+
+void write_input(PacketWriter *writer, InputCommand *input)
+{
+    write_u8(writer, PACKET_INPUT);
+    write_u32(writer, input->tick);
+    write_u32(writer, input->ack);
+    write_u8(writer, (unsigned char)input->move_x);
+    write_u8(writer, (unsigned char)input->move_z);
+    write_u16(writer, (unsigned short)input->yaw);
+    write_u16(writer, (unsigned short)input->pitch);
+    write_u8(writer, input->buttons);
+    write_u8(writer, (unsigned char)input->wheel);
+}
+
+bool read_input(PacketReader *reader, InputCommand *input)
+{
+    if (read_u8(reader) != PACKET_INPUT)
+        return false;
+
+    input->tick = read_u32(reader);
+    input->ack = read_u32(reader);
+    input->move_x = (signed char)read_u8(reader);
+    input->move_z = (signed char)read_u8(reader);
+    input->yaw = (short)read_u16(reader);
+    input->pitch = (short)read_u16(reader);
+    input->buttons = read_u8(reader);
+    input->wheel = (signed char)read_u8(reader);
+    return !reader->error;
+}
+
+// port 0 picks any free port
+int net_open(int port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(sock, (struct sockaddr*)&address, sizeof(address)) < 0)
+    {
+        perror("bind");
+        close(sock);
+        return -1;
+    }
+
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    return sock;
+}
+
+void net_close(int sock)
+{
+    close(sock);
+}
+
+bool net_send(int sock, struct sockaddr_in *address, PacketWriter *writer)
+{
+    return sendto(sock, writer->data, writer->size, 0, (struct sockaddr*)address, sizeof(*address)) == writer->size;
+}
+
+// bytes read, 0 when there is nothing to read
+Int net_receive(int sock, struct sockaddr_in *address, unsigned char *buffer, Int size)
+{
+    socklen_t length = sizeof(*address);
+    ssize_t received = recvfrom(sock, buffer, size, 0, (struct sockaddr*)address, &length);
+    return received < 0 ? 0 : received;
+}
+
+struct sockaddr_in net_address(const char *host, int port)
+{
+    struct sockaddr_in address = {0};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &address.sin_addr) != 1)
+    {
+        struct addrinfo hints = {0}, *result = NULL;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_DGRAM;
+        if (getaddrinfo(host, NULL, &hints, &result) == 0 && result != NULL)
+        {
+            address.sin_addr = ((struct sockaddr_in*)result->ai_addr)->sin_addr;
+            freeaddrinfo(result);
+        }
+    }
+    return address;
+}
@@ -0,0 +1,1079 @@
+#include "save.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifndef __EMSCRIPTEN__
+#include <sys/wait.h>
+#endif
+
+#define SAVE_BUFFER (64 * 1024)
+
+// buffered writes straight to the file descriptor, nothing is allocated so it is safe in a forked child
+typedef struct
+{
+    int fd;
+    uint64_t written;
+    bool error;
+    Int size;
+    unsigned char buffer[SAVE_BUFFER];
+} SaveWriter;
+
+// autosave state, one per process like the background save
+typedef struct
+{
+    int fd; // journal being appended to, -1 while autosave is off
+    char path[1024]; // the autosave snapshot
+    char journal_path[1024]; // path.journal
+    uint64_t sequence; // of the last entry appended
+    uint64_t folding; // last entry the running compaction folds into its snapshot
+    uint64_t bytes; // journal file size
+    uint64_t snapshot_bytes;
+    double last; // sys->time of the last entry
+    bool rebase; // the world was replaced by a load, the journal has to start over on a new snapshot
+    unsigned char *buffer; // entry being built, grows to the biggest one
+    uint64_t size;
+    uint64_t capacity;
+} Journal;
+
+static Journal journal = {.fd = -1};
+
+static bool write_all(int fd, const void *data, uint64_t size)
+{
+    const unsigned char *bytes = data;
+    while (size > 0)
+    {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0)
+        {
+            if (errno != EINTR)
+                return false;
+            continue;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+static void save_flush(SaveWriter *writer)
+{
+    if (!writer->error && !write_all(writer->fd, writer->buffer, writer->size))
+        writer->error = true;
+
+    writer->size = 0;
+}
+
+static void save_write(SaveWriter *writer, const void *data, Int size)
+{
+    const unsigned char *bytes = data;
+    while (size > 0)
+    {
+        Int room = SAVE_BUFFER - writer->size;
+        Int chunk = size < room ? size : room;
+        memcpy(writer->buffer + writer->size, bytes, chunk);
+        writer->size += chunk;
+        writer->written += chunk;
+        bytes += chunk;
+        size -= chunk;
+        if (writer->size == SAVE_BUFFER)
+            save_flush(writer);
+    }
+}
+
+static uint64_t save_align(uint64_t offset)
+{
+    return (offset + SAVE_ALIGN - 1) & ~(uint64_t)(SAVE_ALIGN - 1);
+}
+
+static void save_pad(SaveWriter *writer)
+{
+    static const unsigned char zeros[SAVE_ALIGN] = {0};
+    save_write(writer, zeros, save_align(writer->written) - writer->written);
+}
+
+// one pass over the creatures per field, then the padding up to the next section
+#define save_creature_field(writer, sys, type, expression) do { \
+    for (Int i = 0; i < (sys)->world.creatures->size; i++) \
+    { \
+        Creature *c = (sys)->world.creatures->data[i]; \
+        type value = (expression); \
+        save_write(writer, &value, sizeof(type)); \
+    } \
+    save_pad(writer); \
+} while (0)
+
+#define save_bullet_field(writer, sys, type, expression) do { \
+    for (Int i = 0; i < (sys)->world.bullets->size; i++) \
+    { \
+        Bullet *b = (sys)->world.bullets->data[i]; \
+        type value = (expression); \
+        save_write(writer, &value, sizeof(type)); \
+    } \
+    save_pad(writer); \
+} while (0)
+
+static SaveItem save_item(Item *item)
+{
+    return (SaveItem){item->position, item->type, item->capacity, item->content_type, item->content};
+}
+
+static const char* current_map_name(InternalSystem* sys)
+{
+    if (sys->current_map >= 0 && sys->current_map < sys->maps->size && sys->maps->data[sys->current_map].name != NULL)
+        return sys->maps->data[sys->current_map].name;
+
+    return "";
+}
+
+// writes path.tmp and renames it over path, so a crash never leaves half a save behind;
+// nothing here allocates or prints, world_save_async runs it in a forked child
+bool world_save(InternalSystem* sys, const char* path)
+{
+    // every size is known up front, so the header and section table go out first
+    const char *map_name = current_map_name(sys);
+    uint64_t strings = 1 + strlen(map_name) + 1;
+    uint64_t inventory = 0;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        strings += strlen(creature(i).name) + 1;
+        inventory += creature(i).inventory.size;
+    }
+
+    uint64_t creatures = sys->world.creatures->size;
+    uint64_t bullets = sys->world.bullets->size;
+    SaveSection sections[SECTION_COUNT] =
+    {
+        {SECTION_META, sizeof(SaveMeta), 1, 0},
+        {SECTION_STRINGS, 1, strings, 0},
+        {SECTION_CREATURE_ID, sizeof(int64_t), creatures, 0},
+        {SECTION_CREATURE_NAME, sizeof(uint32_t), creatures, 0},
+        {SECTION_CREATURE_POSITION, sizeof(Vector3), creatures, 0},
+        {SECTION_CREATURE_SIZE, sizeof(Vector3), creatures, 0},
+        {SECTION_CREATURE_ROTATION, sizeof(Vector3), creatures, 0},
+        {SECTION_CREATURE_DIRECTION, sizeof(Vector3), creatures, 0},
+        {SECTION_CREATURE_COLOR, sizeof(Color), creatures, 0},
+        {SECTION_CREATURE_SPEED, sizeof(double), creatures, 0},
+        {SECTION_CREATURE_CURRENT_ITEM, sizeof(int32_t), creatures, 0},
+        {SECTION_CREATURE_STATUS, sizeof(int32_t), creatures, 0},
+        {SECTION_CREATURE_TARGET, sizeof(int64_t), creatures, 0},
+        {SECTION_CREATURE_ITEMS, sizeof(SaveRange), creatures, 0},
+        {SECTION_INVENTORY, sizeof(SaveItem), inventory, 0},
+        {SECTION_WORLD_ITEMS, sizeof(SaveItem), sys->world.items->size, 0},
+        {SECTION_BULLET_ID, sizeof(int64_t), bullets, 0},
+        {SECTION_BULLET_POSITION, sizeof(Vector3), bullets, 0},
+        {SECTION_BULLET_DIRECTION, sizeof(Vector3), bullets, 0},
+        {SECTION_BULLET_SPEED, sizeof(double), bullets, 0},
+        {SECTION_BULLET_ORIGIN, sizeof(Vector3), bullets, 0},
+    };
+
+    uint64_t offset = save_align(sizeof(SaveHeader) + sizeof(sections));
+    for (Int s = 0; s < SECTION_COUNT; s++)
+    {
+        sections[s].offset = offset;
+        offset = save_align(offset + sections[s].element_size * sections[s].count);
+    }
+
+    SaveHeader header = {0};
+    memcpy(header.magic, SAVE_MAGIC, 4);
+    header.version = SAVE_VERSION;
+    header.section_count = SECTION_COUNT;
+    header.endian = SAVE_ENDIAN;
+    header.file_size = offset;
+
+    char temp[1024];
+    if (snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int)sizeof(temp))
+        return false;
+
+    SaveWriter writer;
+    writer.fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    writer.written = 0;
+    writer.size = 0;
+    writer.error = writer.fd < 0;
+    if (writer.error)
+        return false;
+
+    save_write(&writer, &header, sizeof(header));
+    save_write(&writer, sections, sizeof(sections));
+    save_pad(&writer);
+
+    // in a compaction child this is the last entry appended before the fork
+    SaveMeta meta = {sys->time, sys->world.next_id, sys->player_index, 1, 0, journal.sequence};
+    save_write(&writer, &meta, sizeof(meta));
+    save_pad(&writer);
+
+    save_write(&writer, "", 1);
+    save_write(&writer, map_name, strlen(map_name) + 1);
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+        save_write(&writer, creature(i).name, strlen(creature(i).name) + 1);
+    save_pad(&writer);
+
+    save_creature_field(&writer, sys, int64_t, c->id);
+    // same order as the string table above
+    uint32_t name = 1 + strlen(map_name) + 1;
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        save_write(&writer, &name, sizeof(name));
+        name += strlen(creature(i).name) + 1;
+    }
+    save_pad(&writer);
+
+    save_creature_field(&writer, sys, Vector3, c->position);
+    save_creature_field(&writer, sys, Vector3, c->size);
+    save_creature_field(&writer, sys, Vector3, c->rotation);
+    save_creature_field(&writer, sys, Vector3, c->direction);
+    save_creature_field(&writer, sys, Color, c->color);
+    save_creature_field(&writer, sys, double, c->speed);
+    save_creature_field(&writer, sys, int32_t, c->current_item);
+    save_creature_field(&writer, sys, int32_t, c->status);
+    save_creature_field(&writer, sys, int64_t, c->target_id);
+
+    SaveRange range = {0, 0};
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        range.start += range.count;
+        range.count = creature(i).inventory.size;
+        save_write(&writer, &range, sizeof(range));
+    }
+    save_pad(&writer);
+
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        for (Int j = 0; j < creature(i).inventory.size; j++)
+        {
+            SaveItem item = save_item(&small_list_get(creature(i).inventory, j));
+            save_write(&writer, &item, sizeof(item));
+        }
+    }
+    save_pad(&writer);
+
+    for (Int i = 0; i < sys->world.items->size; i++)
+    {
+        SaveItem item = save_item(sys->world.items->data[i]);
+        save_write(&writer, &item, sizeof(item));
+    }
+    save_pad(&writer);
+
+    save_bullet_field(&writer, sys, int64_t, b->id);
+    save_bullet_field(&writer, sys, Vector3, b->position);
+    save_bullet_field(&writer, sys, Vector3, b->direction);
+    save_bullet_field(&writer, sys, double, b->speed);
+    save_bullet_field(&writer, sys, Vector3, b->origin);
+
+    save_flush(&writer);
+    bool ok = !writer.error && writer.written == header.file_size && fsync(writer.fd) == 0;
+    ok = close(writer.fd) == 0 && ok;
+    if (!ok || rename(temp, path) != 0)
+    {
+        unlink(temp);
+        return false;
+    }
+    return true;
+}
+
+static int save_result = SAVE_IDLE;
+#ifndef __EMSCRIPTEN__
+static pid_t save_pid = -1;
+static bool save_compaction; // the running child is an autosave compaction, not reported by world_save_status
+#endif
+
+static void journal_fold(void);
+
+static void save_finished(bool ok, bool compaction)
+{
+    if (!compaction)
+        save_result = ok ? SAVE_DONE : SAVE_FAILED;
+    else if (ok)
+        journal_fold();
+}
+
+// the child sees the world exactly as it was at the fork (copy on write) and writes it while the game goes on,
+// the caller only pays for the fork; false if a save is still running or there is no child;
+// the web build has no fork and saves right away
+static bool save_start(InternalSystem* sys, const char* path, bool compaction)
+{
+#ifdef __EMSCRIPTEN__
+    save_finished(world_save(sys, path), compaction);
+    return true;
+#else
+    if (save_pid > 0)
+        return false;
+
+    pid_t pid = fork();
+    if (pid < 0)
+        return false;
+
+    if (pid == 0)
+        _exit(world_save(sys, path) ? 0 : 1);
+
+    save_pid = pid;
+    save_compaction = compaction;
+    return true;
+#endif
+}
+
+// collects the child once it is done, wait blocks until then
+static void save_reap(bool wait)
+{
+#ifndef __EMSCRIPTEN__
+    if (save_pid <= 0)
+        return;
+
+    int status = 0;
+    pid_t done;
+    do
+        done = waitpid(save_pid, &status, wait ? 0 : WNOHANG);
+    while (done < 0 && errno == EINTR);
+
+    if (done == 0)
+        return;
+
+    save_pid = -1;
+    save_finished(done > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0, save_compaction);
+#endif
+}
+
+bool world_save_async(InternalSystem* sys, const char* path)
+{
+    return save_start(sys, path, false);
+}
+
+// SAVE_DONE and SAVE_FAILED are reported once, SAVE_IDLE after that
+int world_save_status(void)
+{
+    save_reap(false);
+#ifndef __EMSCRIPTEN__
+    if (save_pid > 0 && !save_compaction)
+        return SAVE_RUNNING;
+#endif
+    int result = save_result;
+    save_result = SAVE_IDLE;
+    return result;
+}
+
+// the whole file mapped read only, NULL if it can't be opened or is empty
+static const unsigned char* map_file(const char* path, uint64_t *size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    *size = info.st_size;
+    const unsigned char *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    madvise((void*)data, *size, MADV_SEQUENTIAL);
+    return data;
+}
+
+// the section of that type, NULL if it is missing, has another element size or does not fit in the file
+static const void* load_section(const unsigned char *data, const SaveHeader *header, uint32_t type, uint32_t element_size, uint64_t *count)
+{
+    const SaveSection *sections = (const SaveSection*)(data + sizeof(SaveHeader));
+    for (uint32_t s = 0; s < header->section_count; s++)
+    {
+        if (sections[s].type != type)
+            continue;
+
+        if (sections[s].element_size != element_size || sections[s].offset > header->file_size ||
+            sections[s].count > (header->file_size - sections[s].offset) / element_size)
+            return NULL;
+
+        *count = sections[s].count;
+        return data + sections[s].offset;
+    }
+    return NULL;
+}
+
+static void clear_world(InternalSystem* sys)
+{
+    while (sys->world.creatures->size > 0)
+        kill_creature(sys, sys->world.creatures->size - 1);
+
+    while (sys->world.bullets->size > 0)
+        remove_bullet(sys, sys->world.bullets->size - 1);
+
+    for (Int i = 0; i < sys->world.items->size; i++)
+        slab_release(*sys->world.item_slab, sys->world.items->data[i]);
+
+    sys->world.items->size = 0;
+}
+
+static Item load_item(const SaveItem *saved)
+{
+    Item item = make_item(NULL, saved->type, saved->capacity, saved->content_type, saved->content);
+    item.position = saved->position;
+    return item;
+}
+
+// the file is mapped and checked as a whole before the world is touched, a bad file leaves the world as it was
+static bool load_snapshot(InternalSystem* sys, const char* path, uint64_t *journal_sequence)
+{
+    uint64_t file_size = 0;
+    const unsigned char *data = map_file(path, &file_size);
+    if (data == NULL)
+        return false;
+
+    const SaveHeader *header = (const SaveHeader*)data;
+    bool ok = file_size >= sizeof(SaveHeader) && memcmp(header->magic, SAVE_MAGIC, 4) == 0 && header->version == SAVE_VERSION && header->endian == SAVE_ENDIAN &&
+        header->file_size == file_size && header->section_count <= (file_size - sizeof(SaveHeader)) / sizeof(SaveSection);
+
+    uint64_t counts[SECTION_COUNT] = {0};
+    const void *sections[SECTION_COUNT] = {0};
+    static const uint32_t sizes[SECTION_COUNT] =
+    {
+        sizeof(SaveMeta), 1, sizeof(int64_t), sizeof(uint32_t), sizeof(Vector3), sizeof(Vector3), sizeof(Vector3), sizeof(Vector3),
+        sizeof(Color), sizeof(double), sizeof(int32_t), sizeof(int32_t), sizeof(int64_t), sizeof(SaveRange), sizeof(SaveItem), sizeof(SaveItem),
+        sizeof(int64_t), sizeof(Vector3), sizeof(Vector3), sizeof(double), sizeof(Vector3),
+    };
+    for (Int s = 0; s < SECTION_COUNT && ok; s++)
+    {
+        sections[s] = load_section(data, header, s, sizes[s], &counts[s]);
+        ok = sections[s] != NULL;
+    }
+
+    uint64_t creatures = counts[SECTION_CREATURE_ID];
+    uint64_t bullets = counts[SECTION_BULLET_ID];
+    for (Int s = SECTION_CREATURE_ID; s <= SECTION_CREATURE_ITEMS && ok; s++)
+        ok = counts[s] == creatures;
+
+    for (Int s = SECTION_BULLET_ID; s <= SECTION_BULLET_ORIGIN && ok; s++)
+        ok = counts[s] == bullets;
+
+    const char *strings = sections[SECTION_STRINGS];
+    const SaveMeta *meta = sections[SECTION_META];
+    const uint32_t *names = sections[SECTION_CREATURE_NAME];
+    const SaveRange *ranges = sections[SECTION_CREATURE_ITEMS];
+    ok = ok && counts[SECTION_META] == 1 && counts[SECTION_STRINGS] > 0 && strings[counts[SECTION_STRINGS] - 1] == '\0' &&
+        meta->map_name < counts[SECTION_STRINGS];
+
+    // every string and inventory has to be inside its section
+    for (uint64_t i = 0; i < creatures && ok; i++)
+    {
+        ok = names[i] < counts[SECTION_STRINGS] && ranges[i].start <= counts[SECTION_INVENTORY] && ranges[i].count <= counts[SECTION_INVENTORY] - ranges[i].start;
+    }
+
+    if (!ok)
+    {
+        munmap((void*)data, file_size);
+        return false;
+    }
+
+    clear_world(sys);
+    reserve_world(sys, creatures, bullets);
+
+    const int64_t *ids = sections[SECTION_CREATURE_ID];
+    const Vector3 *positions = sections[SECTION_CREATURE_POSITION];
+    const Vector3 *creature_sizes = sections[SECTION_CREATURE_SIZE];
+    const Vector3 *rotations = sections[SECTION_CREATURE_ROTATION];
+    const Vector3 *directions = sections[SECTION_CREATURE_DIRECTION];
+    const Color *colors = sections[SECTION_CREATURE_COLOR];
+    const double *speeds = sections[SECTION_CREATURE_SPEED];
+    const int32_t *current_items = sections[SECTION_CREATURE_CURRENT_ITEM];
+    const int32_t *statuses = sections[SECTION_CREATURE_STATUS];
+    const int64_t *targets = sections[SECTION_CREATURE_TARGET];
+    const SaveItem *inventory = sections[SECTION_INVENTORY];
+    for (uint64_t i = 0; i < creatures; i++)
+    {
+        Creature *c = sys->world.creatures->data[new_creature(sys, (char*)strings + names[i], 0, 0, 0)];
+        c->id = ids[i];
+        c->position = positions[i];
+        c->size = creature_sizes[i];
+        c->rotation = rotations[i];
+        c->direction = directions[i];
+        c->color = colors[i];
+        c->speed = speeds[i];
+        c->status = statuses[i];
+        c->target_id = targets[i];
+        for (uint32_t j = 0; j < ranges[i].count; j++)
+            inventory_add(c, load_item(&inventory[ranges[i].start + j]));
+
+        c->current_item = Clamp(current_items[i], 0, c->inventory.size > 0 ? c->inventory.size - 1 : 0);
+    }
+
+    const SaveItem *world_items = sections[SECTION_WORLD_ITEMS];
+    for (uint64_t i = 0; i < counts[SECTION_WORLD_ITEMS]; i++)
+    {
+        Item *item = slab_alloc(*sys->world.item_slab);
+        *item = load_item(&world_items[i]);
+        list_push(*sys->world.items, item);
+    }
+
+    const int64_t *bullet_ids = sections[SECTION_BULLET_ID];
+    const Vector3 *bullet_positions = sections[SECTION_BULLET_POSITION];
+    const Vector3 *bullet_directions = sections[SECTION_BULLET_DIRECTION];
+    const double *bullet_speeds = sections[SECTION_BULLET_SPEED];
+    const Vector3 *bullet_origins = sections[SECTION_BULLET_ORIGIN];
+    for (uint64_t i = 0; i < bullets; i++)
+    {
+        Bullet *b = new_bullet(sys, bullet_positions[i], bullet_directions[i], bullet_speeds[i]);
+        b->id = bullet_ids[i];
+        b->origin = bullet_origins[i];
+    }
+
+    sys->world.next_id = meta->next_id;
+    sys->time = meta->time;
+    set_player(sys, meta->player_index >= 0 && (uint64_t)meta->player_index < creatures ? meta->player_index : -1);
+    for (Int m = 0; m < sys->maps->size; m++)
+    {
+        if (sys->maps->data[m].name != NULL && strcmp(sys->maps->data[m].name, strings + meta->map_name) == 0)
+            sys->current_map = m;
+    }
+
+    *journal_sequence = meta->journal_sequence;
+    munmap((void*)data, file_size);
+    return true;
+}
+
+bool world_load(InternalSystem* sys, const char* path)
+{
+    profile_zone("world_load");
+    uint64_t journal_sequence;
+    if (!load_snapshot(sys, path, &journal_sequence))
+        return false;
+
+    // the journal was about the world that is gone
+    clear_dirty(sys);
+    if (journal.fd >= 0)
+        journal.rebase = true;
+
+    return true;
+}
+
+static uint64_t journal_checksum(const unsigned char *data, uint64_t size)
+{
+    uint64_t hash = 14695981039346656037UL;
+    for (uint64_t i = 0; i < size; i++)
+        hash = (hash ^ data[i]) * 1099511628211UL;
+    return hash;
+}
+
+static void journal_put(const void *data, uint64_t size)
+{
+    if (journal.size + size > journal.capacity)
+    {
+        while (journal.size + size > journal.capacity)
+            journal.capacity = journal.capacity == 0 ? SAVE_BUFFER : journal.capacity * 2;
+
+        journal.buffer = realloc(journal.buffer, journal.capacity);
+    }
+    memcpy(journal.buffer + journal.size, data, size);
+    journal.size += size;
+}
+
+static bool journal_header_valid(const unsigned char *data, uint64_t size)
+{
+    JournalHeader header;
+    if (size < sizeof(header))
+        return false;
+
+    memcpy(&header, data, sizeof(header));
+    return memcmp(header.magic, JOURNAL_MAGIC, 4) == 0 && header.version == JOURNAL_VERSION && header.endian == SAVE_ENDIAN;
+}
+
+// the entry at *offset and moves past it, false at the end of the journal or at a damaged (half written) entry
+static bool journal_next(const unsigned char *data, uint64_t size, uint64_t *offset, JournalEntry *entry)
+{
+    if (size - *offset < sizeof(JournalEntry))
+        return false;
+
+    memcpy(entry, data + *offset, sizeof(JournalEntry));
+    if (entry->size > size - *offset - sizeof(JournalEntry) || journal_checksum(data + *offset + sizeof(JournalEntry), entry->size) != entry->checksum)
+        return false;
+
+    *offset += sizeof(JournalEntry) + entry->size;
+    return true;
+}
+
+// truncates the journal to just its header, the old entries go first:
+// a crash before the next snapshot is in place leaves the old snapshot alone, never with entries that are not about it
+static bool journal_create(void)
+{
+    int fd = open(journal.journal_path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0)
+        return false;
+
+    JournalHeader header = {0};
+    memcpy(header.magic, JOURNAL_MAGIC, 4);
+    header.version = JOURNAL_VERSION;
+    header.endian = SAVE_ENDIAN;
+    if (!write_all(fd, &header, sizeof(header)) || fsync(fd) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    if (journal.fd >= 0)
+        close(journal.fd);
+
+    journal.fd = fd;
+    journal.bytes = sizeof(header);
+    return true;
+}
+
+// a compaction snapshot landed with every entry up to journal.folding in it, the journal keeps only the ones after;
+// recovery skips the folded entries anyway, so if this fails the journal is just bigger than it needs to be
+static void journal_fold(void)
+{
+    struct stat info;
+    if (stat(journal.path, &info) == 0)
+        journal.snapshot_bytes = info.st_size;
+
+    uint64_t size = 0;
+    const unsigned char *data = map_file(journal.journal_path, &size);
+    if (data == NULL)
+        return;
+
+    char temp[1024 + 8];
+    snprintf(temp, sizeof(temp), "%s.tmp", journal.journal_path);
+    int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    bool ok = fd >= 0 && journal_header_valid(data, size) && write_all(fd, data, sizeof(JournalHeader));
+
+    uint64_t offset = sizeof(JournalHeader), bytes = sizeof(JournalHeader);
+    JournalEntry entry;
+    while (ok && journal_next(data, size, &offset, &entry))
+    {
+        if (entry.sequence <= journal.folding)
+            continue;
+
+        ok = write_all(fd, data + offset - entry.size - sizeof(JournalEntry), sizeof(JournalEntry) + entry.size);
+        bytes += sizeof(JournalEntry) + entry.size;
+    }
+    munmap((void*)data, size);
+
+    if (ok && fsync(fd) == 0 && rename(temp, journal.journal_path) == 0)
+    {
+        close(journal.fd);
+        journal.fd = fd;
+        journal.bytes = bytes;
+        return;
+    }
+
+    if (fd >= 0)
+        close(fd);
+    unlink(temp);
+}
+
+// writes a new snapshot of the world as it is right now (on the calling thread) and journals on top of it from here on;
+// whatever autosave was at path before is replaced
+bool autosave_start(InternalSystem* sys, const char* path)
+{
+    // a compaction still running would rename its snapshot over the new one
+    save_reap(true);
+    char snapshot[1024];
+    if (snprintf(snapshot, sizeof(snapshot), "%s", path) >= (int)sizeof(snapshot) ||
+        snprintf(journal.journal_path, sizeof(journal.journal_path), "%s.journal", path) >= (int)sizeof(journal.journal_path))
+        return false;
+
+    memcpy(journal.path, snapshot, sizeof(snapshot));
+    journal.sequence = 0;
+    if (!journal_create() || !world_save(sys, path))
+    {
+        autosave_stop(sys, false);
+        return false;
+    }
+
+    struct stat info;
+    journal.snapshot_bytes = stat(path, &info) == 0 ? info.st_size : 0;
+    journal.last = sys->time;
+    journal.rebase = false;
+    sys->world.track_changes = true;
+    clear_dirty(sys);
+    return true;
+}
+
+// remove deletes the snapshot and the journal too, for a clean exit: the autosave is only there for crashes
+void autosave_stop(InternalSystem* sys, bool remove)
+{
+    save_reap(true);
+    if (journal.fd >= 0)
+    {
+        close(journal.fd);
+        journal.fd = -1;
+        if (remove)
+        {
+            unlink(journal.path);
+            unlink(journal.journal_path);
+        }
+    }
+
+    sys->world.track_changes = false;
+    clear_dirty(sys);
+    free(journal.buffer);
+    journal.buffer = NULL;
+    journal.size = 0;
+    journal.capacity = 0;
+}
+
+// one entry with every creature marked dirty, every removal, the bullets and the world items,
+// false if autosave is off or the entry could not be written (the next autosave then starts over)
+bool journal_append(InternalSystem* sys)
+{
+    profile_zone("journal_append");
+    if (journal.fd < 0)
+        return false;
+
+    // the entry header goes in front, filled in once the payload is done
+    journal.size = 0;
+    JournalEntry entry = {0};
+    journal_put(&entry, sizeof(entry));
+
+    IntList *removed = sys->world.removed;
+    JournalMeta meta = {sys->time, sys->world.next_id, sys->player_index >= 0 ? creature(sys->player_index).id : -1,
+        removed->size, 0, sys->world.bullets->size, sys->world.items->size};
+    uint64_t meta_offset = journal.size;
+    journal_put(&meta, sizeof(meta));
+
+    for (Int i = 0; i < removed->size; i++)
+    {
+        int64_t id = removed->data[i];
+        journal_put(&id, sizeof(id));
+    }
+
+    for (Int w = 0; w < JOBS_MAX_WORKERS; w++)
+    {
+        CreatureList *dirty = sys->world.dirty[w];
+        for (Int i = 0; i < dirty->size; i++)
+        {
+            // killed since it was marked, or already written from another list
+            Creature *c = dirty->data[i];
+            if (!c->dirty)
+                continue;
+
+            c->dirty = false;
+            JournalCreature saved = {c->id, c->target_id, c->speed, c->position, c->size, c->rotation, c->direction, c->color,
+                c->current_item, c->status, strlen(c->name), c->inventory.size, 0};
+            journal_put(&saved, sizeof(saved));
+            journal_put(c->name, saved.name_length);
+            for (Int j = 0; j < c->inventory.size; j++)
+            {
+                SaveItem item = save_item(&small_list_get(c->inventory, j));
+                journal_put(&item, sizeof(item));
+            }
+            meta.creatures++;
+        }
+        dirty->size = 0;
+    }
+    removed->size = 0;
+    memcpy(journal.buffer + meta_offset, &meta, sizeof(meta));
+
+    for (Int i = 0; i < sys->world.bullets->size; i++)
+    {
+        JournalBullet saved = {bullet(i).id, bullet(i).position, bullet(i).direction, bullet(i).speed, bullet(i).origin, 0};
+        journal_put(&saved, sizeof(saved));
+    }
+
+    for (Int i = 0; i < sys->world.items->size; i++)
+    {
+        SaveItem item = save_item(sys->world.items->data[i]);
+        journal_put(&item, sizeof(item));
+    }
+
+    entry.sequence = journal.sequence + 1;
+    entry.size = journal.size - sizeof(entry);
+    entry.checksum = journal_checksum(journal.buffer + sizeof(entry), entry.size);
+    memcpy(journal.buffer, &entry, sizeof(entry));
+
+    journal.last = sys->time;
+    if (!write_all(journal.fd, journal.buffer, journal.size) || fsync(journal.fd) != 0)
+    {
+        // whatever made it to the file fails its checksum and ends the replay there,
+        // the changes in it are gone from the dirty lists, so the next autosave writes a whole new snapshot
+        journal.rebase = true;
+        return false;
+    }
+
+    journal.sequence++;
+    journal.bytes += journal.size;
+    return true;
+}
+
+// call once per tick, an entry every AUTOSAVE_INTERVAL and a compaction when the journal grew too big
+void autosave(InternalSystem* sys)
+{
+    save_reap(false);
+    if (journal.fd < 0)
+        return;
+
+    if (journal.rebase)
+    {
+        char path[1024];
+        memcpy(path, journal.path, sizeof(path));
+        autosave_start(sys, path);
+        return;
+    }
+
+    if (sys->time - journal.last < AUTOSAVE_INTERVAL || !journal_append(sys))
+        return;
+
+    if (journal.bytes > AUTOSAVE_COMPACT_BYTES && journal.bytes > journal.snapshot_bytes / 2)
+    {
+        journal.folding = journal.sequence;
+        save_start(sys, journal.path, true);
+    }
+}
+
+// id to creature, open addressing, only alive while a journal is replayed
+typedef struct
+{
+    int64_t *ids;
+    Creature **creatures; // NULL for an empty slot
+    uint64_t mask;
+    uint64_t count;
+} IdTable;
+
+static uint64_t id_slot(IdTable *table, int64_t id)
+{
+    uint64_t hash = (uint64_t)id * 0x9E3779B97F4A7C15UL;
+    uint64_t slot = (hash ^ (hash >> 29)) & table->mask;
+    while (table->creatures[slot] != NULL && table->ids[slot] != id)
+        slot = (slot + 1) & table->mask;
+
+    return slot;
+}
+
+static void id_table_init(IdTable *table, uint64_t capacity)
+{
+    uint64_t size = 16;
+    while (size < capacity * 2)
+        size *= 2;
+
+    table->ids = malloc(sizeof(int64_t) * size);
+    table->creatures = calloc(size, sizeof(Creature*));
+    table->mask = size - 1;
+    table->count = 0;
+}
+
+static void id_table_put(IdTable *table, int64_t id, Creature *c)
+{
+    if ((table->count + 1) * 2 > table->mask + 1)
+    {
+        IdTable bigger;
+        id_table_init(&bigger, table->mask + 1);
+        for (uint64_t i = 0; i <= table->mask; i++)
+        {
+            if (table->creatures[i] != NULL)
+                id_table_put(&bigger, table->ids[i], table->creatures[i]);
+        }
+        free(table->ids);
+        free(table->creatures);
+        *table = bigger;
+    }
+
+    uint64_t slot = id_slot(table, id);
+    if (table->creatures[slot] == NULL)
+        table->count++;
+
+    table->ids[slot] = id;
+    table->creatures[slot] = c;
+}
+
+typedef struct
+{
+    const unsigned char *data;
+    uint64_t size;
+    uint64_t position;
+} JournalReader;
+
+static bool journal_read(JournalReader *reader, void *out, uint64_t size)
+{
+    if (size > reader->size - reader->position)
+        return false;
+
+    if (out != NULL)
+        memcpy(out, reader->data + reader->position, size);
+
+    reader->position += size;
+    return true;
+}
+
+// every count in the payload has to match its size, checked before anything is applied
+static bool journal_entry_valid(const unsigned char *payload, uint64_t size)
+{
+    JournalReader reader = {payload, size, 0};
+    JournalMeta meta;
+    if (!journal_read(&reader, &meta, sizeof(meta)) || !journal_read(&reader, NULL, meta.removed * sizeof(int64_t)))
+        return false;
+
+    for (uint32_t i = 0; i < meta.creatures; i++)
+    {
+        JournalCreature saved;
+        if (!journal_read(&reader, &saved, sizeof(saved)) || !journal_read(&reader, NULL, saved.name_length) ||
+            !journal_read(&reader, NULL, (uint64_t)saved.item_count * sizeof(SaveItem)))
+            return false;
+    }
+
+    return journal_read(&reader, NULL, (uint64_t)meta.bullets * sizeof(JournalBullet)) &&
+        journal_read(&reader, NULL, (uint64_t)meta.items * sizeof(SaveItem)) && reader.position == size;
+}
+
+// removed creatures are only flagged (dirty, tracking is off during a replay) and swept once the whole journal is in
+// the reads here are not checked: the entry went through journal_entry_valid first, which walks the same layout,
+// so every read is known to fit; what would be left unset on a short read is zeroed anyway
+static void replay_entry(InternalSystem* sys, IdTable *table, const unsigned char *payload, uint64_t size, int64_t *player_id)
+{
+    JournalReader reader = {payload, size, 0};
+    JournalMeta meta = {0};
+    journal_read(&reader, &meta, sizeof(meta));
+    for (uint32_t i = 0; i < meta.removed; i++)
+    {
+        int64_t id = -1;
+        journal_read(&reader, &id, sizeof(id));
+        Creature *c = table->creatures[id_slot(table, id)];
+        if (c != NULL)
+            c->dirty = true;
+    }
+
+    for (uint32_t i = 0; i < meta.creatures; i++)
+    {
+        JournalCreature saved = {0};
+        journal_read(&reader, &saved, sizeof(saved));
+        char *name = strndup((const char*)reader.data + reader.position, saved.name_length);
+        journal_read(&reader, NULL, saved.name_length);
+
+        Creature *c = table->creatures[id_slot(table, saved.id)];
+        if (c == NULL)
+        {
+            // the list may grow, index it after the call
+            Int index = new_creature(sys, name, 0, 0, 0);
+            c = sys->world.creatures->data[index];
+            c->id = saved.id;
+            id_table_put(table, saved.id, c);
+        }
+        else if (strcmp(c->name, name) != 0)
+        {
+            free(c->name);
+            c->name = str_duplicate(name);
+        }
+        free(name);
+
+        c->position = saved.position;
+        c->size = saved.size;
+        c->rotation = saved.rotation;
+        c->direction = saved.direction;
+        c->color = saved.color;
+        c->speed = saved.speed;
+        c->status = saved.status;
+        c->target_id = saved.target_id;
+        c->inventory.size = 0;
+        array_index_by(small_list_data(c->inventory), c->inventory.size, .type, c->item_slots, ITEM_COUNT);
+        for (uint32_t j = 0; j < saved.item_count; j++)
+        {
+            SaveItem item = {0};
+            journal_read(&reader, &item, sizeof(item));
+            inventory_add(c, load_item(&item));
+        }
+        c->current_item = Clamp(saved.current_item, 0, c->inventory.size > 0 ? c->inventory.size - 1 : 0);
+    }
+
+    // bullets and world items are written whole every entry
+    while (sys->world.bullets->size > 0)
+        remove_bullet(sys, sys->world.bullets->size - 1);
+
+    for (uint32_t i = 0; i < meta.bullets; i++)
+    {
+        JournalBullet saved = {0};
+        journal_read(&reader, &saved, sizeof(saved));
+        Bullet *b = new_bullet(sys, saved.position, saved.direction, saved.speed);
+        b->id = saved.id;
+        b->origin = saved.origin;
+    }
+
+    for (Int i = 0; i < sys->world.items->size; i++)
+        slab_release(*sys->world.item_slab, sys->world.items->data[i]);
+
+    sys->world.items->size = 0;
+    for (uint32_t i = 0; i < meta.items; i++)
+    {
+        SaveItem saved = {0};
+        journal_read(&reader, &saved, sizeof(saved));
+        Item *item = slab_alloc(*sys->world.item_slab);
+        *item = load_item(&saved);
+        list_push(*sys->world.items, item);
+    }
+
+    sys->world.next_id = meta.next_id;
+    sys->time = meta.time;
+    *player_id = meta.player_id;
+}
+
+// every entry after sequence after, in order, up to the end of the journal or the first damaged entry
+static void journal_replay(InternalSystem* sys, const char* path, uint64_t after)
+{
+    uint64_t size = 0;
+    const unsigned char *data = map_file(path, &size);
+    if (data == NULL)
+        return;
+
+    if (!journal_header_valid(data, size))
+    {
+        munmap((void*)data, size);
+        return;
+    }
+
+    IdTable table;
+    id_table_init(&table, sys->world.creatures->size);
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+        id_table_put(&table, creature(i).id, &creature(i));
+
+    int64_t player_id = sys->player_index >= 0 ? creature(sys->player_index).id : -1;
+    uint64_t offset = sizeof(JournalHeader);
+    JournalEntry entry;
+    while (journal_next(data, size, &offset, &entry))
+    {
+        const unsigned char *payload = data + offset - entry.size;
+        if (entry.sequence <= after)
+            continue;
+
+        if (!journal_entry_valid(payload, entry.size))
+            break;
+
+        replay_entry(sys, &table, payload, entry.size, &player_id);
+    }
+    munmap((void*)data, size);
+    free(table.ids);
+    free(table.creatures);
+
+    // from the back, so the swaps only bring in creatures that were already looked at
+    for (Int i = sys->world.creatures->size - 1; i >= 0; i--)
+    {
+        if (creature(i).dirty)
+            kill_creature(sys, i);
+    }
+
+    sys->player_id = player_id;
+    resolve_player(sys);
+}
+
+// the autosave snapshot at path plus every journal entry written after it: the world as it was at the last entry before a crash
+bool world_recover(InternalSystem* sys, const char* path)
+{
+    profile_zone("world_recover");
+    char journal_path[1024 + 8];
+    snprintf(journal_path, sizeof(journal_path), "%s.journal", path);
+    save_reap(true);
+
+    bool tracking = sys->world.track_changes;
+    sys->world.track_changes = false;
+    uint64_t folded = 0;
+    bool ok = load_snapshot(sys, path, &folded);
+    if (ok)
+        journal_replay(sys, journal_path, folded);
+
+    sys->world.track_changes = tracking;
+    clear_dirty(sys);
+    if (ok && journal.fd >= 0)
+        journal.rebase = true;
+
+    return ok;
+}
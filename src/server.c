@@ -0,0 +1,702 @@
+// dedicated server: runs the world headless at TICK_RATE and replicates it to udp clients,
+// every client gets a delta snapshot per tick against the newest snapshot it acknowledged;
+// ./server [--port N] [--map path] [--creatures N] [--threads N] [--bots N] [--seconds S] [--verify] [--no-interest]
+// --bots starts N loopback clients on a thread of their own, for load testing;
+// --verify decodes every packet on the server and compares it with what the client should end up with;
+// --no-interest sends every entity to every client, for comparison
+#include "net.h"
+#include "ai.h"
+#include <pthread.h>
+#include <time.h>
+
+typedef struct
+{
+    bool connected;
+    struct sockaddr_in address;
+    Int creature_id; // entity id, changes on respawn
+    Int creature_index; // where it was last found, checked against the id before use (see client_creature)
+    NetSnapshot history[NET_HISTORY]; // what the client has after each sent snapshot, by tick % NET_HISTORY
+    unsigned int acked; // newest snapshot tick the client decoded, NET_NO_BASELINE for none
+    InputCommand input; // newest input received
+    unsigned char last_buttons; // buttons of the input applied on the last tick, fire is edge triggered
+    double last_heard;
+    long bytes_sent;
+    long packets_sent;
+    long full_snapshots; // sent without a baseline
+} Client;
+
+typedef struct
+{
+    int port;
+    char *map;
+    Int creatures; // non player creatures kept alive
+    Int threads;
+    Int bots;
+    double seconds; // 0 runs until killed
+    bool verify;
+    bool interest;
+} ServerOptions;
+
+static double now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// time this thread actually ran, the bots share the machine and a wall clock tick also counts their time slices
+static double cpu_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void sleep_until(double time)
+{
+    double wait = time - now_seconds();
+    if (wait > 0)
+    {
+        struct timespec sleep = {(time_t)wait, (long)((wait - (time_t)wait) * 1e9)};
+        nanosleep(&sleep, NULL);
+    }
+}
+
+// same generator as the bench, the bots use their own seed
+static float random_range(unsigned int *seed, float min, float max)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return min + (max - min) * ((*seed >> 8) & 0xFFFF) / 65535.0f;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// server
+
+static BoundingBox map_bounds;
+static unsigned int spawn_seed = 1;
+
+// somewhere inside the map, above everything, gravity puts it on the ground
+static Int spawn_creature(InternalSystem* sys, char* name)
+{
+    Int index = new_creature(sys, name,
+        random_range(&spawn_seed, map_bounds.min.x + 1, map_bounds.max.x - 1), map_bounds.max.y,
+        random_range(&spawn_seed, map_bounds.min.z + 1, map_bounds.max.z - 1));
+    return index;
+}
+
+static Int spawn_player(InternalSystem* sys)
+{
+    Int index = spawn_creature(sys, "player");
+    inventory_add(&creature(index), make_item("hand", ITEM_HAND, 0, 0, 0));
+    inventory_add(&creature(index), make_item("revolver", ITEM_REVOLVER, item_capacities[ITEM_REVOLVER], ITEM_BULLET_REVOLVER, 6));
+    inventory_add(&creature(index), make_item("bullet_revolver", ITEM_BULLET_REVOLVER, item_capacities[ITEM_BULLET_REVOLVER], 0, item_capacities[ITEM_BULLET_REVOLVER]));
+    creature(index).current_item = 1;
+    return index;
+}
+
+// creatures are swap removed, so the index is re-checked against the id and only searched for when it moved
+static Int client_creature(InternalSystem* sys, Client *client)
+{
+    client->creature_index = find_creature(sys, client->creature_id, client->creature_index);
+    return client->creature_index;
+}
+
+static void spawn_client(InternalSystem* sys, Client *client)
+{
+    client->creature_index = spawn_player(sys);
+    client->creature_id = creature(client->creature_index).id;
+}
+
+static Client* find_client(Client *clients, struct sockaddr_in *address)
+{
+    for (Int i = 0; i < NET_MAX_CLIENTS; i++)
+    {
+        if (clients[i].connected && clients[i].address.sin_addr.s_addr == address->sin_addr.s_addr && clients[i].address.sin_port == address->sin_port)
+            return &clients[i];
+    }
+    return NULL;
+}
+
+static void send_welcome(int sock, Client *client, unsigned int tick)
+{
+    PacketWriter writer = {0};
+    write_u8(&writer, PACKET_WELCOME);
+    write_u8(&writer, NET_PROTOCOL);
+    write_u8(&writer, TICK_RATE);
+    write_u32(&writer, tick);
+    write_varint(&writer, client->creature_id);
+    net_send(sock, &client->address, &writer);
+}
+
+static void drop_client(InternalSystem* sys, Client *client)
+{
+    Int index = client_creature(sys, client);
+    if (index >= 0)
+        kill_creature(sys, index);
+
+    for (Int i = 0; i < NET_HISTORY; i++)
+        net_snapshot_free(&client->history[i]);
+
+    client->connected = false;
+}
+
+static void receive_packets(InternalSystem* sys, int sock, Client *clients, unsigned int tick, double now)
+{
+    unsigned char buffer[NET_MAX_PACKET];
+    struct sockaddr_in address;
+    Int size;
+    while ((size = net_receive(sock, &address, buffer, sizeof(buffer))) > 0)
+    {
+        PacketReader reader = {buffer, size, 0, false};
+        Client *client = find_client(clients, &address);
+        switch (buffer[0])
+        {
+            case PACKET_CONNECT:
+            {
+                read_u8(&reader);
+                if (read_u8(&reader) != NET_PROTOCOL)
+                    break;
+
+                if (client == NULL)
+                {
+                    for (Int i = 0; i < NET_MAX_CLIENTS && client == NULL; i++)
+                    {
+                        if (!clients[i].connected)
+                            client = &clients[i];
+                    }
+
+                    // full
+                    if (client == NULL)
+                        break;
+
+                    memset(client, 0, sizeof(Client));
+                    client->connected = true;
+                    client->address = address;
+                    client->acked = NET_NO_BASELINE;
+                    for (Int i = 0; i < NET_HISTORY; i++)
+                        net_snapshot_init(&client->history[i]);
+
+                    spawn_client(sys, client);
+                }
+                // a repeated connect means our welcome got lost
+                client->last_heard = now;
+                send_welcome(sock, client, tick);
+                break;
+            }
+            case PACKET_INPUT:
+            {
+                InputCommand input;
+                if (client == NULL || !read_input(&reader, &input))
+                    break;
+
+                client->last_heard = now;
+                // udp reorders, only newer inputs count
+                if (input.tick <= client->input.tick && client->input.tick != 0)
+                    break;
+
+                client->input = input;
+                if (input.ack != NET_NO_BASELINE && (client->acked == NET_NO_BASELINE || input.ack > client->acked) && input.ack <= tick)
+                    client->acked = input.ack;
+                break;
+            }
+            case PACKET_DISCONNECT:
+                if (client != NULL)
+                    drop_client(sys, client);
+                break;
+        }
+    }
+}
+
+// after the tick, so the snapshot never names a creature that is gone;
+// the client sees the old creature go away and the new one come in the same snapshot
+static void respawn_player(InternalSystem* sys, Client *client)
+{
+    if (client_creature(sys, client) < 0)
+        spawn_client(sys, client);
+}
+
+static void apply_client_input(InternalSystem* sys, Client *client)
+{
+    Int index = client_creature(sys, client);
+    if (index < 0)
+        return;
+
+    Creature* player = sys->world.creatures->data[index];
+    InputCommand *input = &client->input;
+    player->rotation.x = dequantize_rotation(input->yaw);
+    player->rotation.y = dequantize_rotation(input->pitch);
+    player->direction = look_direction(player->rotation);
+
+    if (input->wheel != 0)
+        player->current_item = Clamp(player->current_item + input->wheel, 0, player->inventory.size - 1);
+
+    mark_dirty(sys, player);
+
+    // one shot per press, the player creature is not the local player so use_item stays quiet
+    bool fire = (input->buttons & BUTTON_FIRE) && !(client->last_buttons & BUTTON_FIRE);
+    if (fire)
+        use_item(sys, player);
+    else if (input->buttons & BUTTON_RELOAD)
+        reload_item(sys, player);
+
+    client->last_buttons = input->buttons;
+    input->wheel = 0;
+
+    Vector3 move = {Clamp(input->move_x, -1, 1), 0, Clamp(input->move_z, -1, 1)};
+    player->move = (Vector3)
+    {
+        move.x * cosf(player->rotation.x) - move.z * sinf(player->rotation.x),
+        0.0f,
+        move.x * sinf(player->rotation.x) + move.z * cosf(player->rotation.x)
+    };
+}
+
+// the creatures nobody controls walk around at random
+static void wander(InternalSystem* sys, Client *clients, Int creatures)
+{
+    Int players = 0;
+    for (Int i = 0; i < NET_MAX_CLIENTS; i++)
+        players += clients[i].connected;
+
+    while (sys->world.creatures->size < creatures + players)
+        spawn_creature(sys, "enemy");
+
+    for (Int i = 0; i < sys->world.creatures->size; i++)
+    {
+        if (creature(i).inventory.size == 0)
+            creature(i).move = (Vector3){random_range(&spawn_seed, -1, 1), 0, random_range(&spawn_seed, -1, 1)};
+    }
+}
+
+// field by field, EntityState has padding
+static bool same_snapshot(NetSnapshot *a, NetSnapshot *b)
+{
+    if (a->tick != b->tick || a->entities->size != b->entities->size)
+        return false;
+
+    for (Int i = 0; i < a->entities->size; i++)
+    {
+        EntityState *x = &a->entities->data[i], *y = &b->entities->data[i];
+        if (x->id != y->id || x->type != y->type || memcmp(x->fields, y->fields, sizeof(x->fields)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// bots
+
+typedef struct
+{
+    int sock;
+    bool connected;
+    Int own_id;
+    NetSnapshot history[NET_HISTORY]; // decoded snapshots by tick % NET_HISTORY
+    unsigned int latest; // newest decoded tick, NET_NO_BASELINE for none
+    unsigned int tick;
+    unsigned int seed;
+    InputCommand input;
+    long snapshots;
+    long undecodable; // baseline no longer in the history, or a broken packet
+    long bytes_received;
+    long missing_self; // snapshots without our own creature
+} Bot;
+
+typedef struct
+{
+    Int count;
+    int port;
+    atomic_bool running;
+    Bot *bots;
+    pthread_t thread;
+} BotSwarm;
+
+static void bot_receive(Bot *bot)
+{
+    unsigned char buffer[NET_MAX_PACKET];
+    struct sockaddr_in address;
+    Int size;
+    while ((size = net_receive(bot->sock, &address, buffer, sizeof(buffer))) > 0)
+    {
+        bot->bytes_received += size;
+        PacketReader reader = {buffer, size, 0, false};
+        if (buffer[0] == PACKET_WELCOME)
+        {
+            read_u8(&reader);
+            read_u8(&reader);
+            read_u8(&reader);
+            read_u32(&reader);
+            bot->own_id = read_varint(&reader);
+            bot->connected = !reader.error;
+            continue;
+        }
+
+        unsigned int tick, baseline_tick;
+        Int own_id;
+        if (!read_snapshot_header(&reader, &tick, &baseline_tick, &own_id))
+            continue;
+
+        // older than what we have, useless
+        if (bot->latest != NET_NO_BASELINE && tick <= bot->latest)
+            continue;
+
+        NetSnapshot *baseline = NULL;
+        if (baseline_tick != NET_NO_BASELINE)
+        {
+            baseline = &bot->history[baseline_tick % NET_HISTORY];
+            if ((unsigned int)baseline->tick != baseline_tick || baseline_tick % NET_HISTORY == tick % NET_HISTORY)
+            {
+                bot->undecodable++;
+                continue;
+            }
+        }
+
+        NetSnapshot *out = &bot->history[tick % NET_HISTORY];
+        if (!read_snapshot(&reader, baseline, tick, out))
+        {
+            out->tick = -1;
+            bot->undecodable++;
+            continue;
+        }
+
+        bot->latest = tick;
+        bot->own_id = own_id;
+        bot->snapshots++;
+        if (find_entity(out->entities, own_id) == NULL)
+            bot->missing_self++;
+    }
+}
+
+static void bot_send(Bot *bot, struct sockaddr_in *server)
+{
+    PacketWriter writer = {0};
+    if (!bot->connected)
+    {
+        // once every half second until the welcome arrives
+        if (bot->tick++ % (TICK_RATE / 2) == 0)
+        {
+            write_u8(&writer, PACKET_CONNECT);
+            write_u8(&writer, NET_PROTOCOL);
+            net_send(bot->sock, server, &writer);
+        }
+        return;
+    }
+
+    InputCommand *input = &bot->input;
+    input->tick = ++bot->tick;
+    input->ack = bot->latest;
+    // hold a direction for a while, turn a bit every tick, shoot now and then
+    if (bot->tick % TICK_RATE == 0)
+    {
+        input->move_x = (signed char)random_range(&bot->seed, -1.99f, 1.99f);
+        input->move_z = (signed char)random_range(&bot->seed, -1.99f, 1.99f);
+    }
+    input->yaw = quantize_rotation(remainderf(dequantize_rotation(input->yaw) + random_range(&bot->seed, -0.05f, 0.1f), 2 * PI));
+    input->pitch = quantize_rotation(random_range(&bot->seed, -0.2f, 0.2f));
+    input->buttons = random_range(&bot->seed, 0, 1) < 0.05f ? BUTTON_FIRE : 0;
+    if (bot->tick % (TICK_RATE * 3) == 0)
+        input->buttons |= BUTTON_RELOAD;
+
+    write_input(&writer, input);
+    net_send(bot->sock, server, &writer);
+}
+
+static void* bots_main(void *arg)
+{
+    BotSwarm *swarm = arg;
+    struct sockaddr_in server = net_address("127.0.0.1", swarm->port);
+    double step = 1.0 / TICK_RATE;
+    double next = now_seconds();
+    while (atomic_load(&swarm->running))
+    {
+        for (Int i = 0; i < swarm->count; i++)
+        {
+            bot_receive(&swarm->bots[i]);
+            bot_send(&swarm->bots[i], &server);
+        }
+        next += step;
+        sleep_until(next);
+    }
+
+    PacketWriter writer = {0};
+    write_u8(&writer, PACKET_DISCONNECT);
+    for (Int i = 0; i < swarm->count; i++)
+        net_send(swarm->bots[i].sock, &server, &writer);
+
+    return NULL;
+}
+
+static BotSwarm* start_bots(Int count, int port)
+{
+    BotSwarm *swarm = (BotSwarm*)calloc(1, sizeof(BotSwarm));
+    swarm->count = count;
+    swarm->port = port;
+    swarm->bots = (Bot*)calloc(count, sizeof(Bot));
+    atomic_init(&swarm->running, true);
+    for (Int i = 0; i < count; i++)
+    {
+        Bot *bot = &swarm->bots[i];
+        bot->sock = net_open(0);
+        bot->latest = NET_NO_BASELINE;
+        bot->seed = i + 1;
+        // spread the connects over the first ticks
+        bot->tick = i;
+        for (Int j = 0; j < NET_HISTORY; j++)
+            net_snapshot_init(&bot->history[j]);
+    }
+    pthread_create(&swarm->thread, NULL, bots_main, swarm);
+    return swarm;
+}
+
+static void stop_bots(BotSwarm *swarm)
+{
+    atomic_store(&swarm->running, false);
+    pthread_join(swarm->thread, NULL);
+
+    long snapshots = 0, undecodable = 0, bytes = 0, missing = 0;
+    Int connected = 0;
+    for (Int i = 0; i < swarm->count; i++)
+    {
+        Bot *bot = &swarm->bots[i];
+        snapshots += bot->snapshots;
+        undecodable += bot->undecodable;
+        bytes += bot->bytes_received;
+        missing += bot->missing_self;
+        connected += bot->connected;
+        for (Int j = 0; j < NET_HISTORY; j++)
+            net_snapshot_free(&bot->history[j]);
+
+        net_close(bot->sock);
+    }
+    printf("bots: %ld/%ld connected, %ld snapshots decoded, %ld undecodable, %ld without own creature, %ld bytes received\n",
+        (long)connected, (long)swarm->count, snapshots, undecodable, missing, bytes);
+
+    free(swarm->bots);
+    free(swarm);
+}
+
+int main(int argc, char **argv)
+{
+    ServerOptions options = {NET_PORT, "data/model/map0/map.obj", 64, 0, 0, 0, false, true};
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+            options.port = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--map") == 0 && i + 1 < argc)
+            options.map = argv[++i];
+        else if (strcmp(argv[i], "--creatures") == 0 && i + 1 < argc)
+            options.creatures = atol(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.threads = atol(argv[++i]);
+        else if (strcmp(argv[i], "--bots") == 0 && i + 1 < argc)
+            options.bots = atol(argv[++i]);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            options.seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--verify") == 0)
+            options.verify = true;
+        else if (strcmp(argv[i], "--no-interest") == 0)
+            options.interest = false;
+        else
+        {
+            printf("usage: %s [--port N] [--map path] [--creatures N] [--threads N] [--bots N] [--seconds S] [--verify] [--no-interest]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // the vm is only there for the map event scripts
+    VirtualMachine* vm = make_vm();
+    init_std(vm);
+    init_world(vm);
+
+    InternalSystem* sys = new_system("server", 0, 0);
+    sys->vm = vm;
+    sys->event_creature = register_number(vm, "event.creature", -1);
+    sys->event_trigger = register_number(vm, "event.trigger", -1);
+    // the scripts name the world game.system, like data.br does for the game
+    data(register_var(vm, "game.system")).pointer = sys;
+
+    Int map_id = new_map(sys, "server", -1);
+    Map* map = &sys->maps->data[map_id];
+    if (!load_obj_hitboxes(options.map, map->hitboxes, &map_bounds))
+        return 1;
+
+    char* slash = strrchr(options.map, '/');
+    char* event_path = slash == NULL ? str_duplicate("event.txt") : str_format("%.*s/event.txt", (int)(slash - options.map), options.map);
+    load_map_events(sys, map, event_path);
+    free(event_path);
+
+    reserve_world(sys, options.creatures + NET_MAX_CLIENTS, 1024);
+    sys->jobs = jobs_init(options.threads);
+
+    int sock = net_open(options.port);
+    if (sock < 0)
+        return 1;
+
+    printf("serving %s on port %d, %ld hitboxes, %ld creatures\n", options.map, options.port, (long)map->hitboxes->size, (long)options.creatures);
+
+    Client *clients = (Client*)calloc(NET_MAX_CLIENTS, sizeof(Client));
+    BotSwarm *swarm = options.bots > 0 ? start_bots(options.bots, options.port) : NULL;
+
+    NetSnapshot world_state;
+    NetSnapshot view;
+    NetSnapshot decoded;
+    net_snapshot_init(&world_state);
+    net_snapshot_init(&view);
+    net_snapshot_init(&decoded);
+    SpatialHash *grid = spatial_hash_init(NET_INTEREST_CELL);
+    IntList *order = list_init(IntList);
+
+    typedef List(double) TimeList;
+    TimeList *times = list_init(TimeList);
+    long mismatches = 0;
+    long bytes_sent = 0;
+    double client_seconds = 0; // summed over clients, for bytes per client per second
+    double cpu_total = 0; // ms
+
+    double step = 1.0 / TICK_RATE;
+    double start = now_seconds();
+    double next = start;
+    unsigned int tick = 0;
+    while (options.seconds <= 0 || now_seconds() - start < options.seconds)
+    {
+        sleep_until(next);
+        next += step;
+        if (now_seconds() - next > step * 5)
+            next = now_seconds();
+
+        double tick_start = now_seconds();
+        double tick_cpu = cpu_seconds();
+        tick++;
+
+        receive_packets(sys, sock, clients, tick, tick_start);
+        for (Int i = 0; i < NET_MAX_CLIENTS; i++)
+        {
+            if (!clients[i].connected)
+                continue;
+
+            if (tick_start - clients[i].last_heard > NET_TIMEOUT)
+            {
+                drop_client(sys, &clients[i]);
+                continue;
+            }
+            apply_client_input(sys, &clients[i]);
+            // every player keeps the ai around it at full rate
+            Int index = client_creature(sys, &clients[i]);
+            if (index >= 0)
+                ai_observe(sys, creature(index).position);
+        }
+
+        wander(sys, clients, options.creatures);
+        world_tick(sys);
+        reset_frame(sys);
+        expire_messages(sys);
+        sys->time += step;
+
+        for (Int i = 0; i < NET_MAX_CLIENTS; i++)
+        {
+            if (clients[i].connected)
+                respawn_player(sys, &clients[i]);
+        }
+
+        build_world_state(sys, &world_state, tick);
+        if (options.interest)
+            build_interest_grid(&world_state, grid);
+
+        for (Int i = 0; i < NET_MAX_CLIENTS; i++)
+        {
+            Client *client = &clients[i];
+            if (!client->connected)
+                continue;
+
+            // the acked snapshot is the baseline while we still have it, otherwise everything goes in full
+            NetSnapshot *baseline = NULL;
+            if (client->acked != NET_NO_BASELINE && tick - client->acked < NET_HISTORY &&
+                (unsigned int)client->history[client->acked % NET_HISTORY].tick == client->acked)
+                baseline = &client->history[client->acked % NET_HISTORY];
+
+            PacketWriter writer = {0};
+            NetSnapshot *sent = &client->history[tick % NET_HISTORY];
+            if (options.interest)
+            {
+                build_client_view(&world_state, grid, client->creature_id, baseline, &view, order);
+                write_snapshot(&writer, baseline, &view, client->creature_id, order, sent);
+            }
+            else
+            {
+                write_snapshot(&writer, baseline, &world_state, client->creature_id, NULL, sent);
+            }
+            net_send(sock, &client->address, &writer);
+            client->bytes_sent += writer.size;
+            client->packets_sent++;
+            client->full_snapshots += baseline == NULL;
+            bytes_sent += writer.size;
+            client_seconds += step;
+
+            if (options.verify)
+            {
+                PacketReader reader = {writer.data, writer.size, 0, false};
+                unsigned int packet_tick, baseline_tick;
+                Int own_id;
+                if (!read_snapshot_header(&reader, &packet_tick, &baseline_tick, &own_id) ||
+                    !read_snapshot(&reader, baseline, packet_tick, &decoded) || !same_snapshot(&decoded, sent) || own_id != client->creature_id)
+                    mismatches++;
+            }
+        }
+
+        list_push(*times, (now_seconds() - tick_start) * 1000.0);
+        cpu_total += (cpu_seconds() - tick_cpu) * 1000.0;
+    }
+
+    if (swarm != NULL)
+    {
+        stop_bots(swarm);
+        // let the disconnects arrive
+        sleep_until(now_seconds() + 0.1);
+        receive_packets(sys, sock, clients, tick, now_seconds());
+    }
+
+    Int connected = 0;
+    long full_snapshots = 0;
+    for (Int i = 0; i < NET_MAX_CLIENTS; i++)
+    {
+        full_snapshots += clients[i].full_snapshots;
+        if (clients[i].connected)
+        {
+            connected++;
+            drop_client(sys, &clients[i]);
+        }
+    }
+
+    double total = 0;
+    for (Int i = 0; i < times->size; i++)
+        total += times->data[i];
+
+    qsort(times->data, times->size, sizeof(double), compare_double);
+    if (times->size > 0)
+    {
+        printf("%ld ticks, tick %.3f ms avg (%.3f ms cpu), %.3f ms p99, %.3f ms max, %ld creatures, %ld bullets at the end\n",
+            (long)times->size, total / times->size, cpu_total / times->size, times->data[(times->size * 99) / 100], times->data[times->size - 1],
+            (long)sys->world.creatures->size, (long)sys->world.bullets->size);
+    }
+    printf("sent %ld bytes, %.0f bytes/s per client, %ld full snapshots, %ld clients still connected\n",
+        bytes_sent, client_seconds > 0 ? bytes_sent / client_seconds : 0, full_snapshots, (long)connected);
+    if (options.verify)
+        printf("verify: %ld mismatches\n", mismatches);
+
+    list_free(*times);
+    net_snapshot_free(&world_state);
+    net_snapshot_free(&view);
+    net_snapshot_free(&decoded);
+    spatial_hash_free(grid);
+    list_free(*order);
+    free(clients);
+    net_close(sock);
+    jobs_free(sys->jobs);
+    sys->jobs = NULL;
+    free_system(sys);
+    return mismatches > 0;
+}